@@ -13,6 +13,9 @@
  * limitations under the License.
  */
 
+#ifndef _WIN32
+# define _FILE_OFFSET_BITS 64 // So that inputs and outputs may be more than 2 GB in 32-bit builds
+#endif
 #include <stdio.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -21,18 +24,121 @@
 #include <ctype.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <time.h>
+#ifndef _WIN32
+# include <unistd.h>
+# include <fcntl.h>
+#else
+# include <io.h>
+#endif
+#ifdef __SSSE3__
+# include <tmmintrin.h>
+#endif
+#ifdef __SSE4_2__
+# include <nmmintrin.h>
+#endif
+#if defined(__SHA__) && defined(__SSE4_1__)
+# include <immintrin.h>
+#endif
+#if defined(__AVX512VBMI2__) && defined(__AVX512VBMI__) && defined(__AVX512VL__) && defined(__AVX512BW__) && defined(__BMI2__)
+# define LITERAL_VBMI2 // String literals are escaped 32 bytes at a time with AVX-512 VBMI2
+# include <immintrin.h>
+#endif
+// Offsets into files are long long, since a long is 32 bits under
+// Visual C++, and Visual C++ before 2013 has no strtoull()
+#ifdef _WIN32
+# define fseeko _fseeki64
+# define ftello _ftelli64
+# define stat _stat64
+#endif
+#if defined(_MSC_VER) && (_MSC_VER < 1800)
+# define strtoull _strtoui64
+#endif
+#if defined(__linux__) && defined(__has_include) && !defined(ARRAYIFY_NO_PROBES)
+# if __has_include(<sys/sdt.h>)
+#  include <sys/sdt.h>
+#  define PROBES // USDT probes, a nop in the code unless a tracer is attached
+# endif
+#endif
+
+// USDT probes, for bpftrace or perf, where <sys/sdt.h> is available
+#ifdef PROBES
+# define PROBE1(name, a) DTRACE_PROBE1(arrayify, name, a)
+# define PROBE2(name, a, b) DTRACE_PROBE2(arrayify, name, a, b)
+# define PROBE3(name, a, b, c) DTRACE_PROBE3(arrayify, name, a, b, c)
+#else
+# define PROBE1(name, a)
+# define PROBE2(name, a, b)
+# define PROBE3(name, a, b, c)
+#endif
 
 // Things to help with parsing filenames.
 #define DIR_SEPARATORS "\\/"
 #define EXT_SEPARATOR "."
 #define OUTPUT_FILE_EXTENSION "array"
+#define NINJA_FILE_EXTENSION "ninja"
+// The characters besides letters and digits which need no quotes in a command in a Ninja file
+#ifdef _WIN32
+# define NINJA_UNQUOTED "_-+.,/\\:=@%"
+#else
+# define NINJA_UNQUOTED "_-+.,/:=@%"
+#endif
+#define HEADER_FILE_EXTENSION "h"
 #define LINE_LENGTH 80
 #define PREFIX "const char %s[] = "
-#define PREFIX_LENGTH 16 // The length not including the %s formatter or terminator
-#define POSTFIX "\"\n" // Closing quote and newline
-#define POSTFIX_LENGTH 2
-#define ENDFIX ";\n\n// End of file\n"
-#define ENDFIX_LENGTH 18
+#define POSTFIX_LENGTH 2 // Closing quote and newline
+#define ENDFIX "\n// End of file\n"
+#define ELEMENT_INDENT "    "
+#define ELEMENT_INDENT_LENGTH 4
+#define ELEMENT_MAX_LENGTH 48 // Enough for the longest element of an initialiser list, e.g. "{(-INT64_C(9223372036854775807) - 1)},"
+#define LINE_SLACK 64        // Room in pLine beyond an element which overruns, for a vector store to overrun into
+#define INPUT_BUFFER_SIZE 4096
+#define RLE_MIN_RUN 3        // Runs shorter than this are not worth encoding as repeats
+#define RLE_MAX_RUN (0x7e + RLE_MIN_RUN) // Longer runs use the long form, 0xff
+#define RLE_LONG_RUN 0xffffffff
+#define RLE_MAX_LITERAL 0x80
+#define SPARSE_MIN_GAP 32    // Runs of zeroes shorter than this stay in an extent of a sparse array
+#define ADAPTIVE_BLOCK_SIZE 64 // The adaptive format chooses between text and binary for blocks of this many bytes
+#define ADAPTIVE_ELEMENT_COST 6 // Characters taken by each byte of a binary segment, e.g. " 0x00,"
+#define ADAPTIVE_SWITCH_COST 40 // Characters taken by starting a new segment, its member declaration included
+#define CRC_SLICES 8        // The CRC is calculated this many bytes at a time where there is no instruction for it
+#define RAW_CHUNK_SIZE 16000 // The most input in one raw string literal: MSVC allows no more than 16380 bytes in a literal
+#define TABLE_MAX_COLUMNS 64 // The most columns in a table
+#define TABLE_NAME_LENGTH 64 // The longest name of a column in a table, plus one
+#define TABLE_MAX_WIDTH 4096 // The widest char column in a table
+#define TABLE_STRING_PIECE 12 // Strings in a table are written in pieces of this many characters, each a string literal
+#define JSON_MAX_DEPTH 256   // The deepest nesting of arrays and objects in JSON input
+#define DEFLATE_WINDOW 32768 // The furthest back that a deflate match may be
+#define DEFLATE_HASH_BITS 15 // Matches are found through a hash of three bytes with this many bits
+#define DEFLATE_MAX_CHAIN 128 // The most earlier positions with the same hash looked at for a match
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_BLOCK_SYMBOLS 16384 // The most literals and matches in a deflate block, each block having its own codes
+#define WEB_ETAG_BYTES 16    // The number of bytes of the SHA-256 of an asset in its ETag
+#define TOKEN_IDENTIFIER_LENGTH 40 // The longest identifier of a log string, for the tokens formats
+#define TOKEN_REASON_LENGTH 256 // Enough for why the log strings of the tokens formats are not valid
+#define RAW_DELIMITER_ALPHABET "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_" // for raw string literal delimiters
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_DIGEST_SIZE 32
+#define MAX_OUTPUTS 8        // The most outputs which may be written from one input
+#define ESTIMATE_SAMPLES 256 // The number of blocks of input sampled by --estimate
+#define IO_WINDOW (8 * 1024 * 1024) // The I/O policy reads ahead and drops what is behind this far
+#define IO_ALIGNMENT 4096    // The alignment of buffers and reads for O_DIRECT
+#define IO_DIRECT_SIZE (1024 * 1024) // The size of each read with O_DIRECT, which has no read-ahead
+#define APPEND_STATE_EXTENSION "state" // -a keeps its state in a sidecar file named as the output with this added
+#define OPTIONS_LENGTH 1024  // Enough for the options which shape an output, as compared by -a and --check
+#define CHECK_FORMAT "[size %016llx mtime %016llx crc32c %08lx options %08lx]" // Ends the first line, for --check
+#define CHECK_SCAN_FORMAT "[size %llx mtime %llx crc32c %lx options %lx]"
+#define CHECK_LINE_LENGTH 4096 // The longest first line of an output that --check will look at
+#define TEMPLATE_LINE_LENGTH 1024 // The longest line of an array held for a template which may be an #include
+#define TEMPLATE_BLOCK_LENGTH 4096 // The most of a conditional block of #include lines which is hoisted whole
+#define CHECK_RACY_SECONDS 2 // An input modified this recently may change again without its time changing, FAT's being to 2 seconds
+#define HOST_MACRO "ARRAYIFY_HOST_ASSETS" // Defined in a host build for -x outputs to read their input rather than compile it in
+#define HOST_DIR_VARIABLE "ARRAYIFY_ASSET_DIR" // If set, where a host build looks for the inputs of -x outputs
+#define BASE64_ALPHABET "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+#define Z85_ALPHABET "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ.-:+=^!/*?&<>()[]{}@%$#"
 
 // Returns true if the given character must be escaped for inclusion in C code, else false.
 static bool escapeRequired(char character)
@@ -132,294 +238,7892 @@ static char escapedChar(char character)
     return cCharacter;
 }
 
-// Print the usage text
-static void printUsage(char *pExeName) {
-    printf("\n%s: take a text file and create from it a C const char array which can be compiled into code. Usage:\n", pExeName);
-    printf("    %s input_file <-n name> <-l line_length> <-o output_file> <-b>\n", pExeName);
-    printf("where:\n");
-    printf("    input_file is the input text file,\n");
-    printf("    -n optionally specifies the name for the array (if not specified input_file, without file extension, will be used),\n");
-    printf("    -l optionally specifies the length of each line in the output file (%d by default),\n", LINE_LENGTH);
-    printf("    -o optionally specifies the output file (if not specified the output file is input_file with extension %s%s);\n", EXT_SEPARATOR, OUTPUT_FILE_EXTENSION);
-    printf("       if the output file exists it will be overwritten,\n");
-    printf("    -b bare; if this command-line switch is specified no topping/tailing comment lines will be added to the output.\n");
-    printf("For example:\n");
-    printf("    %s input.txt -n fred -l 120 -o output.blah -b\n\n", pExeName);
+// The types of CRC which can be calculated over the input
+typedef enum {
+    CRC_TYPE_NONE,
+    CRC_TYPE_CRC32,  // IEEE 802.3, as used by zip
+    CRC_TYPE_CRC32C, // Castagnoli, as used by iSCSI and SSE4.2
+    NUM_CRC_TYPES
+} CrcType;
+
+// The CRC types, in the order of CrcType
+static const struct {
+    const char *pName;      // as given to -c
+    const char *pFunction;  // the name of the emitted function to calculate it
+    uint32_t polynomial;    // reflected
+} crcTypes[] = {
+    {"none", NULL, 0},
+    {"crc32", "arrayifyCrc32Update", 0xedb88320},
+    {"crc32c", "arrayifyCrc32cUpdate", 0x82f63b78}
+};
+
+// The kinds of step in a template plan
+typedef enum {
+    STEP_TEXT,   // text copied as it is
+    STEP_NAME,   // {name}: the name of the array
+    STEP_INPUT,  // {input}: the input file name
+    STEP_EXE,    // {exe}: the name of this program
+    STEP_LEN,    // {len}: the length of the input in bytes
+    STEP_CRC,    // {crc}: the CRC of the input, CRC-32 unless -c says otherwise
+    STEP_SHA256, // {sha256}: the SHA-256 of the input in hex
+    STEP_OFFSET  // {offset}: the offset into the array of the start of a line
+} StepType;
+
+// A step in a template plan
+typedef struct {
+    StepType type;
+    const char *pText; // for STEP_TEXT, the text, which is not terminated
+    int length;        // for STEP_TEXT, the length of the text
+} Step;
+
+// The sections of a template: the line containing {data} is
+// the template for each line of the array, the text before
+// {data} on that line being written at the start of each line
+// and the text after it at the end of each line
+typedef enum {
+    TEMPLATE_HEAD,
+    TEMPLATE_LINE_PREFIX,
+    TEMPLATE_LINE_SUFFIX,
+    TEMPLATE_TAIL,
+    NUM_TEMPLATE_SECTIONS
+} TemplateSection;
+
+// A template, parsed once into a plan of steps for each section
+typedef struct {
+    char *pBuffer;  // the contents of the template file, which STEP_TEXT steps point into
+    Step *pSteps;   // the steps of all of the sections, one after the other
+    int start[NUM_TEMPLATE_SECTIONS + 1]; // the index in pSteps of the first step of each section
+    bool late;      // true if the head needs things only known once the input has been read
+    bool crc;       // true if the CRC of the input is needed
+    bool sha256;    // true if the SHA-256 of the input is needed
+} Template;
+
+// The state of a SHA-256 calculation
+typedef struct {
+    uint32_t state[8];
+    unsigned char block[SHA256_BLOCK_SIZE]; // input waiting to make up a whole block
+    int blockFill;     // the number of bytes in block
+    uint64_t length;   // the number of bytes added so far
+} Sha256;
+
+// The I/O policies, as given to -i
+typedef enum {
+    IO_POLICY_NORMAL, // leave it to the operating system
+    IO_POLICY_STREAM, // read ahead and drop what has been read or written from the page cache
+    IO_POLICY_DIRECT, // as IO_POLICY_STREAM but read the input with O_DIRECT, bypassing the page cache
+    NUM_IO_POLICIES
+} IoPolicy;
+
+// The names of the I/O policies, in the order of IoPolicy
+static const char *ioPolicies[] = {"normal", "stream", "direct"};
+
+// The state of the I/O policy
+typedef struct {
+    IoPolicy policy;
+    int directFd;      // for IO_POLICY_DIRECT, the input opened with O_DIRECT, -1 if it could not be
+    char *pBuffer;     // for IO_POLICY_DIRECT, the buffer to read into, aligned to IO_ALIGNMENT
+    long long bufferOffset; // for IO_POLICY_DIRECT, the offset into the input of what is in pBuffer
+    long bufferFill;   // for IO_POLICY_DIRECT, the number of bytes in pBuffer
+    long long advised; // the offset into the input up to which advice has been given
+} Io;
+
+// The state of the input while it is being read, which is
+// shared by all of the outputs written from it
+typedef struct {
+    long long fileSize; // the size of the input file before it was read, from stat()
+    long long fileTime; // the modification time of the input file before it was read, from stat()
+    bool racyTime;     // true if the input was modified so recently that a change to it may not change fileTime
+    long long length;  // the number of bytes read from the input so far
+    CrcType crcType;   // the type of CRC to calculate over the input, if any
+    uint32_t crc;      // the CRC of the input read so far
+    bool digest;       // true if the SHA-256 of the input is to be calculated
+    Sha256 sha256;     // the SHA-256 of the input read so far, if digest is true
+    bool check;        // true if the input is to be checked against the last run, for -a or --check
+    uint32_t checkCrc; // the CRC-32C of the input read so far, if check is true
+    bool histogram;    // true if the bytes of the input are to be counted
+    uint64_t counts[256]; // the number of each byte value read so far, if histogram is true
+    Io io;             // how the input and outputs are to be read and written
+} Input;
+
+// The kinds of segment in the adaptive format
+typedef enum {
+    SEGMENT_NONE,
+    SEGMENT_TEXT,   // a string literal
+    SEGMENT_BINARY  // an initialiser list of bytes
+} SegmentKind;
+
+// The types of column in a table, as given in its schema
+typedef enum {
+    COLUMN_I8,
+    COLUMN_U8,
+    COLUMN_I16,
+    COLUMN_U16,
+    COLUMN_I32,
+    COLUMN_U32,
+    COLUMN_I64,
+    COLUMN_U64,
+    COLUMN_F32,
+    COLUMN_F64,
+    COLUMN_CHAR,   // a fixed-width string, charN, holding up to N - 1 characters and a terminator
+    NUM_COLUMN_TYPES
+} ColumnType;
+
+// The name of each type of column in a schema, the C type it becomes,
+// its size (for char, of a character) and the range of integer types
+static const struct {
+    const char *pName;
+    const char *pCType;
+    int size;
+    long long min;
+    unsigned long long max;
+} columnTypes[] = {
+    {"i8", "int8_t", 1, -128, 127},
+    {"u8", "uint8_t", 1, 0, 0xff},
+    {"i16", "int16_t", 2, -32768, 32767},
+    {"u16", "uint16_t", 2, 0, 0xffff},
+    {"i32", "int32_t", 4, -2147483647LL - 1, 2147483647},
+    {"u32", "uint32_t", 4, 0, 0xffffffffULL},
+    {"i64", "int64_t", 8, LLONG_MIN, LLONG_MAX},
+    {"u64", "uint64_t", 8, 0, ULLONG_MAX},
+    {"f32", "float", 4},
+    {"f64", "double", 8},
+    {"char", "char", 1}
+};
+
+// A column of a table
+typedef struct {
+    char name[TABLE_NAME_LENGTH];
+    ColumnType type;
+    int width;         // the number of elements: 1, except for char columns
+    int field;         // the index of the column in the input
+} Column;
+
+// A buffer of bytes which grows as it is added to
+typedef struct {
+    unsigned char *pData;
+    long size;
+    long allocated;
+} Bytes;
+
+// A member of a JSON object, once written as CBOR: where its key and
+// value are, so that the members can be sorted by key
+typedef struct {
+    const unsigned char *pKey;
+    long keyLength;
+    long start;        // the offset of the key in the CBOR
+    long end;          // the offset of the end of the value in the CBOR
+} CborMember;
+
+// The state of converting JSON to CBOR
+typedef struct {
+    const char *pStart;  // the JSON, which is followed by a terminator
+    const char *pNext;   // the next character to be read
+    const char *pError;  // what is wrong with the JSON, NULL if nothing
+    const char *pErrorAt; // where in the JSON
+    int depth;           // the nesting of arrays and objects at pNext
+    Bytes cbor;          // the CBOR written so far
+    Bytes string;        // the last string read, as UTF-8
+    bool intern;         // true if the keys of objects are written as their index into pKeys
+    bool collect;        // true if only collecting the keys into pKeys
+    Bytes *pKeys;        // the distinct keys of the objects, in sorted order
+    int keyCount;
+    int keysAllocated;
+} Json;
+
+// The state of deflate compressing (RFC 1951) some data
+typedef struct {
+    Bytes out;           // the compressed data
+    uint64_t bits;       // bits yet to be added to out, the first in the least significant bit
+    int bitCount;
+    bool failed;         // true if out could not be added to
+} Deflate;
+
+// The state of an output file while it is being written
+typedef struct {
+    FILE *pFile;
+    char *pName;       // the name of the array
+    int lineLength;
+    long long inputSize; // the size of the input file, only known for binary formats
+    char *pLine;       // the buffer in which each line is assembled
+    char *pOut;        // the current position in pLine
+    char *pPrefix;     // the start of the first line, NULL once it has been written
+    int prefixLength;
+    int linesWritten;
+    bool lineOpen;     // true if a line has been written but not yet ended
+    bool bigEndian;    // for word formats, the endianness of the target
+    int wordSize;      // for word formats, the number of bytes in a word
+    uint64_t word;     // for word formats, the word being assembled
+    int wordFill;      // for word formats, the number of bytes in word so far
+    unsigned char group[4]; // for text-safe formats, input bytes waiting to make up a group
+    int groupFill;     // for text-safe formats, the number of bytes in group
+    bool decoder;      // for text-safe formats, true if a decoder is to be emitted
+    bool resource;     // true if the array is also to be given as an ArrayifyResource, for -r
+    unsigned char literal[RLE_MAX_LITERAL]; // for the rle format, bytes waiting to be written as they are
+    int literalCount;  // for the rle format, the number of bytes in literal
+    int runByte;       // for the rle format, the byte being repeated
+    long long runCount; // for the rle format, the number of repeats of runByte; for the sparse
+                       // format, the number of zeroes since the last byte which wasn't zero
+    bool inExtent;     // for the sparse format, true if an extent has been started
+    long long extentStart; // for the sparse and adaptive formats, the offset of the start of the current extent
+    long long *pExtents; // for the sparse format, offset and length of each extent written; for
+                       // the adaptive format, SegmentKind and length of each segment written
+    int extentCount;   // for the sparse and adaptive formats, the number of extents written
+    int extentsAllocated; // for the sparse and adaptive formats, the number of longs allocated at pExtents
+    SegmentKind segmentKind; // for the adaptive format, the kind of the segment being written
+    FILE *pHeldFile;   // for the adaptive format, the output file, held while the segments
+                       // are written to a temporary file
+    char *pChunk;      // for the raw format, input waiting to be written as a raw string literal
+    int chunkFill;     // for the raw format, the number of bytes in pChunk
+    const char *pHostPath; // for -x, the full path of the input, which a host build maps instead
+    const char *pSchema; // for the table format, the columns given with -k, NULL to take them from the header row
+    Column *pColumns;  // for the table format, the columns, NULL until the header row has been read
+    int columnCount;   // for the table format, the number of columns
+    char delimiter;    // for the table format, comma or, if the header row has one, tab
+    char *pRecord;     // for the table format, the row being read; for the CBOR and web formats, the whole input
+    int recordFill;    // for the table, CBOR and web formats, the number of characters in pRecord
+    int recordAllocated; // for the table, CBOR and web formats, the number of characters allocated at pRecord
+    bool inQuotes;     // for the table format, true if the end of pRecord is inside a quoted field
+    long recordCount;  // for the table format, the number of rows read, the header row included
+    const Template *pTemplate; // the template, NULL for the built-in layout
+    const char *pInputFileName;
+    const char *pExeFileName;
+    const Input *pInput; // the input, shared with any other outputs
+    long long position; // the offset into the array of the end of what is in pLine
+    long long lineOffset; // the offset into the array of the start of what is in pLine
+    long long writtenOffset; // the offset into the array of the start of the line last written
+    bool failed;       // true if an # error has been written into the output, having said why
+} Output;
+
+// An output format, as selected with -f
+typedef struct {
+    const char *pName;        // as given to -f
+    const char *pDescription; // for the usage text
+    const char *pPrefix;      // printf() format of the start of the first line, %s being the
+                              // array name, NULL if the format is not a string literal
+    bool binary;              // true if the input must be read in binary mode
+    void (*pStart)(Output *pOutput);
+    void (*pWrite)(Output *pOutput, const char *pBuffer, int size);
+    void (*pEnd)(Output *pOutput);
+    void (*pZeros)(Output *pOutput, long long size); // if not NULL, called instead of pWrite for
+                                                // holes in a sparse input file, which are not read
+    bool raw;                 // true if the output is not C source, so has no header, footer,
+                              // template, CRC or digest added to it
+    bool appendable;          // true if -a can carry on writing the output where the last run
+                              // left off, the state of the format being only the line in pLine
+    bool hostable;            // true if the output gives the input as bytes, name, and its length,
+                              // name_len, which -x can have a host build map from the input instead
+    const char *pIndexType;   // the type of the elements of the array which holds the input as it is,
+                              // for the index of an amalgamation, NULL if the format has no such array
+    const char *pIndexArray;  // printf() format of the name of that array, %s being the array name
+    void (*pResource)(Output *pOutput); // for -r, writes the array as an ArrayifyResource, name_resource,
+                                        // NULL if the format does not give the input, or something like it, as bytes
+} Format;
+
+// The styles of progress report, as given to -p
+typedef enum {
+    PROGRESS_NONE,
+    PROGRESS_BAR,  // a line on stderr which is rewritten as the input is read
+    PROGRESS_LOG,  // a line on stderr of name=value pairs for each report, for CI logs
+    NUM_PROGRESS_STYLES
+} ProgressStyle;
+
+// The names of the progress styles, in the order of ProgressStyle
+static const char *progressStyles[] = {"none", "bar", "log"};
+
+// The state of progress reporting: the time is looked at once for
+// each buffer of input and a report made when it moves on a second
+typedef struct {
+    ProgressStyle style;
+    long long total;   // the size of the input, -1 if not known
+    time_t start;
+    time_t last;       // the time of the last report
+} Progress;
+
+// The state of an output where a run left off, kept by -a in a sidecar
+// file so that, if the input has only grown, the next run can keep the
+// output up to outputOffset, carry on encoding from the end of the old
+// input and write a new ending; the string literal encoder never leaves
+// an escape half-written between buffers, so the line is all it needs
+typedef struct {
+    char options[OPTIONS_LENGTH]; // the options which the output was written with
+    long long inputLength; // the length of the input which the output was written from
+    uint32_t inputCrc; // the CRC-32C of that input
+    long long outputOffset; // the offset into the output file of the end of the lines written
+    long long outputSize; // the size of the output file, its ending included
+    long long position; // the encoder state at outputOffset, as in Output
+    long long lineOffset;
+    long long writtenOffset;
+    bool lineOpen;
+    bool firstLine;    // true if the first line, with the prefix, has not been written
+    int lineFill;      // the number of characters in pLine
+    char *pLine;       // the line being assembled, which has not been written
+} AppendState;
+
+// An output file to be written, as given with -o
+typedef struct {
+    const char *pFileName;
+    const Format *pFormat;
+    FILE *pFile;
+    bool started;      // true if the output could be started and so is being written
+    long long size;    // for a dry run, the number of bytes written to pFile
+    double blockSum;   // for an estimate, the sum of the output sizes of the sampled blocks
+    double blockSumSquares; // for an estimate, the sum of their squares
+    char options[OPTIONS_LENGTH]; // the options which shape the output
+    bool header;       // true if the output has the built-in header, which says what --check needs
+    bool append;       // true if -a was given, so the state of the output is to be kept
+    bool resume;       // for -a, true if the output carries on from where the last run left off
+    AppendState state; // for -a, the state of the output where the last run left off
+    bool shared;       // true if pFile is an amalgamation, shared with the other inputs of a batch
+    long long headerOffset; // the offset into pFile of the header
+    Output output;
+} Sink;
+
+// The state of a batch run, over the inputs listed in a file
+typedef struct {
+    FILE *pFile;       // with -g, the amalgamation which the arrays are being written to, else NULL
+    long long length;  // the length of the input last read
+} Batch;
+
+// An input of a batch run, as listed
+typedef struct {
+    char *pFileName;
+    char *pName;       // the name of its array, NULL if it is to be worked out from pFileName
+    char *pMallocedName; // if the name has been worked out from pFileName, the copy of it which it is in
+    long long length;  // the length of the input, once it has been read
+} BatchEntry;
+
+// The options of a manifest for the inputs which match a glob
+typedef struct {
+    const char *pGlob;
+    const char *pOptions;
+} ManifestRule;
+
+// Fill the tables for eight bytes at a time, reflected, CRC-32 with the given
+// polynomial: the first is the table for a byte at a time and each of the
+// others takes a byte through one more byte's worth of zeroes
+static void crcTableFill(uint32_t (*pTables)[256], uint32_t polynomial)
+{
+    uint32_t value;
+
+    for (int x = 0; x < 256; x++) {
+        value = x;
+        for (int y = 0; y < 8; y++) {
+            value = (value & 1) ? (value >> 1) ^ polynomial : value >> 1;
+        }
+        pTables[0][x] = value;
+    }
+    for (int y = 1; y < CRC_SLICES; y++) {
+        for (int x = 0; x < 256; x++) {
+            pTables[y][x] = (pTables[y - 1][x] >> 8) ^ pTables[0][pTables[y - 1][x] & 0xff];
+        }
+    }
 }
 
-// Parse the input file and write to the output file
-static int parse(FILE *pInputFile, FILE *pOutputFile, char *pInputFileName, char *pExeFileName, bool bare, char *pName, int lineLength)
+// Update a CRC-32 of the given type with a buffer of data
+static uint32_t crcUpdate(CrcType type, uint32_t crc, const char *pBuffer, int size)
 {
-    char inputBuffer[120];
-    int bytesRead;
-    int linesWritten = 0;
-    bool writeLine = false;
-    int addEscaped = 0;
-    char *pIn;
-    char *pOutputBuffer = (char *) malloc (lineLength + 1); // +1 for newline
-    char *pOut = pOutputBuffer;
-    int prefixLength = PREFIX_LENGTH + strlen(pName);
-    char *pPrefix = (char *) malloc (prefixLength + 1); // +1 for terminator, which sprintf() adds
+    static uint32_t tables[NUM_CRC_TYPES][CRC_SLICES][256];
+    static bool tableReady[NUM_CRC_TYPES] = {false};
+    const uint32_t (*pTables)[256] = tables[type];
+    const unsigned char *pIn = (const unsigned char *) pBuffer;
+    uint32_t low;
+    uint32_t high;
+    int x = 0;
 
-    if ((pOutputBuffer != NULL) && (pPrefix != NULL)) {
-        if (!bare) {
-            // Write the header on its own line directly to the output file
-            fprintf(pOutputFile, "/* This file was created from input file %s by %s */\n\n", pInputFileName, pExeFileName);
+    crc = ~crc;
+#ifdef __SSE4_2__
+    if (type == CRC_TYPE_CRC32C) {
+        // The SSE4.2 crc32 instruction is CRC-32C
+# ifdef __x86_64__
+        uint64_t crc64 = crc;
+        uint64_t value;
+        for (; x + 8 <= size; x += 8) {
+            memcpy(&value, pBuffer + x, sizeof(value));
+            crc64 = _mm_crc32_u64(crc64, value);
         }
-        // Create the prefix
-        sprintf(pPrefix, PREFIX, pName);
-        // Read text from the input file until we get no more
-        while ((bytesRead = fread(inputBuffer, 1, sizeof(inputBuffer), pInputFile)) > 0) {
-            pIn = inputBuffer;
-            // Process the input buffer
-            while (pIn < inputBuffer + bytesRead) {
-                // Assemble the output buffer for each input character.
-                // If we're in the prefix region, add it or a blank (if we've previously 
-                // added the prefix)
-                if (pOut - pOutputBuffer < prefixLength) {
-                    if (pPrefix != NULL) {
-                        *pOut = *(pPrefix + (pOut - pOutputBuffer));
-                    } else {
-                        *pOut = ' ';
-                    }
-                    pOut++;
-                // If we're at the end of the prefix put in the starting quote
-                // and free the prefix buffer if it's not already freed
-                } else if (pOut - pOutputBuffer == prefixLength) {
-                    if (pPrefix != NULL) {
-                        free (pPrefix);
-                        pPrefix = NULL;
-                    }
-                    *pOut = '"';
-                    pOut++;
-                // If there's an escaped charcter to do, write it now
-                } else if (addEscaped == 2) {
-                    *pOut = '\\';
-                    pOut++;
-                    addEscaped--;
-                } else if (addEscaped == 1) {
-                    *pOut = escapedChar(*pIn);
-                    pOut++;
-                    pIn++;
-                    addEscaped--;
-                } else {
-                    // Process an actual character.
-                    // Check whether the current character needs escaping
-                    if (escapeRequired(*pIn)) {
-                        addEscaped = 2;
-                        // If we're already too close to the end of the line to add
-                        // this character plus its escape character, then write the
-                        // line now
-                        if (pOut - pOutputBuffer > lineLength - POSTFIX_LENGTH - 2) {
-                            writeLine = true;
-                        }
-                    } else {
-                        *pOut = *pIn;
-                        pOut++;
-                        pIn++;
-                    }
-                }
-                // If we're now at the line length, write the line and reset parameters
-                if ((pOut - pOutputBuffer >= lineLength - POSTFIX_LENGTH) || writeLine) {
-                    // Add the post-fix, write the line and reset parameters
-                    memcpy(pOut, POSTFIX, POSTFIX_LENGTH);
-                    pOut += POSTFIX_LENGTH;
-                    if (fwrite(pOutputBuffer, pOut - pOutputBuffer, 1, pOutputFile) == 1) {
-                        linesWritten++;
-                    }
-                    pOut = pOutputBuffer;
-                    writeLine = false;
-                }
-            }
+        crc = (uint32_t) crc64;
+# else
+        uint32_t value;
+        for (; x + 4 <= size; x += 4) {
+            memcpy(&value, pBuffer + x, sizeof(value));
+            crc = _mm_crc32_u32(crc, value);
+        }
+# endif
+        for (; x < size; x++) {
+            crc = _mm_crc32_u8(crc, pBuffer[x]);
         }
-        // Write any characters that might be left in the output buffer at the end
-        if (pOut - pOutputBuffer > 0) {
-            memcpy(pOut, POSTFIX, POSTFIX_LENGTH);
-            pOut += POSTFIX_LENGTH;
-            if (fwrite(pOutputBuffer, pOut - pOutputBuffer, 1, pOutputFile) == 1) {
-                linesWritten++;
+    }
+#endif
+    if (!tableReady[type]) {
+        crcTableFill(tables[type], crcTypes[type].polynomial);
+        tableReady[type] = true;
+    }
+    // Eight bytes at a time, each through its own table, which is
+    // the same whatever the endianness of the host
+    for (; x + CRC_SLICES <= size; x += CRC_SLICES) {
+        low = crc ^ (pIn[x] | (pIn[x + 1] << 8) | (pIn[x + 2] << 16) | ((uint32_t) pIn[x + 3] << 24));
+        high = pIn[x + 4] | (pIn[x + 5] << 8) | (pIn[x + 6] << 16) | ((uint32_t) pIn[x + 7] << 24);
+        crc = pTables[7][low & 0xff] ^ pTables[6][(low >> 8) & 0xff] ^
+              pTables[5][(low >> 16) & 0xff] ^ pTables[4][low >> 24] ^
+              pTables[3][high & 0xff] ^ pTables[2][(high >> 8) & 0xff] ^
+              pTables[1][(high >> 16) & 0xff] ^ pTables[0][high >> 24];
+    }
+    for (; x < size; x++) {
+        crc = pTables[0][(crc ^ pIn[x]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+// The SHA-256 round constants
+static const uint32_t sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// Rotate a 32-bit value right
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+// Start a SHA-256 calculation
+static void sha256Start(Sha256 *pSha256)
+{
+    static const uint32_t initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    memcpy(pSha256->state, initial, sizeof(pSha256->state));
+    pSha256->blockFill = 0;
+    pSha256->length = 0;
+}
+
+// Add count whole blocks of data to the SHA-256 state
+static void sha256Blocks(uint32_t *pState, const unsigned char *pData, long count)
+{
+#if defined(__SHA__) && defined(__SSE4_1__)
+    // The SHA extensions do two rounds at a time on the state held as
+    // ABEF and CDGH and calculate the message schedule four words at a time
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i abef;
+    __m128i cdgh;
+    __m128i abefSaved;
+    __m128i cdghSaved;
+    __m128i message[4];
+    __m128i words;
+    __m128i tmp;
+
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) pState), 0xb1);        // CDAB
+    cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (pState + 4)), 0x1b); // EFGH
+    abef = _mm_alignr_epi8(tmp, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+    for (; count > 0; count--, pData += SHA256_BLOCK_SIZE) {
+        abefSaved = abef;
+        cdghSaved = cdgh;
+        for (int x = 0; x < 16; x++) {
+            if (x < 4) {
+                message[x] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (pData + x * 16)), byteSwap);
+            }
+            words = _mm_add_epi32(message[x & 3], _mm_loadu_si128((const __m128i *) (sha256K + x * 4)));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);
+            if ((x >= 3) && (x < 15)) {
+                tmp = _mm_alignr_epi8(message[x & 3], message[(x - 1) & 3], 4);
+                message[(x + 1) & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(message[(x + 1) & 3], tmp), message[x & 3]);
+            }
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(words, 0x0e));
+            if ((x >= 1) && (x < 13)) {
+                message[(x - 1) & 3] = _mm_sha256msg1_epu32(message[(x - 1) & 3], message[x & 3]);
             }
         }
-        // If we're done, seek back over the postfix and write the endfix
-        if (bare) {
-            fseek(pOutputFile, -POSTFIX_LENGTH, SEEK_CUR);
-            fwrite(";\n", 2, 1, pOutputFile);
-        } else {
-            fseek(pOutputFile, -POSTFIX_LENGTH, SEEK_CUR);
-            fwrite(ENDFIX, ENDFIX_LENGTH, 1, pOutputFile);
+        abef = _mm_add_epi32(abef, abefSaved);
+        cdgh = _mm_add_epi32(cdgh, cdghSaved);
+    }
+    tmp = _mm_shuffle_epi32(abef, 0x1b);  // FEBA
+    cdgh = _mm_shuffle_epi32(cdgh, 0xb1); // DCHG
+    _mm_storeu_si128((__m128i *) pState, _mm_blend_epi16(tmp, cdgh, 0xf0));
+    _mm_storeu_si128((__m128i *) (pState + 4), _mm_alignr_epi8(cdgh, tmp, 8));
+#else
+    uint32_t w[64];
+    uint32_t v[8];
+    uint32_t t1;
+    uint32_t t2;
+
+    for (; count > 0; count--, pData += SHA256_BLOCK_SIZE) {
+        for (int x = 0; x < 16; x++) {
+            w[x] = ((uint32_t) pData[x * 4] << 24) | ((uint32_t) pData[x * 4 + 1] << 16) |
+                   ((uint32_t) pData[x * 4 + 2] << 8) | pData[x * 4 + 3];
+        }
+        for (int x = 16; x < 64; x++) {
+            w[x] = w[x - 16] + (ROTR32(w[x - 15], 7) ^ ROTR32(w[x - 15], 18) ^ (w[x - 15] >> 3)) +
+                   w[x - 7] + (ROTR32(w[x - 2], 17) ^ ROTR32(w[x - 2], 19) ^ (w[x - 2] >> 10));
+        }
+        memcpy(v, pState, sizeof(v));
+        for (int x = 0; x < 64; x++) {
+            t1 = v[7] + (ROTR32(v[4], 6) ^ ROTR32(v[4], 11) ^ ROTR32(v[4], 25)) +
+                 ((v[4] & v[5]) ^ (~v[4] & v[6])) + sha256K[x] + w[x];
+            t2 = (ROTR32(v[0], 2) ^ ROTR32(v[0], 13) ^ ROTR32(v[0], 22)) +
+                 ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+            memmove(v + 1, v, sizeof(v) - sizeof(v[0]));
+            v[4] += t1;
+            v[0] = t1 + t2;
+        }
+        for (int x = 0; x < 8; x++) {
+            pState[x] += v[x];
         }
-        // Tidy up
-        free (pPrefix); // Just in case
-        free (pOutputBuffer);
     }
+#endif
+}
 
-    return linesWritten;
+// Add a buffer of data to a SHA-256 calculation; whole blocks
+// are taken straight from the buffer, without copying
+static void sha256Update(Sha256 *pSha256, const char *pBuffer, long size)
+{
+    const unsigned char *pIn = (const unsigned char *) pBuffer;
+    long length;
+
+    pSha256->length += size;
+    if (pSha256->blockFill > 0) {
+        // Complete the block left over from last time
+        length = SHA256_BLOCK_SIZE - pSha256->blockFill;
+        if (length > size) {
+            length = size;
+        }
+        memcpy(pSha256->block + pSha256->blockFill, pIn, length);
+        pSha256->blockFill += length;
+        pIn += length;
+        size -= length;
+        if (pSha256->blockFill == SHA256_BLOCK_SIZE) {
+            sha256Blocks(pSha256->state, pSha256->block, 1);
+            pSha256->blockFill = 0;
+        }
+    }
+    if (size >= SHA256_BLOCK_SIZE) {
+        sha256Blocks(pSha256->state, pIn, size / SHA256_BLOCK_SIZE);
+        pIn += size - (size % SHA256_BLOCK_SIZE);
+        size %= SHA256_BLOCK_SIZE;
+    }
+    // Keep what's left for next time
+    memcpy(pSha256->block + pSha256->blockFill, pIn, size);
+    pSha256->blockFill += size;
 }
 
-// Entry point
-int main(int argc, char* argv[])
+// Finish a SHA-256 calculation, writing the digest to pDigest
+static void sha256Finish(Sha256 *pSha256, unsigned char *pDigest)
 {
-    int retValue = -1;
-    bool success = false;
+    uint64_t bits = pSha256->length * 8;
+
+    // Pad with 0x80, then zeroes up to the last eight bytes of a
+    // block, which hold the length in bits, big-endian
+    pSha256->block[pSha256->blockFill] = 0x80;
+    pSha256->blockFill++;
+    if (pSha256->blockFill > SHA256_BLOCK_SIZE - 8) {
+        memset(pSha256->block + pSha256->blockFill, 0, SHA256_BLOCK_SIZE - pSha256->blockFill);
+        sha256Blocks(pSha256->state, pSha256->block, 1);
+        pSha256->blockFill = 0;
+    }
+    memset(pSha256->block + pSha256->blockFill, 0, SHA256_BLOCK_SIZE - 8 - pSha256->blockFill);
+    for (int x = 0; x < 8; x++) {
+        pSha256->block[SHA256_BLOCK_SIZE - 1 - x] = (unsigned char) (bits >> (x * 8));
+    }
+    sha256Blocks(pSha256->state, pSha256->block, 1);
+    pSha256->blockFill = 0;
+    for (int x = 0; x < SHA256_DIGEST_SIZE; x++) {
+        pDigest[x] = (unsigned char) (pSha256->state[x / 4] >> (24 - (x % 4) * 8));
+    }
+}
+
+// Write a digest as hex to pHex, which must have room
+// for two characters per byte and a terminator
+static void digestHex(const unsigned char *pDigest, int size, char *pHex)
+{
+    for (int x = 0; x < size; x++) {
+        sprintf(pHex + x * 2, "%02x", pDigest[x]);
+    }
+}
+
+// Count the bytes of a buffer of input: four sets of counts are kept
+// so that runs of the same byte don't stall on one counter
+static void countBytes(uint64_t *pCounts, const char *pBuffer, int size)
+{
+    uint32_t counts[4][256];
+    const unsigned char *pIn = (const unsigned char *) pBuffer;
     int x = 0;
-    int lineLength = LINE_LENGTH;
-    bool bare = false;
-    char *pExeName = NULL;
-    char *pInputFileName = NULL;
-    FILE *pInputFile = NULL;
-    char *pOutputFileName = NULL;
-    bool outputFileNameMalloced = false;
-    char *pVariableName = NULL;
-    FILE *pOutputFile = NULL;
-    char *pDefaultName = NULL;
-    char *pMallocedName = NULL;
-    char *pTmp;
-    char *pTmp1;
-    struct stat st = { 0 };
 
-    // Find the exe name in the first argument
-    pTmp = strtok(argv[x], DIR_SEPARATORS);
-    while (pTmp != NULL) {
-        pExeName = pTmp;
-        pTmp = strtok(NULL, DIR_SEPARATORS);
+    memset(counts, 0, sizeof(counts));
+    for (; x + 4 <= size; x += 4) {
+        counts[0][pIn[x]]++;
+        counts[1][pIn[x + 1]]++;
+        counts[2][pIn[x + 2]]++;
+        counts[3][pIn[x + 3]]++;
     }
-    if (pExeName != NULL) {
-        // Remove the extension
-        pTmp = strtok(pExeName, EXT_SEPARATOR);
-        if (pTmp != NULL) {
-            pExeName = pTmp;
-        }
+    for (; x < size; x++) {
+        counts[0][pIn[x]]++;
     }
-    x++;
+    for (x = 0; x < 256; x++) {
+        pCounts[x] += counts[0][x] + counts[1][x] + counts[2][x] + counts[3][x];
+    }
+}
 
-    // Look for all the command line parameters
-    while (x < argc) {
-        // Test for input filename
-        if (x == 1) {
-            pInputFileName = argv[x];
-        // Test for variable name option
-        } else if (strcmp(argv[x], "-n") == 0) {
-            x++;
-            if (x < argc) {
-                pVariableName = argv[x];
-            }
-        // Test for line length option
-        } else if (strcmp(argv[x], "-l") == 0) {
-            x++;
-            if (x < argc) {
-                lineLength = atoi(argv[x]);
-            }
-        // Test for bare option
-        } else if (strcmp(argv[x], "-b") == 0) {
-            bare = true;
-        // Test for output file option
-        } else if (strcmp(argv[x], "-o") == 0) {
-            x++;
-            if (x < argc) {
-                pOutputFileName = argv[x];
-            }
+// Account for a buffer of input, which is about to be encoded,
+// updating the length and any checks of the input which are needed
+static void inputRead(Input *pInput, const char *pBuffer, int size)
+{
+    if (pInput->histogram) {
+        countBytes(pInput->counts, pBuffer, size);
+    }
+    if (pInput->crcType != CRC_TYPE_NONE) {
+        pInput->crc = crcUpdate(pInput->crcType, pInput->crc, pBuffer, size);
+    }
+    if (pInput->digest) {
+        sha256Update(&pInput->sha256, pBuffer, size);
+    }
+    if (pInput->check) {
+        pInput->checkCrc = crcUpdate(CRC_TYPE_CRC32C, pInput->checkCrc, pBuffer, size);
+    }
+    pInput->length += size;
+}
+
+// Account for a hole in the input, which is never read
+static void inputHole(Input *pInput, long long size)
+{
+    char zeros[INPUT_BUFFER_SIZE];
+    long long length = pInput->length + size;
+
+    memset(zeros, 0, sizeof(zeros));
+    if ((pInput->crcType != CRC_TYPE_NONE) || pInput->digest || pInput->check) {
+        for (; size > (long long) sizeof(zeros); size -= sizeof(zeros)) {
+            inputRead(pInput, zeros, sizeof(zeros));
         }
-        x++;
+        inputRead(pInput, zeros, size);
     }
+    pInput->length = length;
+}
 
-    // Validate the command-line parameters and create
-    // defaults for those unspecified
-    if (pInputFileName != NULL) {
-        success = true;
-        // Open the input file
-        pInputFile = fopen (pInputFileName, "r");
-        if (pInputFile == NULL) {
-            success = false;
-            printf("Cannot open input file %s (%s).\n", pInputFileName, strerror(errno));
-        } else {
-            // Now copy the file name, lopping off the extension and any path
-            pMallocedName = (char *) malloc (strlen(pInputFileName) + 1);
-            if (pMallocedName != NULL) {
-                strcpy(pMallocedName, pInputFileName);
-                pDefaultName = pMallocedName;
-                pTmp = strtok(pMallocedName, DIR_SEPARATORS);
-                while (pTmp != NULL) {
-                    pDefaultName = pTmp;
-                    pTmp = strtok(NULL, DIR_SEPARATORS);
-                }
-                pTmp1 = pDefaultName;
-                pTmp1 = strstr(pTmp1, EXT_SEPARATOR);
-                while (pTmp1 != NULL) {
-                    pTmp = pTmp1;
-                    pTmp1++;
-                    pTmp1 = strstr(pTmp1, EXT_SEPARATOR);
-                }
-                *pTmp = 0;
-                if (pVariableName == NULL) {
-                    // No name specified, so set it to the input
-                    // filename without paths and extension
-                    pVariableName = pDefaultName;
-                }
-                // Check the line length: it must be at least the
-                // amount of space required to print the prefix (which
-                // includes the variable name) and "\x"\n, where x
-                // is at least one character from the input, which
-                // [may be] escaped
-                if ((lineLength < 0) || (lineLength < PREFIX_LENGTH + strlen(pVariableName) + 5)) {
-                    printf("Using line length %d as %d is less than the minimum required to print something.\n", PREFIX_LENGTH + strlen(pVariableName) + 5, lineLength);
-                    lineLength = PREFIX_LENGTH + strlen(pVariableName) + 5;
-                }
-                if (pOutputFileName == NULL) {
-                    // No output file specified, so set it to the input
-                    // filename without path and with the default extension
-                    pOutputFileName = (char *) malloc (strlen(pDefaultName) + sizeof(OUTPUT_FILE_EXTENSION) - 1 + sizeof(EXT_SEPARATOR) - 1 + 1);
-                    if (pOutputFileName != NULL) {
-                        outputFileNameMalloced = true;
-                        strcpy(pOutputFileName, pDefaultName);
-                        strcat(pOutputFileName, EXT_SEPARATOR);
-                        strcat(pOutputFileName, OUTPUT_FILE_EXTENSION);
-                    } else {
-                        success = false;
-                        printf("Cannot allocate memory for output file name.\n");
-                    }
-                }
-            } else {
-                success = false;
-                printf("Cannot allocate memory for name.\n");
-            }
-            // Open the output file
-            if (pOutputFileName != NULL) {
-                pOutputFile = fopen(pOutputFileName, "w");
-                if (pOutputFile == NULL) {
-                    success = false;
-                    printf("Cannot open output file %s (%s).\n", pOutputFileName, strerror(errno));
-                }
-            }
+// Return the order-0 entropy of the input read so far, in bytes: the
+// least that the input could be compressed to by coding each byte
+// on its own, only an estimate of what a real compressor would do
+static double inputEntropy(const Input *pInput)
+{
+    double bits = 0;
+    uint64_t total = 0;
+
+    for (int x = 0; x < 256; x++) {
+        total += pInput->counts[x];
+    }
+    for (int x = 0; x < 256; x++) {
+        if (pInput->counts[x] > 0) {
+            bits -= pInput->counts[x] * log((double) pInput->counts[x] / total) / log(2.0);
         }
-        if (success) {
-            printf("Arrifying file \"%s\", naming array \"%s\", using %d character lines and writing output to \"%s\"%s\n",
-                   pInputFileName, pVariableName, lineLength, pOutputFileName, bare ? " bare." : ".\n");
-            x = parse(pInputFile, pOutputFile, pInputFileName, pExeName, bare, pVariableName, lineLength);
-            printf("Done: %d line(s) written to file.\n", x);
-        } else {
-            printUsage(pExeName);
+    }
+
+    return bits / 8;
+}
+
+// Get the SHA-256 of the input read so far, as bytes and in hex;
+// a copy is finished so that the calculation can be continued
+static void inputDigest(const Input *pInput, unsigned char *pDigest, char *pHex)
+{
+    Sha256 sha256 = pInput->sha256;
+
+    sha256Finish(&sha256, pDigest);
+    digestHex(pDigest, SHA256_DIGEST_SIZE, pHex);
+}
+
+// Write a section of the template plan
+static void writeTemplate(Output *pOutput, TemplateSection section, long long offset)
+{
+    const Step *pStep = pOutput->pTemplate->pSteps + pOutput->pTemplate->start[section];
+    const Step *pEnd = pOutput->pTemplate->pSteps + pOutput->pTemplate->start[section + 1];
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_DIGEST_SIZE * 2 + 1];
+
+    for (; pStep < pEnd; pStep++) {
+        switch (pStep->type) {
+            case STEP_TEXT:
+                fwrite(pStep->pText, pStep->length, 1, pOutput->pFile);
+                break;
+            case STEP_NAME:
+                fprintf(pOutput->pFile, "%s", pOutput->pName);
+                break;
+            case STEP_INPUT:
+                fprintf(pOutput->pFile, "%s", pOutput->pInputFileName);
+                break;
+            case STEP_EXE:
+                fprintf(pOutput->pFile, "%s", pOutput->pExeFileName);
+                break;
+            case STEP_LEN:
+                fprintf(pOutput->pFile, "%lld", pOutput->pInput->length);
+                break;
+            case STEP_CRC:
+                fprintf(pOutput->pFile, "0x%08lx", (unsigned long) pOutput->pInput->crc);
+                break;
+            case STEP_SHA256:
+                inputDigest(pOutput->pInput, digest, hex);
+                fprintf(pOutput->pFile, "%s", hex);
+                break;
+            case STEP_OFFSET:
+                fprintf(pOutput->pFile, "%lld", offset);
+                break;
         }
-    } else {
-        printUsage(pExeName);
     }
+}
 
-    if (success) {
-        retValue = 0;
+// End a line that has been written to file, adding the end of
+// the line template if there is one
+static void lineEnd(Output *pOutput)
+{
+    if (pOutput->pTemplate != NULL) {
+        writeTemplate(pOutput, TEMPLATE_LINE_SUFFIX, pOutput->writtenOffset);
     }
+    fputc('\n', pOutput->pFile);
+    pOutput->lineOpen = false;
+}
 
-    // Clean up
-    if (pInputFile != NULL) {
-        fclose(pInputFile);
+// Write the line assembled in the output buffer to file.  The newline
+// ending the previous line is written first so that the last line
+// can be finished off with whatever the format needs, followed by
+// a call to lineEnd().
+static void writeLine(Output *pOutput)
+{
+    if (pOutput->lineOpen) {
+        lineEnd(pOutput);
     }
-    if (pOutputFile != NULL) {
-        fclose(pOutputFile);
+    if (pOutput->pTemplate != NULL) {
+        writeTemplate(pOutput, TEMPLATE_LINE_PREFIX, pOutput->lineOffset);
     }
-    if (pMallocedName != NULL) {
-        free(pMallocedName);
+    if (fwrite(pOutput->pLine, pOutput->pOut - pOutput->pLine, 1, pOutput->pFile) == 1) {
+        pOutput->linesWritten++;
     }
-    if (outputFileNameMalloced) {
-        free(pOutputFileName);
+    PROBE3(line__flushed, pOutput->pName, pOutput->linesWritten, (long) (pOutput->pOut - pOutput->pLine));
+    pOutput->lineOpen = true;
+    pOutput->pOut = pOutput->pLine;
+    pOutput->writtenOffset = pOutput->lineOffset;
+    pOutput->lineOffset = pOutput->position;
+}
+
+#if defined(LITERAL_VBMI2) || defined(__SSSE3__)
+// Find, from the mask of the bytes of a block which need escaping, how
+// many of those at the start of the block fit in room characters, from
+// the running sum of their widths, setting *pWidth to the characters
+// that they take
+static int literalFit(uint64_t mask, int count, int room, int *pWidth)
+{
+    int width = 0;
+    int x = 0;
+
+    for (; (x < count) && (width + 1 + (int) ((mask >> x) & 1) <= room); x++) {
+        width += 1 + (int) ((mask >> x) & 1);
     }
+    *pWidth = width;
 
-    return retValue;
-}
\ No newline at end of file
+    return x;
+}
+#endif
+
+#ifdef LITERAL_VBMI2
+// Find which of 32 bytes need escaping, as escapeRequired() does, and
+// what each would be escaped as, as escapedChar() does
+static uint32_t literalClassify(__m256i bytes, __m256i *pEscaped)
+{
+    const __m256i controls = _mm256_setr_epi8('a', 'b', 't', 'n', 'v', 'f', 'r', 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                              'a', 'b', 't', 'n', 'v', 'f', 'r', 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m256i offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8(0x07));
+    // Bell to carriage return are a range
+    __mmask32 control = _mm256_cmple_epu8_mask(offset, _mm256_set1_epi8(6));
+    __mmask32 escape = _mm256_cmpeq_epi8_mask(bytes, _mm256_set1_epi8(0x1b));
+
+    *pEscaped = _mm256_mask_blend_epi8(control, bytes, _mm256_shuffle_epi8(controls, offset));
+    *pEscaped = _mm256_mask_blend_epi8(escape, *pEscaped, _mm256_set1_epi8('e'));
+
+    return control | escape | _mm256_cmpeq_epi8_mask(bytes, _mm256_set1_epi8(0x22)) |
+           _mm256_cmpeq_epi8_mask(bytes, _mm256_set1_epi8(0x27)) |
+           _mm256_cmpeq_epi8_mask(bytes, _mm256_set1_epi8(0x3f)) |
+           _mm256_cmpeq_epi8_mask(bytes, _mm256_set1_epi8(0x5c));
+}
+#elif defined(__SSSE3__)
+// Find which of 16 bytes need escaping, as escapeRequired() does, and
+// what each would be escaped as, as escapedChar() does
+static int literalClassify(__m128i bytes, __m128i *pEscaped)
+{
+    const __m128i controls = _mm_setr_epi8('a', 'b', 't', 'n', 'v', 'f', 'r', 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8(0x07));
+    // Bell to carriage return are a range
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(6)), offset);
+    __m128i escape = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x1b));
+    __m128i others = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x22)),
+                                               _mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x27))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x3f)),
+                                               _mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x5c))));
+
+    *pEscaped = _mm_or_si128(_mm_and_si128(control, _mm_shuffle_epi8(controls, offset)),
+                             _mm_andnot_si128(control, bytes));
+    *pEscaped = _mm_or_si128(_mm_and_si128(escape, _mm_set1_epi8('e')), _mm_andnot_si128(escape, *pEscaped));
+
+    return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(control, escape), others));
+}
+#endif
+
+// Expand as many bytes of input into a string literal as fit on the line
+// without ending it, i.e. up to the column limit, a block at a time in
+// vector registers: each byte becomes itself or a backslash and its
+// escape, AVX-512 VBMI2 compressing out the unused half of each pair and
+// SSSE3 shuffling eight bytes at a time with a table for each mask of
+// escapes.  Blocks with no escapes, which is how dense they mostly are
+// in text, are just copied.  The expanded block may be stored beyond
+// the line, into LINE_SLACK.  Returns the number of bytes consumed,
+// zero if the line is too nearly full or there is less than a block,
+// which are left to the caller.
+static int literalExpand(Output *pOutput, const char *pBuffer, int size, int limit)
+{
+    int consumed = 0;
+#if defined(LITERAL_VBMI2) || defined(__SSSE3__)
+    int count = 0;
+    int width;
+# ifdef LITERAL_VBMI2
+    static unsigned char interleave[64];
+    __m256i bytes;
+    __m256i escaped;
+    uint32_t mask;
+
+    if (interleave[1] == 0) {
+        // Each byte, or a backslash, followed by its escape
+        for (int x = 0; x < 32; x++) {
+            interleave[x * 2] = x;
+            interleave[x * 2 + 1] = 64 + x;
+        }
+    }
+    while ((size - consumed >= 32) && (count == consumed)) {
+        bytes = _mm256_loadu_si256((const __m256i *) (pBuffer + consumed));
+        mask = literalClassify(bytes, &escaped);
+        count = literalFit(mask, 32, limit - (int) (pOutput->pOut - pOutput->pLine), &width);
+        if (mask == 0) {
+            _mm256_storeu_si256((__m256i *) pOutput->pOut, bytes);
+        } else {
+            _mm512_storeu_si512(pOutput->pOut,
+                                _mm512_maskz_compress_epi8(0x5555555555555555ULL | _pdep_u64(mask, 0xaaaaaaaaaaaaaaaaULL),
+                                                           _mm512_permutex2var_epi8(_mm512_castsi256_si512(
+                                                               _mm256_mask_blend_epi8(mask, bytes, _mm256_set1_epi8('\\'))),
+                                                               _mm512_loadu_si512(interleave),
+                                                               _mm512_castsi256_si512(escaped))));
+        }
+        pOutput->pOut += width;
+        pOutput->position += count;
+        consumed += count;
+        count = (count == 32) ? consumed : -1;
+    }
+# else
+    static unsigned char shuffles[256][16];
+    static unsigned char backslashes[256][16];
+    static int widths[256];
+    __m128i bytes;
+    __m128i escaped;
+    int mask;
+    int y;
+    char *pOut;
+
+    if (widths[1] == 0) {
+        // For each mask of escapes in eight bytes, followed by their
+        // escapes, the shuffle which puts each byte or its escape in
+        // place, with a gap for the backslash before each escape
+        for (int x = 0; x < 256; x++) {
+            y = 0;
+            for (int z = 0; z < 8; z++) {
+                if (x & (1 << z)) {
+                    shuffles[x][y] = 0x80;
+                    backslashes[x][y] = '\\';
+                    y++;
+                    shuffles[x][y] = 8 + z;
+                } else {
+                    shuffles[x][y] = z;
+                }
+                y++;
+            }
+            widths[x] = y;
+            for (; y < 16; y++) {
+                shuffles[x][y] = 0x80;
+            }
+        }
+    }
+    while ((size - consumed >= 16) && (count == consumed)) {
+        bytes = _mm_loadu_si128((const __m128i *) (pBuffer + consumed));
+        mask = literalClassify(bytes, &escaped);
+        count = literalFit(mask, 16, limit - (int) (pOutput->pOut - pOutput->pLine), &width);
+        pOut = pOutput->pOut;
+        if (mask == 0) {
+            _mm_storeu_si128((__m128i *) pOut, bytes);
+        } else {
+            _mm_storeu_si128((__m128i *) pOut,
+                             _mm_or_si128(_mm_shuffle_epi8(_mm_unpacklo_epi64(bytes, escaped),
+                                                           _mm_loadu_si128((const __m128i *) shuffles[mask & 0xff])),
+                                          _mm_loadu_si128((const __m128i *) backslashes[mask & 0xff])));
+            pOut += widths[mask & 0xff];
+            _mm_storeu_si128((__m128i *) pOut,
+                             _mm_or_si128(_mm_shuffle_epi8(_mm_unpackhi_epi64(bytes, escaped),
+                                                           _mm_loadu_si128((const __m128i *) shuffles[mask >> 8])),
+                                          _mm_loadu_si128((const __m128i *) backslashes[mask >> 8])));
+        }
+        pOutput->pOut += width;
+        pOutput->position += count;
+        consumed += count;
+        count = (count == 16) ? consumed : -1;
+    }
+# endif
+#else
+    (void) pOutput;
+    (void) pBuffer;
+    (void) size;
+    (void) limit;
+#endif
+
+    return consumed;
+}
+
+// Encode a buffer of input as a string literal, continuing any line already
+// begun by a previous call
+static void literalWrite(Output *pOutput, const char *pBuffer, int size)
+{
+    const char *pIn = pBuffer;
+    char *pLine = pOutput->pLine;
+    int lineLength = pOutput->lineLength;
+    int prefixLength = pOutput->prefixLength;
+    bool endLine = false;
+    int addEscaped = 0;
+    int bulk;
+
+    // Process the input buffer
+    while (pIn < pBuffer + size) {
+        // Assemble the output buffer for each input character.
+        // If we're in the prefix region, add it or a blank (if we've previously
+        // added the prefix)
+        if (pOutput->pOut - pLine < prefixLength) {
+            if (pOutput->pPrefix != NULL) {
+                *pOutput->pOut = *(pOutput->pPrefix + (pOutput->pOut - pLine));
+            } else {
+                *pOutput->pOut = ' ';
+            }
+            pOutput->pOut++;
+        // If we're at the end of the prefix put in the starting quote
+        // and free the prefix buffer if it's not already freed
+        } else if (pOutput->pOut - pLine == prefixLength) {
+            if (pOutput->pPrefix != NULL) {
+                free (pOutput->pPrefix);
+                pOutput->pPrefix = NULL;
+            }
+            *pOutput->pOut = '"';
+            pOutput->pOut++;
+        // If there's an escaped charcter to do, write it now
+        } else if (addEscaped == 2) {
+            *pOutput->pOut = '\\';
+            pOutput->pOut++;
+            addEscaped--;
+        } else if (addEscaped == 1) {
+            *pOutput->pOut = escapedChar(*pIn);
+            pOutput->pOut++;
+            pIn++;
+            pOutput->position++;
+            addEscaped--;
+        } else if ((bulk = literalExpand(pOutput, pIn, (int) (pBuffer + size - pIn),
+                                         lineLength - POSTFIX_LENGTH - 1)) > 0) {
+            // As much as will fit on the line has been done in bulk
+            pIn += bulk;
+        } else {
+            // Process an actual character.
+            // Check whether the current character needs escaping
+            if (escapeRequired(*pIn)) {
+                addEscaped = 2;
+                // If we're already too close to the end of the line to add
+                // this character plus its escape character, then write the
+                // line now
+                if (pOutput->pOut - pLine > lineLength - POSTFIX_LENGTH - 2) {
+                    endLine = true;
+                }
+            } else {
+                *pOutput->pOut = *pIn;
+                pOutput->pOut++;
+                pIn++;
+                pOutput->position++;
+            }
+        }
+        // If we're now at the line length, close the quote, write the line and reset parameters
+        if ((pOutput->pOut - pLine >= lineLength - POSTFIX_LENGTH) || endLine) {
+            *pOutput->pOut = '"';
+            pOutput->pOut++;
+            writeLine(pOutput);
+            endLine = false;
+        }
+    }
+}
+
+// Write whatever is left of a string literal, leaving the output just after
+// the closing quote of the last line
+static void literalEnd(Output *pOutput)
+{
+    if (pOutput->pPrefix != NULL) {
+        // Nothing has been written yet, the input must have
+        // been empty: the result is an empty string
+        memcpy(pOutput->pLine, pOutput->pPrefix, pOutput->prefixLength);
+        pOutput->pOut = pOutput->pLine + pOutput->prefixLength;
+        *pOutput->pOut = '"';
+        pOutput->pOut++;
+    }
+    // Write any characters that might be left in the output buffer at the end
+    if (pOutput->pOut - pOutput->pLine > 0) {
+        *pOutput->pOut = '"';
+        pOutput->pOut++;
+        writeLine(pOutput);
+    }
+}
+
+// Finish off a C string literal
+static void cEnd(Output *pOutput)
+{
+    literalEnd(pOutput);
+    fputc(';', pOutput->pFile);
+    lineEnd(pOutput);
+}
+
+// Start a C++17 std::string_view; the characters are held in a
+// char array so that the length is known at compile time and
+// includes any embedded nulls
+static void stringViewStart(Output *pOutput)
+{
+    fprintf(pOutput->pFile, "#include <string_view>\n\n");
+}
+
+// Finish off a C++17 std::string_view
+static void stringViewEnd(Output *pOutput)
+{
+    literalEnd(pOutput);
+    fputc(';', pOutput->pFile);
+    lineEnd(pOutput);
+    fprintf(pOutput->pFile, "inline constexpr std::string_view %s{%s_data, sizeof(%s_data) - 1};\n",
+            pOutput->pName, pOutput->pName, pOutput->pName);
+}
+
+// Add an element to an initialiser list, starting a new line if it won't fit
+static void writeElement(Output *pOutput, const char *pElement, int length)
+{
+    if ((pOutput->pOut - pOutput->pLine > ELEMENT_INDENT_LENGTH) &&
+        (pOutput->pOut - pOutput->pLine + 1 + length > pOutput->lineLength - 1)) {
+        writeLine(pOutput);
+    }
+    if (pOutput->pOut == pOutput->pLine) {
+        memcpy(pOutput->pOut, ELEMENT_INDENT, ELEMENT_INDENT_LENGTH);
+        pOutput->pOut += ELEMENT_INDENT_LENGTH;
+    } else {
+        *pOutput->pOut = ' ';
+        pOutput->pOut++;
+    }
+    memcpy(pOutput->pOut, pElement, length);
+    pOutput->pOut += length;
+}
+
+// Write whatever is left of an initialiser list and close it
+static void elementsEnd(Output *pOutput)
+{
+    if (pOutput->pOut - pOutput->pLine > 0) {
+        writeLine(pOutput);
+    }
+    if (pOutput->lineOpen) {
+        lineEnd(pOutput);
+    }
+    fprintf(pOutput->pFile, "};\n");
+}
+
+// Start a C++17 std::array of std::byte, which is accompanied
+// by a std::span where the C++20 library provides it
+static void byteArrayStart(Output *pOutput)
+{
+    fprintf(pOutput->pFile, "#include <array>\n#include <cstddef>\n");
+    fprintf(pOutput->pFile, "#ifdef __has_include\n# if __has_include(<version>)\n#  include <version>\n# endif\n#endif\n");
+    fprintf(pOutput->pFile, "#ifdef __cpp_lib_span\n# include <span>\n#endif\n\n");
+    fprintf(pOutput->pFile, "inline constexpr std::array<std::byte, %lld> %s = {\n", pOutput->inputSize, pOutput->pName);
+}
+
+// Encode a buffer of input as std::byte elements
+static void byteArrayWrite(Output *pOutput, const char *pBuffer, int size)
+{
+    char element[ELEMENT_MAX_LENGTH];
+
+    for (int x = 0; x < size; x++) {
+        writeElement(pOutput, element, sprintf(element, "std::byte{0x%02x},", (unsigned char) pBuffer[x]));
+        pOutput->position++;
+    }
+}
+
+// Finish off a C++17 std::array of std::byte
+static void byteArrayEnd(Output *pOutput)
+{
+    elementsEnd(pOutput);
+    fprintf(pOutput->pFile, "#ifdef __cpp_lib_span\ninline constexpr std::span<const std::byte, %lld> %s_span{%s};\n#endif\n",
+            pOutput->inputSize, pOutput->pName, pOutput->pName);
+}
+
+// Start an array of words of pOutput->wordSize bytes, which the target
+// can copy a word at a time, accompanied by the exact length in bytes
+// and a byte pointer to the same storage
+static void wordsStart(Output *pOutput)
+{
+    const char *pEndianness = pOutput->bigEndian ? "BIG" : "LITTLE";
+
+    fprintf(pOutput->pFile, "#include <stddef.h>\n#include <stdint.h>\n\n");
+    // The byte pointer only gives back the input on a target of the right endianness
+    fprintf(pOutput->pFile, "#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_%s_ENDIAN__)\n", pEndianness);
+    fprintf(pOutput->pFile, "# error %s was generated for a %s-endian target\n#endif\n\n",
+            pOutput->pName, pOutput->bigEndian ? "big" : "little");
+    fprintf(pOutput->pFile, "const uint%d_t %s_words[] = {\n", pOutput->wordSize * 8, pOutput->pName);
+}
+
+// Start an array of uint32_t
+static void u32Start(Output *pOutput)
+{
+    pOutput->wordSize = 4;
+    wordsStart(pOutput);
+}
+
+// Start an array of uint64_t
+static void u64Start(Output *pOutput)
+{
+    pOutput->wordSize = 8;
+    wordsStart(pOutput);
+}
+
+// Write the word that has been assembled as an element
+static void writeWord(Output *pOutput)
+{
+    char element[ELEMENT_MAX_LENGTH];
+
+    if (pOutput->bigEndian) {
+        // Pad a partial word at the end with zeroes
+        pOutput->word <<= (pOutput->wordSize - pOutput->wordFill) * 8;
+    }
+    writeElement(pOutput, element, sprintf(element, "0x%0*llx,", pOutput->wordSize * 2,
+                                           (unsigned long long) pOutput->word));
+    pOutput->position += pOutput->wordSize;
+    pOutput->word = 0;
+    pOutput->wordFill = 0;
+}
+
+// Encode a buffer of input as words, continuing any word
+// begun by a previous call
+static void wordsWrite(Output *pOutput, const char *pBuffer, int size)
+{
+    for (int x = 0; x < size; x++) {
+        if (pOutput->bigEndian) {
+            pOutput->word = (pOutput->word << 8) | (unsigned char) pBuffer[x];
+        } else {
+            pOutput->word |= ((uint64_t) (unsigned char) pBuffer[x]) << (pOutput->wordFill * 8);
+        }
+        pOutput->wordFill++;
+        if (pOutput->wordFill == pOutput->wordSize) {
+            writeWord(pOutput);
+        }
+    }
+}
+
+// Finish off an array of words
+static void wordsEnd(Output *pOutput)
+{
+    // Write any partial word, or a single zero word
+    // if the input was empty, as C has no empty arrays
+    if ((pOutput->wordFill > 0) || (pOutput->linesWritten + (pOutput->pOut - pOutput->pLine) == 0)) {
+        writeWord(pOutput);
+    }
+    elementsEnd(pOutput);
+    fprintf(pOutput->pFile, "const size_t %s_len = %lld;\n", pOutput->pName, pOutput->inputSize);
+    fprintf(pOutput->pFile, "const uint8_t * const %s = (const uint8_t *) %s_words;\n", pOutput->pName, pOutput->pName);
+}
+
+// Add text which needs no escaping to a string literal, continuing
+// any line already begun by a previous call
+static void textWrite(Output *pOutput, const char *pText, int size)
+{
+    int space;
+
+    while (size > 0) {
+        if (pOutput->pOut == pOutput->pLine) {
+            // Start a line with the prefix, or blanks if the prefix
+            // has already been written, and the opening quote
+            if (pOutput->pPrefix != NULL) {
+                memcpy(pOutput->pLine, pOutput->pPrefix, pOutput->prefixLength);
+                free (pOutput->pPrefix);
+                pOutput->pPrefix = NULL;
+            } else {
+                memset(pOutput->pLine, ' ', pOutput->prefixLength);
+            }
+            pOutput->pOut = pOutput->pLine + pOutput->prefixLength;
+            *pOutput->pOut = '"';
+            pOutput->pOut++;
+        }
+        // Copy as much as will fit on the line
+        space = pOutput->lineLength - POSTFIX_LENGTH - (pOutput->pOut - pOutput->pLine);
+        if (space > size) {
+            space = size;
+        }
+        memcpy(pOutput->pOut, pText, space);
+        pOutput->pOut += space;
+        pOutput->position += space;
+        pText += space;
+        size -= space;
+        if (pOutput->pOut - pOutput->pLine >= pOutput->lineLength - POSTFIX_LENGTH) {
+            *pOutput->pOut = '"';
+            pOutput->pOut++;
+            writeLine(pOutput);
+        }
+    }
+}
+
+// Base64 encode a whole number of three byte groups, returning the
+// number of characters written to pText, which must have room for
+// four characters for every three bytes
+static int base64Encode(const unsigned char *pBuffer, int size, char *pText)
+{
+    const char *pAlphabet = BASE64_ALPHABET;
+    char *pStart = pText;
+    uint32_t group;
+
+#ifdef __SSSE3__
+    // Twelve bytes at a time become sixteen characters: shuffle each three
+    // byte group into a 32-bit lane, pull out the four 6-bit indexes with
+    // multiplies and then translate the indexes into ASCII using a table
+    // of the offset to add for each range of the alphabet
+    const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                          '/' - 63, 'A', 0, 0);
+    __m128i in;
+    __m128i indexes;
+    __m128i result;
+
+    // The load is sixteen bytes wide, so keep four bytes clear of the end
+    while (size >= 16) {
+        in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) pBuffer), shuffle);
+        indexes = _mm_or_si128(_mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040)),
+                               _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010)));
+        result = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+        result = _mm_or_si128(result, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indexes), _mm_set1_epi8(13)));
+        result = _mm_add_epi8(_mm_shuffle_epi8(offsets, result), indexes);
+        _mm_storeu_si128((__m128i *) pText, result);
+        pBuffer += 12;
+        size -= 12;
+        pText += 16;
+    }
+#endif
+
+    while (size >= 3) {
+        group = (pBuffer[0] << 16) | (pBuffer[1] << 8) | pBuffer[2];
+        *pText++ = pAlphabet[(group >> 18) & 0x3f];
+        *pText++ = pAlphabet[(group >> 12) & 0x3f];
+        *pText++ = pAlphabet[(group >> 6) & 0x3f];
+        *pText++ = pAlphabet[group & 0x3f];
+        pBuffer += 3;
+        size -= 3;
+    }
+
+    return pText - pStart;
+}
+
+// Z85 encode a whole number of four byte groups, returning the number
+// of characters written to pText, which must have room for five
+// characters for every four bytes
+static int z85Encode(const unsigned char *pBuffer, int size, char *pText)
+{
+    const char *pAlphabet = Z85_ALPHABET;
+    char *pStart = pText;
+    uint32_t group;
+
+    while (size >= 4) {
+        group = ((uint32_t) pBuffer[0] << 24) | (pBuffer[1] << 16) | (pBuffer[2] << 8) | pBuffer[3];
+        pText[4] = pAlphabet[group % 85];
+        group /= 85;
+        pText[3] = pAlphabet[group % 85];
+        group /= 85;
+        pText[2] = pAlphabet[group % 85];
+        group /= 85;
+        pText[1] = pAlphabet[group % 85];
+        pText[0] = pAlphabet[group / 85];
+        pBuffer += 4;
+        size -= 4;
+        pText += 5;
+    }
+
+    return pText - pStart;
+}
+
+// Encode a buffer of input as text in groups of groupSize bytes
+// using pEncode, carrying any partial group over to the next call,
+// and add it to the string literal with pTextWrite
+static void groupsWrite(Output *pOutput, const char *pBuffer, int size, int groupSize,
+                        int (*pEncode)(const unsigned char *, int, char *),
+                        void (*pTextWrite)(Output *, const char *, int))
+{
+    const unsigned char *pIn = (const unsigned char *) pBuffer;
+    char text[(INPUT_BUFFER_SIZE / 12 + 1) * 16]; // Enough for either encoding of INPUT_BUFFER_SIZE bytes
+    int length;
+
+    // Complete any group left over from last time
+    while ((pOutput->groupFill > 0) && (size > 0)) {
+        pOutput->group[pOutput->groupFill] = *pIn;
+        pOutput->groupFill++;
+        pIn++;
+        size--;
+        if (pOutput->groupFill == groupSize) {
+            pTextWrite(pOutput, text, pEncode(pOutput->group, groupSize, text));
+            pOutput->groupFill = 0;
+        }
+    }
+    // Encode whole groups, in chunks that fit the text buffer
+    while (size >= groupSize) {
+        length = size - (size % groupSize);
+        if (length > INPUT_BUFFER_SIZE - (INPUT_BUFFER_SIZE % 12)) {
+            length = INPUT_BUFFER_SIZE - (INPUT_BUFFER_SIZE % 12);
+        }
+        pTextWrite(pOutput, text, pEncode(pIn, length, text));
+        pIn += length;
+        size -= length;
+    }
+    // Keep what's left for next time
+    memcpy(pOutput->group + pOutput->groupFill, pIn, size);
+    pOutput->groupFill += size;
+}
+
+// Start a Base64 or Z85 string literal
+static void textSafeStart(Output *pOutput)
+{
+    fprintf(pOutput->pFile, "#include <stddef.h>\n\n");
+}
+
+// Encode a buffer of input as Base64
+static void base64Write(Output *pOutput, const char *pBuffer, int size)
+{
+    groupsWrite(pOutput, pBuffer, size, 3, base64Encode, textWrite);
+}
+
+// Z85 text includes question marks, which are escaped by
+// literalWrite() in case they would otherwise form trigraphs
+static void z85Write(Output *pOutput, const char *pBuffer, int size)
+{
+    groupsWrite(pOutput, pBuffer, size, 4, z85Encode, literalWrite);
+}
+
+// Marks the static functions of the code emitted with arrays, which
+// needn't all be called, so that the compiler doesn't warn of those which
+// aren't; written before any of that code, it may be defined beforehand
+static const char unusedMarker[] =
+    "\n#ifndef ARRAYIFY_UNUSED\n"
+    "# ifdef __GNUC__\n"
+    "#  define ARRAYIFY_UNUSED __attribute__((unused))\n"
+    "# else\n"
+    "#  define ARRAYIFY_UNUSED\n"
+    "# endif\n"
+    "#endif\n";
+
+// Write code which is emitted with an array, after the marker for its
+// static functions
+static void writeHelper(FILE *pFile, const char *pHelper)
+{
+    fprintf(pFile, "%s%s", unusedMarker, pHelper);
+}
+
+// Decoder for Base64, emitted with the array if -d is given
+static const char base64Decoder[] =
+    "\n#ifndef ARRAYIFY_BASE64_DECODE\n"
+    "#define ARRAYIFY_BASE64_DECODE\n"
+    "/* Decode size characters of Base64 text, which may be padded with '=', into\n"
+    "   pBuffer, returning the number of bytes written; text may be decoded in\n"
+    "   pieces provided that each piece but the last is a multiple of four long */\n"
+    "static ARRAYIFY_UNUSED size_t arrayifyBase64Decode(const char *pText, size_t size, unsigned char *pBuffer)\n"
+    "{\n"
+    "    unsigned char *pStart = pBuffer;\n"
+    "    unsigned long group = 0;\n"
+    "    int count = 0;\n"
+    "    int value;\n"
+    "\n"
+    "    for (; (size > 0) && (*pText != '='); pText++, size--) {\n"
+    "        if ((*pText >= 'A') && (*pText <= 'Z')) {\n"
+    "            value = *pText - 'A';\n"
+    "        } else if ((*pText >= 'a') && (*pText <= 'z')) {\n"
+    "            value = *pText - 'a' + 26;\n"
+    "        } else if ((*pText >= '0') && (*pText <= '9')) {\n"
+    "            value = *pText - '0' + 52;\n"
+    "        } else {\n"
+    "            value = (*pText == '+') ? 62 : 63;\n"
+    "        }\n"
+    "        group = (group << 6) | value;\n"
+    "        count++;\n"
+    "        if (count == 4) {\n"
+    "            *pBuffer++ = (unsigned char) (group >> 16);\n"
+    "            *pBuffer++ = (unsigned char) (group >> 8);\n"
+    "            *pBuffer++ = (unsigned char) group;\n"
+    "            group = 0;\n"
+    "            count = 0;\n"
+    "        }\n"
+    "    }\n"
+    "    if (count == 3) {\n"
+    "        *pBuffer++ = (unsigned char) (group >> 10);\n"
+    "        *pBuffer++ = (unsigned char) (group >> 2);\n"
+    "    } else if (count == 2) {\n"
+    "        *pBuffer++ = (unsigned char) (group >> 4);\n"
+    "    }\n"
+    "\n"
+    "    return pBuffer - pStart;\n"
+    "}\n"
+    "#endif\n";
+
+// Decoder for Z85, emitted with the array if -d is given
+static const char z85Decoder[] =
+    "\n#ifndef ARRAYIFY_Z85_DECODE\n"
+    "#define ARRAYIFY_Z85_DECODE\n"
+    "#include <string.h>\n"
+    "/* Decode size characters of Z85 text, a multiple of five, into pBuffer,\n"
+    "   returning the number of bytes written; the last group is padded with\n"
+    "   zeroes, the decoded length of the original being given by name_decoded_len */\n"
+    "static ARRAYIFY_UNUSED size_t arrayifyZ85Decode(const char *pText, size_t size, unsigned char *pBuffer)\n"
+    "{\n"
+    "    static const char alphabet[] = \"" Z85_ALPHABET "\";\n"
+    "    unsigned char *pStart = pBuffer;\n"
+    "    unsigned long group;\n"
+    "    int x;\n"
+    "\n"
+    "    for (; size >= 5; pText += 5, size -= 5) {\n"
+    "        group = 0;\n"
+    "        for (x = 0; x < 5; x++) {\n"
+    "            group = group * 85 + (strchr(alphabet, pText[x]) - alphabet);\n"
+    "        }\n"
+    "        *pBuffer++ = (unsigned char) (group >> 24);\n"
+    "        *pBuffer++ = (unsigned char) (group >> 16);\n"
+    "        *pBuffer++ = (unsigned char) (group >> 8);\n"
+    "        *pBuffer++ = (unsigned char) group;\n"
+    "    }\n"
+    "\n"
+    "    return pBuffer - pStart;\n"
+    "}\n"
+    "#endif\n";
+
+// Finish off a Base64 string literal, padding any partial group with '='
+static void base64End(Output *pOutput)
+{
+    char text[4];
+
+    if (pOutput->groupFill > 0) {
+        memset(pOutput->group + pOutput->groupFill, 0, 3 - pOutput->groupFill);
+        base64Encode(pOutput->group, 3, text);
+        memset(text + pOutput->groupFill + 1, '=', 3 - pOutput->groupFill);
+        textWrite(pOutput, text, sizeof(text));
+    }
+    literalEnd(pOutput);
+    fputc(';', pOutput->pFile);
+    lineEnd(pOutput);
+    fprintf(pOutput->pFile, "const size_t %s_decoded_len = %lld;\n", pOutput->pName, pOutput->inputSize);
+    if (pOutput->decoder) {
+        writeHelper(pOutput->pFile, base64Decoder);
+    }
+}
+
+// Finish off a Z85 string literal, padding any partial group with zeroes
+static void z85End(Output *pOutput)
+{
+    char text[5];
+
+    if (pOutput->groupFill > 0) {
+        memset(pOutput->group + pOutput->groupFill, 0, 4 - pOutput->groupFill);
+        literalWrite(pOutput, text, z85Encode(pOutput->group, 4, text));
+    }
+    literalEnd(pOutput);
+    fputc(';', pOutput->pFile);
+    lineEnd(pOutput);
+    fprintf(pOutput->pFile, "const size_t %s_decoded_len = %lld;\n", pOutput->pName, pOutput->inputSize);
+    if (pOutput->decoder) {
+        writeHelper(pOutput->pFile, z85Decoder);
+    }
+}
+
+// Write a byte as an element of a C initialiser list
+static void writeByte(Output *pOutput, unsigned char byte)
+{
+    char element[ELEMENT_MAX_LENGTH];
+
+    writeElement(pOutput, element, sprintf(element, "0x%02x,", byte));
+    pOutput->position++;
+}
+
+// Write the literal bytes waiting in the run-length encoder, preceded by their count
+static void rleFlushLiteral(Output *pOutput)
+{
+    if (pOutput->literalCount > 0) {
+        writeByte(pOutput, (unsigned char) (pOutput->literalCount - 1));
+        for (int x = 0; x < pOutput->literalCount; x++) {
+            writeByte(pOutput, pOutput->literal[x]);
+        }
+        pOutput->literalCount = 0;
+    }
+}
+
+// Write the run of repeated bytes in the run-length encoder: long enough
+// runs are written as repeats, shorter ones are added to the literal bytes
+static void rleFlushRun(Output *pOutput)
+{
+    long long count;
+
+    if (pOutput->runCount >= RLE_MIN_RUN) {
+        rleFlushLiteral(pOutput);
+        while (pOutput->runCount >= RLE_MIN_RUN) {
+            count = pOutput->runCount;
+            if (count > RLE_MAX_RUN) {
+                // Long form: 0xff, the byte and a 32-bit little-endian count
+                if ((unsigned long long) count > RLE_LONG_RUN) {
+                    count = RLE_LONG_RUN;
+                }
+                writeByte(pOutput, 0xff);
+                writeByte(pOutput, (unsigned char) pOutput->runByte);
+                for (int x = 0; x < 4; x++) {
+                    writeByte(pOutput, (unsigned char) (count >> (x * 8)));
+                }
+            } else {
+                writeByte(pOutput, (unsigned char) (0x80 + count - RLE_MIN_RUN));
+                writeByte(pOutput, (unsigned char) pOutput->runByte);
+            }
+            pOutput->runCount -= count;
+        }
+    }
+    for (; pOutput->runCount > 0; pOutput->runCount--) {
+        pOutput->literal[pOutput->literalCount] = (unsigned char) pOutput->runByte;
+        pOutput->literalCount++;
+        if (pOutput->literalCount == RLE_MAX_LITERAL) {
+            rleFlushLiteral(pOutput);
+        }
+    }
+}
+
+// Start a run-length encoded array
+static void rleStart(Output *pOutput)
+{
+    fprintf(pOutput->pFile, "#include <stddef.h>\n#include <string.h>\n\n");
+    fprintf(pOutput->pFile, "const unsigned char %s_rle[] = {\n", pOutput->pName);
+}
+
+// Run-length encode a buffer of input, continuing any run
+// begun by a previous call
+static void rleWrite(Output *pOutput, const char *pBuffer, int size)
+{
+    for (int x = 0; x < size; x++) {
+        if ((unsigned char) pBuffer[x] == pOutput->runByte) {
+            pOutput->runCount++;
+        } else {
+            rleFlushRun(pOutput);
+            pOutput->runByte = (unsigned char) pBuffer[x];
+            pOutput->runCount = 1;
+        }
+    }
+}
+
+// Run-length encode a hole in the input
+static void rleZeros(Output *pOutput, long long size)
+{
+    if (pOutput->runByte != 0) {
+        rleFlushRun(pOutput);
+        pOutput->runByte = 0;
+    }
+    pOutput->runCount += size;
+}
+
+// Expander for run-length encoded arrays
+static const char rleExpander[] =
+    "\n#ifndef ARRAYIFY_RLE_EXPAND\n"
+    "#define ARRAYIFY_RLE_EXPAND\n"
+    "/* Expand size bytes of run-length encoded data into pBuffer, returning the\n"
+    "   number of bytes written: a control byte below 0x80 is followed by that many\n"
+    "   plus one bytes to copy, a control byte from 0x80 to 0xfe is followed by one\n"
+    "   byte to repeat the control byte less 0x7d times and a control byte of 0xff\n"
+    "   is followed by one byte to repeat and a 32-bit little-endian count */\n"
+    "static ARRAYIFY_UNUSED size_t arrayifyRleExpand(const unsigned char *pRle, size_t size, unsigned char *pBuffer)\n"
+    "{\n"
+    "    const unsigned char *pEnd = pRle + size;\n"
+    "    unsigned char *pStart = pBuffer;\n"
+    "    size_t count;\n"
+    "\n"
+    "    while (pRle < pEnd) {\n"
+    "        if (*pRle < 0x80) {\n"
+    "            count = *pRle + 1;\n"
+    "            memcpy(pBuffer, pRle + 1, count);\n"
+    "            pRle += count + 1;\n"
+    "        } else if (*pRle < 0xff) {\n"
+    "            count = *pRle - 0x7d;\n"
+    "            memset(pBuffer, pRle[1], count);\n"
+    "            pRle += 2;\n"
+    "        } else {\n"
+    "            count = pRle[2] | ((size_t) pRle[3] << 8) | ((size_t) pRle[4] << 16) | ((size_t) pRle[5] << 24);\n"
+    "            memset(pBuffer, pRle[1], count);\n"
+    "            pRle += 6;\n"
+    "        }\n"
+    "        pBuffer += count;\n"
+    "    }\n"
+    "\n"
+    "    return pBuffer - pStart;\n"
+    "}\n"
+    "#endif\n";
+
+// Finish off a run-length encoded array
+static void rleEnd(Output *pOutput)
+{
+    long long rleLength;
+
+    rleFlushRun(pOutput);
+    rleFlushLiteral(pOutput);
+    rleLength = pOutput->position;
+    if (rleLength == 0) {
+        // C has no empty arrays
+        writeByte(pOutput, 0);
+    }
+    elementsEnd(pOutput);
+    fprintf(pOutput->pFile, "const size_t %s_rle_len = %lld;\n", pOutput->pName, rleLength);
+    fprintf(pOutput->pFile, "const size_t %s_len = %lld;\n", pOutput->pName, pOutput->inputSize);
+    writeHelper(pOutput->pFile, rleExpander);
+}
+
+// Add an entry of two values to the table of extents
+static void addExtent(Output *pOutput, long long first, long long second)
+{
+    long long *pExtents;
+
+    if (pOutput->extentCount * 2 >= pOutput->extentsAllocated) {
+        pExtents = (long long *) realloc (pOutput->pExtents, (pOutput->extentsAllocated + 64) * sizeof(long long));
+        if (pExtents != NULL) {
+            pOutput->pExtents = pExtents;
+            pOutput->extentsAllocated += 64;
+        }
+    }
+    if (pOutput->extentCount * 2 < pOutput->extentsAllocated) {
+        pOutput->pExtents[pOutput->extentCount * 2] = first;
+        pOutput->pExtents[pOutput->extentCount * 2 + 1] = second;
+        pOutput->extentCount++;
+    } else {
+        printf("Cannot allocate memory for extent table.\n");
+    }
+}
+
+// Close the extent of a sparse array being written, if there is one
+static void sparseCloseExtent(Output *pOutput)
+{
+    if (pOutput->inExtent) {
+        elementsEnd(pOutput);
+        addExtent(pOutput, pOutput->extentStart, pOutput->position - pOutput->extentStart);
+        pOutput->inExtent = false;
+    }
+}
+
+// Start a sparse array: the array itself is left zero, in .bss,
+// and only the extents which contain something other than zeroes
+// are stored, to be copied into it at start of day
+static void sparseStart(Output *pOutput)
+{
+    fprintf(pOutput->pFile, "#include <stddef.h>\n#include <string.h>\n\n");
+    fprintf(pOutput->pFile, "#ifndef ARRAYIFY_EXTENT\n#define ARRAYIFY_EXTENT\n");
+    fprintf(pOutput->pFile, "typedef struct {\n    size_t offset;\n    size_t length;\n    const unsigned char *pData;\n} ArrayifyExtent;\n#endif\n\n");
+}
+
+// Write a buffer of input to a sparse array, leaving out runs of
+// at least SPARSE_MIN_GAP zeroes
+static void sparseWrite(Output *pOutput, const char *pBuffer, int size)
+{
+    for (int x = 0; x < size; x++) {
+        if (pBuffer[x] == 0) {
+            pOutput->runCount++;
+            if (pOutput->runCount == SPARSE_MIN_GAP) {
+                sparseCloseExtent(pOutput);
+            }
+        } else {
+            if (pOutput->inExtent) {
+                // Zeroes between data, too few to be worth leaving out
+                for (; pOutput->runCount > 0; pOutput->runCount--) {
+                    writeByte(pOutput, 0);
+                }
+            } else {
+                pOutput->position += pOutput->runCount;
+                pOutput->lineOffset = pOutput->position;
+                pOutput->extentStart = pOutput->position;
+                pOutput->inExtent = true;
+                fprintf(pOutput->pFile, "static const unsigned char %s_extent_%d[] = {\n",
+                        pOutput->pName, pOutput->extentCount);
+            }
+            pOutput->runCount = 0;
+            writeByte(pOutput, (unsigned char) pBuffer[x]);
+        }
+    }
+}
+
+// Add a hole in the input to a sparse array
+static void sparseZeros(Output *pOutput, long long size)
+{
+    pOutput->runCount += size;
+    if (pOutput->runCount >= SPARSE_MIN_GAP) {
+        sparseCloseExtent(pOutput);
+    }
+}
+
+// Finish off a sparse array with the table of extents and
+// a function to copy them in
+static void sparseEnd(Output *pOutput)
+{
+    sparseCloseExtent(pOutput);
+    fprintf(pOutput->pFile, "unsigned char %s[%lld];\n\n", pOutput->pName, (pOutput->inputSize > 0) ? pOutput->inputSize : 1);
+    fprintf(pOutput->pFile, "const ArrayifyExtent %s_extents[] = {\n", pOutput->pName);
+    for (int x = 0; x < pOutput->extentCount; x++) {
+        fprintf(pOutput->pFile, "    {%lld, %lld, %s_extent_%d},\n", pOutput->pExtents[x * 2],
+                pOutput->pExtents[x * 2 + 1], pOutput->pName, x);
+    }
+    if (pOutput->extentCount == 0) {
+        // C has no empty arrays
+        fprintf(pOutput->pFile, "    {0, 0, NULL}\n");
+    }
+    fprintf(pOutput->pFile, "};\nconst size_t %s_extents_count = %d;\n", pOutput->pName, pOutput->extentCount);
+    fprintf(pOutput->pFile, "const size_t %s_len = %lld;\n\n", pOutput->pName, pOutput->inputSize);
+    fprintf(pOutput->pFile, "/* Copy the extents into %s; call this once at start of day */\n", pOutput->pName);
+    fprintf(pOutput->pFile, "void %s_init(void)\n{\n    size_t x;\n\n", pOutput->pName);
+    fprintf(pOutput->pFile, "    for (x = 0; x < %s_extents_count; x++) {\n", pOutput->pName);
+    fprintf(pOutput->pFile, "        memcpy(%s + %s_extents[x].offset, %s_extents[x].pData, %s_extents[x].length);\n    }\n}\n",
+            pOutput->pName, pOutput->pName, pOutput->pName, pOutput->pName);
+    free(pOutput->pExtents);
+    pOutput->pExtents = NULL;
+}
+
+// Close the segment of an adaptive array being written, if there is one
+static void adaptiveCloseSegment(Output *pOutput)
+{
+    if (pOutput->segmentKind == SEGMENT_TEXT) {
+        if (pOutput->pOut - pOutput->pLine > 0) {
+            *pOutput->pOut = '"';
+            pOutput->pOut++;
+            writeLine(pOutput);
+        }
+        fputc(',', pOutput->pFile);
+        lineEnd(pOutput);
+    } else if (pOutput->segmentKind == SEGMENT_BINARY) {
+        writeElement(pOutput, "},", 2);
+        writeLine(pOutput);
+        lineEnd(pOutput);
+    }
+    if (pOutput->segmentKind != SEGMENT_NONE) {
+        addExtent(pOutput, pOutput->segmentKind, pOutput->position - pOutput->extentStart);
+    }
+    pOutput->segmentKind = SEGMENT_NONE;
+}
+
+// Start an adaptive array: each block of the input is written as a
+// string literal or as bytes, whichever is the shorter, consecutive
+// blocks of the same kind making up a segment; the segments are the
+// members of a struct, so that they are contiguous, which can only be
+// declared once they are known, so they go to a temporary file first
+static void adaptiveStart(Output *pOutput)
+{
+    pOutput->pHeldFile = pOutput->pFile;
+    pOutput->pFile = tmpfile();
+    if (pOutput->pFile == NULL) {
+        printf("Cannot create temporary file (%s), output will be incomplete.\n", strerror(errno));
+        pOutput->pFile = pOutput->pHeldFile;
+        pOutput->pHeldFile = NULL;
+    }
+    // String literal segments are indented like the elements of the binary ones
+    pOutput->prefixLength = ELEMENT_INDENT_LENGTH;
+    if (pOutput->lineLength < ELEMENT_INDENT_LENGTH + 5) {
+        // pLine has room for ELEMENT_MAX_LENGTH beyond the line length
+        pOutput->lineLength = ELEMENT_INDENT_LENGTH + 5;
+    }
+}
+
+// Write a buffer of input to an adaptive array, choosing for each
+// block whether it is cheaper as a string literal or as bytes
+static void adaptiveWrite(Output *pOutput, const char *pBuffer, int size)
+{
+    int blockSize;
+    long textCost;
+    long binaryCost;
+    SegmentKind kind;
+
+    for (; size > 0; pBuffer += blockSize, size -= blockSize) {
+        blockSize = (size < ADAPTIVE_BLOCK_SIZE) ? size : ADAPTIVE_BLOCK_SIZE;
+        // Count the escapes; bytes which are neither printable
+        // nor escapable rule out a string literal altogether
+        textCost = 0;
+        for (int x = 0; (x < blockSize) && (textCost >= 0); x++) {
+            if (escapeRequired(pBuffer[x])) {
+                textCost += 2;
+            } else if ((pBuffer[x] >= 0x20) && (pBuffer[x] < 0x7f)) {
+                textCost++;
+            } else {
+                textCost = -1;
+            }
+        }
+        binaryCost = (long) blockSize * ADAPTIVE_ELEMENT_COST;
+        if (pOutput->segmentKind == SEGMENT_TEXT) {
+            binaryCost += ADAPTIVE_SWITCH_COST;
+        } else if ((pOutput->segmentKind == SEGMENT_BINARY) && (textCost >= 0)) {
+            textCost += ADAPTIVE_SWITCH_COST;
+        }
+        kind = ((textCost >= 0) && (textCost <= binaryCost)) ? SEGMENT_TEXT : SEGMENT_BINARY;
+        if (kind != pOutput->segmentKind) {
+            adaptiveCloseSegment(pOutput);
+            pOutput->segmentKind = kind;
+            pOutput->extentStart = pOutput->position;
+            if (kind == SEGMENT_BINARY) {
+                writeElement(pOutput, "{", 1);
+            }
+        }
+        if (kind == SEGMENT_TEXT) {
+            literalWrite(pOutput, pBuffer, blockSize);
+        } else {
+            for (int x = 0; x < blockSize; x++) {
+                writeByte(pOutput, (unsigned char) pBuffer[x]);
+            }
+        }
+    }
+}
+
+// Finish off an adaptive array: declare the struct of segments
+// and copy them in from the temporary file
+static void adaptiveEnd(Output *pOutput)
+{
+    char buffer[INPUT_BUFFER_SIZE];
+    size_t length;
+    FILE *pSegmentsFile = pOutput->pFile;
+
+    if (pOutput->position == 0) {
+        // C has no empty arrays
+        adaptiveWrite(pOutput, "", 1);
+    }
+    adaptiveCloseSegment(pOutput);
+    if (pOutput->pHeldFile != NULL) {
+        pOutput->pFile = pOutput->pHeldFile;
+        pOutput->pHeldFile = NULL;
+    }
+    fprintf(pOutput->pFile, "#include <stddef.h>\n\n");
+    fprintf(pOutput->pFile, "/* The segments of %s: string literals exactly fill their arrays, without a terminator */\n",
+            pOutput->pName);
+    fprintf(pOutput->pFile, "static const struct {\n");
+    for (int x = 0; x < pOutput->extentCount; x++) {
+        fprintf(pOutput->pFile, "    %schar s%d[%lld];\n", (pOutput->pExtents[x * 2] == SEGMENT_BINARY) ? "unsigned " : "",
+                x, pOutput->pExtents[x * 2 + 1]);
+    }
+    fprintf(pOutput->pFile, "} %s_segments = {\n", pOutput->pName);
+    if (pSegmentsFile != pOutput->pFile) {
+        rewind(pSegmentsFile);
+        while ((length = fread(buffer, 1, sizeof(buffer), pSegmentsFile)) > 0) {
+            fwrite(buffer, length, 1, pOutput->pFile);
+        }
+        fclose(pSegmentsFile);
+    }
+    fprintf(pOutput->pFile, "};\n");
+    // Fails to compile if the compiler has put padding between the segments
+    fprintf(pOutput->pFile, "typedef char %s_contiguous[(sizeof(%s_segments) == %lld) ? 1 : -1];\n",
+            pOutput->pName, pOutput->pName, pOutput->position);
+    fprintf(pOutput->pFile, "const unsigned char * const %s = (const unsigned char *) &%s_segments;\n",
+            pOutput->pName, pOutput->pName);
+    fprintf(pOutput->pFile, "const size_t %s_len = %lld;\n", pOutput->pName, pOutput->inputSize);
+    free(pOutput->pExtents);
+    pOutput->pExtents = NULL;
+}
+
+// Return true if a raw string literal can hold the given byte as it is:
+// control characters other than tab and newline, carriage return in
+// particular, may not survive the compiler reading the source
+static bool rawCarries(unsigned char byte)
+{
+    return ((byte >= 0x20) && (byte != 0x7f)) || (byte == '\n') || (byte == '\t');
+}
+
+// Start a line which is written straight to file rather than being
+// assembled in pLine, as a raw string literal is since it may hold
+// any number of newlines
+static void rawLineStart(Output *pOutput)
+{
+    if (pOutput->lineOpen) {
+        lineEnd(pOutput);
+    }
+    if (pOutput->pTemplate != NULL) {
+        writeTemplate(pOutput, TEMPLATE_LINE_PREFIX, pOutput->lineOffset);
+    }
+    pOutput->writtenOffset = pOutput->lineOffset;
+    pOutput->lineOpen = true;
+    pOutput->linesWritten++;
+}
+
+// Choose the shortest delimiter for a raw string literal holding a chunk
+// of input, one for which )delimiter" is not in the chunk: a single pass
+// over the ) in the chunk rules out each delimiter, of up to two
+// characters, which it would end.  There is always one left since ruling
+// out all of them takes )" and )c" and )cc" for every c in the alphabet,
+// 16067 bytes, which is more than RAW_CHUNK_SIZE.
+static void rawDelimiter(const char *pChunk, int size, char *pDelimiter)
+{
+    static const char alphabet[] = RAW_DELIMITER_ALPHABET;
+    const int count = sizeof(alphabet) - 1;
+    bool ruledOut[1 + (sizeof(alphabet) - 1) * sizeof(alphabet)];
+    const char *pEnd = pChunk + size;
+    const char *pIn = pChunk;
+    const char *pFirst;
+    const char *pSecond;
+    int x = 0;
+
+    memset(ruledOut, 0, sizeof(ruledOut));
+    while ((pIn = (const char *) memchr(pIn, ')', pEnd - pIn)) != NULL) {
+        pIn++;
+        // The empty delimiter is index 0, those of one character
+        // follow and then those of two
+        if ((pIn < pEnd) && (*pIn == '"')) {
+            ruledOut[0] = true;
+        } else if ((pIn + 1 < pEnd) && (pIn[1] == '"') && ((pFirst = strchr(alphabet, pIn[0])) != NULL) &&
+                   (*pFirst != 0)) {
+            ruledOut[1 + (pFirst - alphabet)] = true;
+        } else if ((pIn + 2 < pEnd) && (pIn[2] == '"') && ((pFirst = strchr(alphabet, pIn[0])) != NULL) &&
+                   (*pFirst != 0) && ((pSecond = strchr(alphabet, pIn[1])) != NULL) && (*pSecond != 0)) {
+            ruledOut[1 + count + (pFirst - alphabet) * count + (pSecond - alphabet)] = true;
+        }
+    }
+    while ((x < (int) sizeof(ruledOut)) && ruledOut[x]) {
+        x++;
+    }
+    if (x == 0) {
+        pDelimiter[0] = 0;
+    } else if (x <= count) {
+        pDelimiter[0] = alphabet[x - 1];
+        pDelimiter[1] = 0;
+    } else {
+        pDelimiter[0] = alphabet[(x - 1 - count) / count];
+        pDelimiter[1] = alphabet[(x - 1 - count) % count];
+        pDelimiter[2] = 0;
+    }
+}
+
+// Add a byte to an ordinary string literal, for the bytes which a raw
+// string literal cannot hold, starting a new line if it won't fit; octal
+// escapes are as short as they can be since another escape, or the end
+// of the literal, always follows
+static void rawEscaped(Output *pOutput, unsigned char byte)
+{
+    char element[8];
+    int length = 1;
+
+    if (byte == '\r') {
+        strcpy(element, "\\r");
+        length = 2;
+    } else if (!rawCarries(byte)) {
+        length = sprintf(element, "\\%o", byte);
+    } else if (escapeRequired(byte)) {
+        element[0] = '\\';
+        element[1] = escapedChar(byte);
+        length = 2;
+    } else {
+        element[0] = byte;
+    }
+    if ((pOutput->pOut > pOutput->pLine) &&
+        (pOutput->pOut - pOutput->pLine + length > pOutput->lineLength - POSTFIX_LENGTH)) {
+        *pOutput->pOut = '"';
+        pOutput->pOut++;
+        writeLine(pOutput);
+    }
+    if (pOutput->pOut == pOutput->pLine) {
+        memcpy(pOutput->pOut, ELEMENT_INDENT, ELEMENT_INDENT_LENGTH);
+        pOutput->pOut += ELEMENT_INDENT_LENGTH;
+        *pOutput->pOut = '"';
+        pOutput->pOut++;
+    }
+    memcpy(pOutput->pOut, element, length);
+    pOutput->pOut += length;
+    pOutput->position++;
+}
+
+// Close any ordinary string literal being written by rawEscaped()
+static void rawCloseEscaped(Output *pOutput)
+{
+    if (pOutput->pOut > pOutput->pLine) {
+        *pOutput->pOut = '"';
+        pOutput->pOut++;
+        writeLine(pOutput);
+    }
+}
+
+// Write size bytes of input as a single raw string literal
+static void rawLiteral(Output *pOutput, const char *pStart, int size)
+{
+    char delimiter[3];
+    const char *pIn = pStart;
+    const char *pEnd = pStart + size;
+
+    rawDelimiter(pStart, size, delimiter);
+    rawLineStart(pOutput);
+    fprintf(pOutput->pFile, ELEMENT_INDENT "R\"%s(", delimiter);
+    fwrite(pStart, size, 1, pOutput->pFile);
+    fprintf(pOutput->pFile, ")%s\"", delimiter);
+    while ((pIn = (const char *) memchr(pIn, '\n', pEnd - pIn)) != NULL) {
+        pIn++;
+        pOutput->linesWritten++;
+    }
+    PROBE3(line__flushed, pOutput->pName, pOutput->linesWritten, (long) size);
+    pOutput->position += size;
+    pOutput->lineOffset = pOutput->position;
+}
+
+// Write the first size bytes of the chunk as raw string literals,
+// keeping the rest for the next.  A backslash followed by spaces or tabs
+// and then a newline is a line splice to g++, and to C++23, even in a
+// raw string literal, so that backslash and its spaces or tabs go in an
+// ordinary string literal between two raw ones.
+static void rawFlushChunk(Output *pOutput, int size)
+{
+    const char *pStart = pOutput->pChunk;
+    const char *pIn = pOutput->pChunk;
+    const char *pEnd = pOutput->pChunk + size;
+    const char *pSpace;
+
+    if (size > 0) {
+        while ((pIn = (const char *) memchr(pIn, '\\', pEnd - pIn)) != NULL) {
+            for (pSpace = pIn + 1; (pSpace < pEnd) && ((*pSpace == ' ') || (*pSpace == '\t')); pSpace++) {}
+            if ((pSpace > pIn + 1) && (pSpace < pEnd) && (*pSpace == '\n')) {
+                if (pIn > pStart) {
+                    rawLiteral(pOutput, pStart, (int) (pIn - pStart));
+                }
+                for (; pIn < pSpace; pIn++) {
+                    rawEscaped(pOutput, *pIn);
+                }
+                rawCloseEscaped(pOutput);
+                pStart = pSpace;
+            }
+            pIn = pSpace;
+        }
+        rawLiteral(pOutput, pStart, (int) (pEnd - pStart));
+        pOutput->chunkFill -= size;
+        memmove(pOutput->pChunk, pOutput->pChunk + size, pOutput->chunkFill);
+    }
+}
+
+// Start a C++11 const char array of raw string literals
+static void rawStart(Output *pOutput)
+{
+    pOutput->pChunk = (char *) malloc(RAW_CHUNK_SIZE);
+    if (pOutput->pChunk == NULL) {
+        printf("Cannot allocate memory for raw string literals, the input will be escaped.\n");
+    }
+    rawLineStart(pOutput);
+    fprintf(pOutput->pFile, "const char %s[] =", pOutput->pName);
+}
+
+// Write a buffer of input as raw string literals, which need no
+// escaping, so each run of bytes which they can hold is copied as it
+// is, in chunks within the limits of compilers; only the bytes which
+// they cannot hold are escaped, in ordinary string literals
+static void rawWrite(Output *pOutput, const char *pBuffer, int size)
+{
+    const unsigned char *pIn = (const unsigned char *) pBuffer;
+    const unsigned char *pEnd = pIn + size;
+    const unsigned char *pRun = pIn;
+    int length;
+    int cut;
+
+    while (pIn < pEnd) {
+        if (pOutput->pChunk != NULL) {
+            for (pRun = pIn; (pRun < pEnd) && rawCarries(*pRun); pRun++) {}
+        }
+        if (pRun > pIn) {
+            rawCloseEscaped(pOutput);
+        }
+        while (pIn < pRun) {
+            length = RAW_CHUNK_SIZE - pOutput->chunkFill;
+            if (length > pRun - pIn) {
+                length = (int) (pRun - pIn);
+            }
+            memcpy(pOutput->pChunk + pOutput->chunkFill, pIn, length);
+            pOutput->chunkFill += length;
+            pIn += length;
+            if (pOutput->chunkFill == RAW_CHUNK_SIZE) {
+                // Don't split a UTF-8 sequence between literals
+                cut = RAW_CHUNK_SIZE - 1;
+                while ((cut > RAW_CHUNK_SIZE - 4) && ((pOutput->pChunk[cut] & 0xc0) == 0x80)) {
+                    cut--;
+                }
+                if ((pOutput->pChunk[cut] & 0xc0) != 0xc0) {
+                    cut = RAW_CHUNK_SIZE;
+                }
+                rawFlushChunk(pOutput, cut);
+            }
+        }
+        if ((pIn < pEnd) && (pOutput->chunkFill > 0)) {
+            rawFlushChunk(pOutput, pOutput->chunkFill);
+        }
+        for (; (pIn < pEnd) && ((pOutput->pChunk == NULL) || !rawCarries(*pIn)); pIn++) {
+            rawEscaped(pOutput, *pIn);
+        }
+    }
+}
+
+// Finish off an array of raw string literals
+static void rawEnd(Output *pOutput)
+{
+    if (pOutput->chunkFill > 0) {
+        rawFlushChunk(pOutput, pOutput->chunkFill);
+    }
+    rawCloseEscaped(pOutput);
+    if (pOutput->position == 0) {
+        // The input was empty
+        rawLineStart(pOutput);
+        fprintf(pOutput->pFile, ELEMENT_INDENT "\"\"");
+    }
+    fputc(';', pOutput->pFile);
+    lineEnd(pOutput);
+    free(pOutput->pChunk);
+    pOutput->pChunk = NULL;
+}
+
+// Find the default name of the array for an input file, its file name without
+// any path or extension, the extension being cut off in place
+static char *defaultName(char *pFileName)
+{
+    char *pName = pFileName;
+    char *pExtension;
+
+    for (char *pTmp = pFileName; *pTmp != 0; pTmp++) {
+        if (strchr(DIR_SEPARATORS, *pTmp) != NULL) {
+            pName = pTmp + 1;
+        }
+    }
+    pExtension = strrchr(pName, *EXT_SEPARATOR);
+    if (pExtension != NULL) {
+        *pExtension = 0;
+    }
+
+    return pName;
+}
+
+// Write length characters as the contents of a C string literal
+static void writeQuoted(FILE *pFile, const char *pString, size_t length)
+{
+    for (size_t x = 0; x < length; x++) {
+        if (escapeRequired(pString[x])) {
+            fputc('\\', pFile);
+            fputc(escapedChar(pString[x]), pFile);
+        } else if (pString[x] == 0) {
+            // As three digits, in case a digit follows
+            fprintf(pFile, "\\000");
+        } else {
+            fputc(pString[x], pFile);
+        }
+    }
+}
+
+// Split a row of a table into its fields in place, removing the quotes
+// from quoted fields, a doubled quote in them being one quote; returns
+// the number of fields, which may be more than max, only the first
+// max of which are put in ppFields
+static int tableSplit(char *pRecord, char delimiter, char **ppFields, int max)
+{
+    char *pIn = pRecord;
+    char *pOut = pRecord;
+    bool inQuotes = false;
+    int count = 0;
+
+    while (true) {
+        if (count < max) {
+            ppFields[count] = pOut;
+        }
+        count++;
+        for (; (*pIn != 0) && (inQuotes || (*pIn != delimiter)); pIn++) {
+            if (*pIn == '"') {
+                if (inQuotes && (*(pIn + 1) == '"')) {
+                    *pOut = '"';
+                    pOut++;
+                    pIn++;
+                } else {
+                    inQuotes = !inQuotes;
+                }
+            } else {
+                *pOut = *pIn;
+                pOut++;
+            }
+        }
+        if (*pIn == 0) {
+            *pOut = 0;
+            break;
+        }
+        *pOut = 0;
+        pOut++;
+        pIn++;
+    }
+
+    return count;
+}
+
+// Remove the white space from either end of a field
+static char *tableTrim(char *pField)
+{
+    char *pEnd = pField + strlen(pField);
+
+    while (isspace((unsigned char) *pField)) {
+        pField++;
+    }
+    while ((pEnd > pField) && isspace((unsigned char) *(pEnd - 1))) {
+        pEnd--;
+    }
+    *pEnd = 0;
+
+    return pField;
+}
+
+// Set up the columns of a table from a schema, a name:type for each field,
+// where type is one of columnTypes[] and char is followed by its width,
+// e.g. "channel:u16,gain:f32,label:char8"; returns false if it is not valid.
+// The columns are sorted by size, largest first, which is the order of the
+// members of a row, so that there is no padding between them.
+static bool tableColumns(Output *pOutput, char *pSchema, char delimiter)
+{
+    char *pFields[TABLE_MAX_COLUMNS];
+    char *pName;
+    char *pType;
+    char *pEnd;
+    Column *pColumn;
+    Column column;
+    int y;
+    int count = tableSplit(pSchema, delimiter, pFields, TABLE_MAX_COLUMNS);
+    bool valid = true;
+
+    if (count > TABLE_MAX_COLUMNS) {
+        printf("Table %s has %d columns, the most is %d.\n", pOutput->pName, count, TABLE_MAX_COLUMNS);
+        return false;
+    }
+    pOutput->pColumns = (Column *) malloc(count * sizeof(Column));
+    if (pOutput->pColumns == NULL) {
+        printf("Cannot allocate memory for the columns of table %s.\n", pOutput->pName);
+        return false;
+    }
+    for (int x = 0; (x < count) && valid; x++) {
+        pColumn = &(pOutput->pColumns[x]);
+        pName = tableTrim(pFields[x]);
+        pType = strchr(pName, ':');
+        valid = (pType != NULL) && (pType - pName < TABLE_NAME_LENGTH) && (isalpha((unsigned char) *pName) || (*pName == '_'));
+        if (valid) {
+            *pType = 0;
+            pType++;
+            for (pEnd = pName; (*pEnd != 0) && valid; pEnd++) {
+                valid = isalnum((unsigned char) *pEnd) || (*pEnd == '_');
+            }
+            strcpy(pColumn->name, pName);
+            pColumn->width = 1;
+            for (pColumn->type = COLUMN_I8; (pColumn->type < COLUMN_CHAR) &&
+                                             (strcmp(pType, columnTypes[pColumn->type].pName) != 0);
+                 pColumn->type = (ColumnType) (pColumn->type + 1)) {}
+            if ((pColumn->type == COLUMN_CHAR) && valid) {
+                // The width follows, e.g. char16
+                valid = (strncmp(pType, "char", 4) == 0) && isdigit((unsigned char) *(pType + 4));
+                if (valid) {
+                    pColumn->width = (int) strtol(pType + 4, &pEnd, 10);
+                    valid = (*pEnd == 0) && (pColumn->width > 1) && (pColumn->width <= TABLE_MAX_WIDTH);
+                }
+            }
+            pColumn->field = x;
+            for (int y = 0; (y < x) && valid; y++) {
+                valid = (strcmp(pOutput->pColumns[y].name, pColumn->name) != 0);
+            }
+        }
+        if (!valid) {
+            printf("Column %d of table %s, \"%s\", must be a unique name:type, type being i8, u8, i16, u16, i32, u32, i64, u64,"
+                   " f32, f64 or charN, where N, from 2 to %d, includes the terminator.\n",
+                   x + 1, pOutput->pName, pName, TABLE_MAX_WIDTH);
+        }
+    }
+    pOutput->columnCount = count;
+    for (int x = 1; (x < count) && valid; x++) {
+        column = pOutput->pColumns[x];
+        for (y = x; (y > 0) && (columnTypes[pOutput->pColumns[y - 1].type].size < columnTypes[column.type].size); y--) {
+            pOutput->pColumns[y] = pOutput->pColumns[y - 1];
+        }
+        pOutput->pColumns[y] = column;
+    }
+
+    return valid;
+}
+
+// Write the struct of a row of a table and start the array of rows
+static void tableBegin(Output *pOutput)
+{
+    const Column *pColumn;
+    int alignment = columnTypes[pOutput->pColumns[0].type].size;
+    int size = 0;
+
+    fprintf(pOutput->pFile, "#include <stddef.h>\n#include <stdint.h>\n\n");
+    fprintf(pOutput->pFile, "/* A row of %s */\ntypedef struct {\n", pOutput->pName);
+    for (int x = 0; x < pOutput->columnCount; x++) {
+        pColumn = &(pOutput->pColumns[x]);
+        fprintf(pOutput->pFile, ELEMENT_INDENT "%s %s", columnTypes[pColumn->type].pCType, pColumn->name);
+        if (pColumn->type == COLUMN_CHAR) {
+            fprintf(pOutput->pFile, "[%d]", pColumn->width);
+        }
+        fprintf(pOutput->pFile, ";\n");
+        size += columnTypes[pColumn->type].size * pColumn->width;
+    }
+    fprintf(pOutput->pFile, "} %s_row;\n", pOutput->pName);
+    // Fails to compile if the compiler has put padding between the members
+    fprintf(pOutput->pFile, "typedef char %s_packed[(sizeof(%s_row) == %d) ? 1 : -1];\n\n", pOutput->pName,
+            pOutput->pName, (size + alignment - 1) / alignment * alignment);
+    fprintf(pOutput->pFile, "const %s_row %s[] = {\n", pOutput->pName, pOutput->pName);
+}
+
+// Write an error into a table, so that it fails to compile, as well as
+// saying so; pColumn is NULL if the problem is with the whole row
+static void tableError(Output *pOutput, const char *pColumn, const char *pValue, const char *pProblem)
+{
+    if (pOutput->pOut - pOutput->pLine > 0) {
+        writeLine(pOutput);
+    }
+    if (pOutput->lineOpen) {
+        lineEnd(pOutput);
+    }
+    printf("Table %s, row %ld%s%s: \"%s\" %s.\n", pOutput->pName, pOutput->recordCount,
+           (pColumn != NULL) ? ", column " : "", (pColumn != NULL) ? pColumn : "", pValue, pProblem);
+    fprintf(pOutput->pFile, "# error row %ld%s%s of this table %s\n", pOutput->recordCount,
+            (pColumn != NULL) ? ", column " : "", (pColumn != NULL) ? pColumn : "", pProblem);
+    pOutput->failed = true;
+}
+
+// Write a field of a row of a table as an element of its initialiser,
+// returning false if it is not valid for its column
+static bool tableField(Output *pOutput, const Column *pColumn, char *pField, bool first, bool last)
+{
+    char element[ELEMENT_MAX_LENGTH];
+    // Strings are kept as they are, untrimmed
+    char *pValue = (pColumn->type == COLUMN_CHAR) ? pField : tableTrim(pField);
+    const char *pStart = first ? "{" : "";
+    const char *pEnd = last ? "}," : ",";
+    char *pAfter = pValue;
+    unsigned long long value;
+    double real;
+    int length;
+    int base = 10;
+    bool negative = (*pValue == '-');
+    bool valid = (*pValue != 0);
+    bool range = false;
+
+    switch (pColumn->type) {
+        case COLUMN_F32:
+        case COLUMN_F64:
+            errno = 0;
+            real = strtod(pValue, &pAfter);
+            valid = valid && (*pAfter == 0) && (real - real == 0); // i.e. finite
+            // Out of range if it overflows or underflows to 0, for an f32
+            // below the smallest denormal
+            range = (errno == ERANGE) ||
+                    ((pColumn->type == COLUMN_F32) && ((fabs(real) > FLT_MAX) ||
+                                                       ((real != 0) && (fabs(real) < FLT_MIN * FLT_EPSILON))));
+            valid = valid && !range;
+            if (valid) {
+                length = sprintf(element, "%s%.*g", pStart, (pColumn->type == COLUMN_F32) ? 9 : 17, real);
+                if (strpbrk(element, ".e") == NULL) {
+                    length += sprintf(element + length, ".0");
+                }
+                writeElement(pOutput, element, length + sprintf(element + length, "%s%s",
+                                                                (pColumn->type == COLUMN_F32) ? "f" : "", pEnd));
+            }
+            break;
+        case COLUMN_CHAR:
+            // In string literals short enough to be elements
+            valid = ((int) strlen(pValue) < pColumn->width);
+            for (const char *pIn = pValue; valid && ((*pIn != 0) || (pIn == pValue)); ) {
+                length = sprintf(element, "%s\"", (pIn == pValue) ? pStart : "");
+                for (int x = 0; (x < TABLE_STRING_PIECE) && (*pIn != 0); x++, pIn++) {
+                    if (escapeRequired(*pIn)) {
+                        element[length] = '\\';
+                        length++;
+                        element[length] = escapedChar(*pIn);
+                    } else {
+                        element[length] = *pIn;
+                    }
+                    length++;
+                }
+                writeElement(pOutput, element, length + sprintf(element + length, "\"%s", (*pIn == 0) ? pEnd : ""));
+                if (*pIn == 0) {
+                    break;
+                }
+            }
+            break;
+        default:
+            // Decimal or, with 0x, hexadecimal
+            if (negative || (*pValue == '+')) {
+                pAfter++;
+            }
+            if ((*pAfter == '0') && ((*(pAfter + 1) == 'x') || (*(pAfter + 1) == 'X'))) {
+                base = 16;
+                pAfter += 2;
+            }
+            valid = valid && isxdigit((unsigned char) *pAfter);
+            if (valid) {
+                errno = 0;
+                value = strtoull(pAfter, &pAfter, base);
+                valid = (*pAfter == 0) && (errno == 0) &&
+                        (value <= (negative ? (unsigned long long) -(columnTypes[pColumn->type].min + 1) + 1 :
+                                              columnTypes[pColumn->type].max));
+            }
+            if (valid) {
+                if (negative && (value == (unsigned long long) LLONG_MAX + 1)) {
+                    length = sprintf(element, "%s(-INT64_C(%lld) - 1)", pStart, LLONG_MAX);
+                } else if (columnTypes[pColumn->type].size == 8) {
+                    length = sprintf(element, "%s%sINT64_C(%s%llu)", pStart, (pColumn->type == COLUMN_U64) ? "U" : "",
+                                     negative ? "-" : "", value);
+                } else {
+                    length = sprintf(element, "%s%s%llu", pStart, negative ? "-" : "", value);
+                }
+                writeElement(pOutput, element, length + sprintf(element + length, "%s", pEnd));
+            }
+            break;
+    }
+    if (!valid) {
+        if (pColumn->type == COLUMN_CHAR) {
+            sprintf(element, "is too long for char%d", pColumn->width);
+        } else if (range) {
+            sprintf(element, "is out of range for %s", columnTypes[pColumn->type].pName);
+        } else {
+            sprintf(element, "is not a valid %s", columnTypes[pColumn->type].pName);
+        }
+        tableError(pOutput, pColumn->name, pField, element);
+    }
+
+    return valid;
+}
+
+// Set up a table from its header row, which gives the columns unless
+// they were given with -k, and start it
+static void tableHeader(Output *pOutput, char *pHeader)
+{
+    char *pSchema = pHeader;
+
+    // Tab-separated if the header row has a tab in it
+    pOutput->delimiter = (strchr(pHeader, '\t') != NULL) ? '\t' : ',';
+    if (pOutput->pSchema != NULL) {
+        pSchema = (char *) malloc(strlen(pOutput->pSchema) + 1);
+        if (pSchema != NULL) {
+            strcpy(pSchema, pOutput->pSchema);
+        }
+    }
+    if ((pSchema != NULL) && tableColumns(pOutput, pSchema, (pOutput->pSchema != NULL) ? ',' : pOutput->delimiter)) {
+        tableBegin(pOutput);
+    } else {
+        fprintf(pOutput->pFile, "# error the columns of this table are not valid\n");
+        pOutput->failed = true;
+        free(pOutput->pColumns);
+        pOutput->pColumns = NULL;
+    }
+    if (pSchema != pHeader) {
+        free(pSchema);
+    }
+}
+
+// Return true if a row of a table is blank, holding nothing but white
+// space, the delimiter not counting as white space; a tab is taken as
+// the delimiter until the header row gives it
+static bool tableBlank(const Output *pOutput, const char *pRecord)
+{
+    char delimiter = (pOutput->recordCount == 0) ? '\t' : pOutput->delimiter;
+
+    for (; *pRecord != 0; pRecord++) {
+        if (!isspace((unsigned char) *pRecord) || (*pRecord == delimiter)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Read a row of a table: the first is the header row; each row after
+// it becomes an element of the array of rows, on a line of its own;
+// blank lines are ignored
+static void tableRow(Output *pOutput)
+{
+    char *pFields[TABLE_MAX_COLUMNS + 1];
+    int count;
+    bool valid = true;
+
+    // The row ends at a newline, which may be preceded by a carriage return
+    if ((pOutput->recordFill > 0) && (pOutput->pRecord[pOutput->recordFill - 1] == '\r')) {
+        pOutput->recordFill--;
+    }
+    pOutput->pRecord[pOutput->recordFill] = 0;
+    pOutput->recordFill = 0;
+    if (tableBlank(pOutput, pOutput->pRecord)) {
+        return;
+    }
+    pOutput->recordCount++;
+    if (pOutput->recordCount == 1) {
+        tableHeader(pOutput, pOutput->pRecord);
+    } else if (pOutput->pColumns != NULL) {
+        count = tableSplit(pOutput->pRecord, pOutput->delimiter, pFields, TABLE_MAX_COLUMNS + 1);
+        if (count != pOutput->columnCount) {
+            tableError(pOutput, NULL, pOutput->pRecord, (count > pOutput->columnCount) ? "has too many fields" :
+                                                                                         "has too few fields");
+        } else {
+            if (pOutput->pOut - pOutput->pLine > 0) {
+                writeLine(pOutput);
+            }
+            for (int x = 0; (x < count) && valid; x++) {
+                valid = tableField(pOutput, &(pOutput->pColumns[x]), pFields[pOutput->pColumns[x].field],
+                                   x == 0, x == count - 1);
+            }
+            pOutput->position++;
+        }
+    }
+}
+
+// Read a buffer of CSV or TSV input a row at a time into a table
+static void tableWrite(Output *pOutput, const char *pBuffer, int size)
+{
+    char *pRecord;
+
+    for (int x = 0; x < size; x++) {
+        if ((pBuffer[x] == '\n') && !pOutput->inQuotes) {
+            if (pOutput->pRecord != NULL) {
+                tableRow(pOutput);
+            }
+        } else {
+            if (pOutput->recordFill + 1 >= pOutput->recordAllocated) {
+                // Room for the character and a terminator
+                pRecord = (char *) realloc(pOutput->pRecord, pOutput->recordAllocated + INPUT_BUFFER_SIZE);
+                if (pRecord == NULL) {
+                    printf("Cannot allocate memory for a row of table %s, output will be incomplete.\n", pOutput->pName);
+                    return;
+                }
+                pOutput->pRecord = pRecord;
+                pOutput->recordAllocated += INPUT_BUFFER_SIZE;
+            }
+            if (pBuffer[x] == '"') {
+                pOutput->inQuotes = !pOutput->inQuotes;
+            }
+            pOutput->pRecord[pOutput->recordFill] = pBuffer[x];
+            pOutput->recordFill++;
+        }
+    }
+}
+
+// Finish off a table with its row count and an accessor for each column
+static void tableEnd(Output *pOutput)
+{
+    char header[] = "";
+
+    if (pOutput->recordFill > 0) {
+        // The last row had no newline
+        tableRow(pOutput);
+    }
+    if ((pOutput->recordCount == 0) && (pOutput->pSchema != NULL)) {
+        // No header row, but the columns are known: an empty table
+        tableHeader(pOutput, header);
+    }
+    if (pOutput->pColumns != NULL) {
+        if (pOutput->position == 0) {
+            // C has no empty arrays
+            writeElement(pOutput, "{0},", 4);
+        }
+        elementsEnd(pOutput);
+        fprintf(pOutput->pFile, "const size_t %s_count = %lld;\n\n", pOutput->pName, pOutput->position);
+        // In the order of the columns in the input
+        for (int field = 0; field < pOutput->columnCount; field++) {
+            for (int x = 0; x < pOutput->columnCount; x++) {
+                if (pOutput->pColumns[x].field == field) {
+                    fprintf(pOutput->pFile, "#define %s_%s(row) (%s[(row)].%s)\n", pOutput->pName,
+                            pOutput->pColumns[x].name, pOutput->pName, pOutput->pColumns[x].name);
+                }
+            }
+        }
+    } else if (pOutput->recordCount == 0) {
+        fprintf(pOutput->pFile, "# error there is no header row to give the columns of this table\n");
+        pOutput->failed = true;
+    }
+    free(pOutput->pColumns);
+    pOutput->pColumns = NULL;
+    free(pOutput->pRecord);
+    pOutput->pRecord = NULL;
+}
+
+// Add size bytes to a buffer, returning false if there is no memory for them
+static bool bytesAdd(Bytes *pBytes, const void *pData, long size)
+{
+    unsigned char *pNew;
+    long allocated = pBytes->allocated;
+
+    if (pBytes->size + size > allocated) {
+        while (pBytes->size + size > allocated) {
+            allocated = (allocated > 0) ? allocated * 2 : INPUT_BUFFER_SIZE;
+        }
+        pNew = (unsigned char *) realloc(pBytes->pData, allocated);
+        if (pNew == NULL) {
+            return false;
+        }
+        pBytes->pData = pNew;
+        pBytes->allocated = allocated;
+    }
+    memcpy(pBytes->pData + pBytes->size, pData, size);
+    pBytes->size += size;
+
+    return true;
+}
+
+// Encode the head of a CBOR data item, its major type and a value, in
+// as few bytes as possible, returning the number of bytes
+static int cborHead(unsigned char *pHead, int major, uint64_t value)
+{
+    int size = 0;
+
+    if (value < 24) {
+        pHead[0] = (unsigned char) ((major << 5) | value);
+    } else {
+        size = (value <= 0xff) ? 1 : (value <= 0xffff) ? 2 : (value <= 0xffffffffULL) ? 4 : 8;
+        pHead[0] = (unsigned char) ((major << 5) | ((size == 1) ? 24 : (size == 2) ? 25 : (size == 4) ? 26 : 27));
+        for (int x = size; x > 0; x--) {
+            pHead[x] = (unsigned char) value;
+            value >>= 8;
+        }
+    }
+
+    return size + 1;
+}
+
+// Add the head of a CBOR data item to the CBOR being written, or
+// insert it at offset, returning false if there is no memory for it
+static bool cborAddHead(Json *pJson, int major, uint64_t value, long offset)
+{
+    unsigned char head[9];
+    int size = cborHead(head, major, value);
+    long tail = pJson->cbor.size - offset;
+
+    if (!bytesAdd(&pJson->cbor, head, size)) {
+        return false;
+    }
+    if (tail > 0) {
+        memmove(pJson->cbor.pData + offset + size, pJson->cbor.pData + offset, tail);
+        memcpy(pJson->cbor.pData + offset, head, size);
+    }
+
+    return true;
+}
+
+// Encode a double as a CBOR half-precision float, if it can be one exactly
+static bool cborHalf(double value, uint16_t *pHalf)
+{
+    float single = (float) value;
+    uint32_t bits;
+    uint32_t mantissa;
+    int exponent;
+    int shift;
+
+    if ((double) single != value) {
+        return false;
+    }
+    memcpy(&bits, &single, sizeof(bits));
+    *pHalf = (uint16_t) ((bits >> 16) & 0x8000);
+    exponent = (int) ((bits >> 23) & 0xff) - 127;
+    mantissa = (bits & 0x7fffff) | 0x800000;
+    if ((bits & 0x7fffffff) == 0) {
+        // Zero
+        return true;
+    }
+    if ((exponent >= -14) && (exponent <= 15) && ((mantissa & 0x1fff) == 0)) {
+        *pHalf |= (uint16_t) (((exponent + 15) << 10) | ((mantissa & 0x7fffff) >> 13));
+        return true;
+    }
+    // A subnormal half-precision float, a multiple of 2^-24
+    shift = -exponent - 1;
+    if ((exponent < -14) && (exponent >= -24) && ((mantissa & ((1UL << shift) - 1)) == 0)) {
+        *pHalf |= (uint16_t) (mantissa >> shift);
+        return true;
+    }
+
+    return false;
+}
+
+// Note what is wrong with JSON, and where, if nothing already is; returns false
+static bool jsonFail(Json *pJson, const char *pError)
+{
+    if (pJson->pError == NULL) {
+        pJson->pError = pError;
+        pJson->pErrorAt = pJson->pNext;
+    }
+
+    return false;
+}
+
+// Skip the white space in JSON
+static void jsonSpace(Json *pJson)
+{
+    while ((*pJson->pNext == ' ') || (*pJson->pNext == '\t') || (*pJson->pNext == '\n') || (*pJson->pNext == '\r')) {
+        pJson->pNext++;
+    }
+}
+
+// Read four hex digits of a JSON \u escape, returning -1 if they aren't
+static long jsonHex(Json *pJson)
+{
+    long value = 0;
+
+    for (int x = 0; x < 4; x++) {
+        if (!isxdigit((unsigned char) *pJson->pNext)) {
+            return -1;
+        }
+        value = (value << 4) | (isdigit((unsigned char) *pJson->pNext) ? *pJson->pNext - '0' :
+                                                                          (tolower((unsigned char) *pJson->pNext) - 'a' + 10));
+        pJson->pNext++;
+    }
+
+    return value;
+}
+
+// Read a JSON string, the opening quote being at pNext, into pJson->string
+// as UTF-8, which must be valid, returning false if it is not a string
+static bool jsonReadString(Json *pJson)
+{
+    unsigned char utf8[4];
+    const unsigned char *pIn;
+    long code;
+    long low;
+    int length;
+
+    pJson->string.size = 0;
+    pJson->pNext++;
+    while (*pJson->pNext != '"') {
+        pIn = (const unsigned char *) pJson->pNext;
+        length = 1;
+        if (*pIn < 0x20) {
+            return jsonFail(pJson, (*pIn == 0) ? "string is not terminated" : "control character in a string");
+        } else if (*pIn == '\\') {
+            pJson->pNext++;
+            code = *pJson->pNext;
+            pJson->pNext++;
+            switch (code) {
+                case '"':
+                case '\\':
+                case '/':
+                    break;
+                case 'b':
+                    code = '\b';
+                    break;
+                case 'f':
+                    code = '\f';
+                    break;
+                case 'n':
+                    code = '\n';
+                    break;
+                case 'r':
+                    code = '\r';
+                    break;
+                case 't':
+                    code = '\t';
+                    break;
+                case 'u':
+                    code = jsonHex(pJson);
+                    if ((code >= 0xd800) && (code <= 0xdbff) && (*pJson->pNext == '\\') && (*(pJson->pNext + 1) == 'u')) {
+                        // A surrogate pair
+                        pJson->pNext += 2;
+                        low = jsonHex(pJson);
+                        code = ((low >= 0xdc00) && (low <= 0xdfff)) ? 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00) : -1;
+                    } else if ((code >= 0xd800) && (code <= 0xdfff)) {
+                        code = -1;
+                    }
+                    if (code < 0) {
+                        pJson->pNext--;
+                        return jsonFail(pJson, "not a valid \\u escape");
+                    }
+                    break;
+                default:
+                    pJson->pNext--;
+                    return jsonFail(pJson, "not a valid escape");
+            }
+            // As UTF-8
+            if (code < 0x80) {
+                utf8[0] = (unsigned char) code;
+            } else if (code < 0x800) {
+                utf8[0] = (unsigned char) (0xc0 | (code >> 6));
+                length = 2;
+            } else if (code < 0x10000) {
+                utf8[0] = (unsigned char) (0xe0 | (code >> 12));
+                length = 3;
+            } else {
+                utf8[0] = (unsigned char) (0xf0 | (code >> 18));
+                length = 4;
+            }
+            for (int x = 1; x < length; x++) {
+                utf8[x] = (unsigned char) (0x80 | ((code >> ((length - 1 - x) * 6)) & 0x3f));
+            }
+            pIn = utf8;
+        } else {
+            if (*pIn >= 0x80) {
+                // Check that this is UTF-8, with no overlong forms or surrogates
+                length = (*pIn >= 0xf0) ? 4 : (*pIn >= 0xe0) ? 3 : 2;
+                code = *pIn & (0x3f >> (length - 1));
+                for (int x = 1; x < length; x++) {
+                    if ((pIn[x] & 0xc0) != 0x80) {
+                        return jsonFail(pJson, "not valid UTF-8");
+                    }
+                    code = (code << 6) | (pIn[x] & 0x3f);
+                }
+                if ((*pIn < 0xc2) || (*pIn > 0xf4) || (code < ((length == 2) ? 0x80 : (length == 3) ? 0x800 : 0x10000)) ||
+                    (code > 0x10ffff) || ((code >= 0xd800) && (code <= 0xdfff))) {
+                    return jsonFail(pJson, "not valid UTF-8");
+                }
+            }
+            pJson->pNext += length;
+        }
+        if (!bytesAdd(&pJson->string, pIn, length)) {
+            return jsonFail(pJson, "out of memory");
+        }
+    }
+    pJson->pNext++;
+
+    return true;
+}
+
+// Find a key in the sorted keys of some JSON, returning its index or,
+// if it is not there, -1 - the index at which it would go
+static int jsonFindKey(const Json *pJson, const Bytes *pKey)
+{
+    int first = 0;
+    int last = pJson->keyCount - 1;
+    int middle;
+    int compare;
+
+    while (first <= last) {
+        middle = (first + last) / 2;
+        compare = memcmp(pJson->pKeys[middle].pData, pKey->pData,
+                         (pJson->pKeys[middle].size < pKey->size) ? pJson->pKeys[middle].size : pKey->size);
+        if (compare == 0) {
+            compare = (pJson->pKeys[middle].size > pKey->size) - (pJson->pKeys[middle].size < pKey->size);
+        }
+        if (compare == 0) {
+            return middle;
+        } else if (compare < 0) {
+            first = middle + 1;
+        } else {
+            last = middle - 1;
+        }
+    }
+
+    return -1 - first;
+}
+
+// Write the key of a member of a JSON object, just read into
+// pJson->string, as CBOR: as a text string or as its index
+// into the keys, noting it in the keys if they are being collected
+static bool jsonWriteKey(Json *pJson)
+{
+    Bytes *pKeys;
+    Bytes key = {NULL, 0, 0};
+    int index = jsonFindKey(pJson, &pJson->string);
+
+    if (pJson->collect && (index < 0)) {
+        index = -1 - index;
+        if (pJson->keyCount >= pJson->keysAllocated) {
+            pKeys = (Bytes *) realloc(pJson->pKeys, (pJson->keysAllocated + 64) * sizeof(Bytes));
+            if (pKeys == NULL) {
+                return jsonFail(pJson, "out of memory");
+            }
+            pJson->pKeys = pKeys;
+            pJson->keysAllocated += 64;
+        }
+        if ((pJson->string.size > 0) && !bytesAdd(&key, pJson->string.pData, pJson->string.size)) {
+            return jsonFail(pJson, "out of memory");
+        }
+        memmove(&pJson->pKeys[index + 1], &pJson->pKeys[index], (pJson->keyCount - index) * sizeof(Bytes));
+        pJson->pKeys[index] = key;
+        pJson->keyCount++;
+    }
+    if (pJson->intern && !pJson->collect) {
+        return cborAddHead(pJson, 0, index, pJson->cbor.size) || jsonFail(pJson, "out of memory");
+    }
+
+    return (cborAddHead(pJson, 3, pJson->string.size, pJson->cbor.size) &&
+            bytesAdd(&pJson->cbor, pJson->string.pData, pJson->string.size)) || jsonFail(pJson, "out of memory");
+}
+
+// Compare the keys of two members of an object, as encoded in CBOR, for qsort()
+static int cborCompareMembers(const void *pFirst, const void *pSecond)
+{
+    const CborMember *pA = (const CborMember *) pFirst;
+    const CborMember *pB = (const CborMember *) pSecond;
+    int compare = memcmp(pA->pKey, pB->pKey, (pA->keyLength < pB->keyLength) ? pA->keyLength : pB->keyLength);
+
+    if (compare == 0) {
+        compare = (pA->keyLength > pB->keyLength) - (pA->keyLength < pB->keyLength);
+    }
+
+    return compare;
+}
+
+// Sort the members of an object written as CBOR from start by their
+// keys, as deterministic CBOR requires, which must be different
+static bool cborSortMembers(Json *pJson, Bytes *pMembers, long start)
+{
+    CborMember *pMember = (CborMember *) pMembers->pData;
+    long count = pMembers->size / (long) sizeof(CborMember);
+    unsigned char *pCopy;
+    long size = pJson->cbor.size - start;
+    bool sorted = true;
+
+    for (long x = 0; x < count; x++) {
+        pMember[x].pKey = pJson->cbor.pData + pMember[x].start;
+        sorted = sorted && ((x == 0) || (cborCompareMembers(&pMember[x - 1], &pMember[x]) < 0));
+    }
+    if (sorted) {
+        return true;
+    }
+    qsort(pMember, count, sizeof(CborMember), cborCompareMembers);
+    for (long x = 1; x < count; x++) {
+        if (cborCompareMembers(&pMember[x - 1], &pMember[x]) == 0) {
+            return jsonFail(pJson, "duplicate key in an object");
+        }
+    }
+    pCopy = (unsigned char *) malloc(size);
+    if (pCopy == NULL) {
+        return jsonFail(pJson, "out of memory");
+    }
+    for (long x = 0, offset = 0; x < count; x++) {
+        memcpy(pCopy + offset, pMember[x].pKey, pMember[x].end - pMember[x].start);
+        offset += pMember[x].end - pMember[x].start;
+    }
+    memcpy(pJson->cbor.pData + start, pCopy, size);
+    free(pCopy);
+
+    return true;
+}
+
+static bool jsonReadValue(Json *pJson);
+
+// Read a JSON array or object, the bracket or brace being at pNext,
+// writing it as a CBOR array or map once its length is known
+static bool jsonReadContainer(Json *pJson)
+{
+    char close = (*pJson->pNext == '[') ? ']' : '}';
+    long start = pJson->cbor.size;
+    long count = 0;
+    Bytes members = {NULL, 0, 0};
+    CborMember member;
+    bool valid = true;
+
+    pJson->depth++;
+    if (pJson->depth > JSON_MAX_DEPTH) {
+        return jsonFail(pJson, "nested too deeply");
+    }
+    pJson->pNext++;
+    jsonSpace(pJson);
+    if (*pJson->pNext != close) {
+        do {
+            jsonSpace(pJson);
+            if (close == '}') {
+                // A member: a key, a colon and a value
+                member.start = pJson->cbor.size;
+                valid = ((*pJson->pNext == '"') || jsonFail(pJson, "expected a key")) && jsonReadString(pJson) &&
+                        jsonWriteKey(pJson);
+                if (valid) {
+                    member.keyLength = pJson->cbor.size - member.start;
+                    jsonSpace(pJson);
+                    valid = ((*pJson->pNext == ':') || jsonFail(pJson, "expected a colon"));
+                    pJson->pNext++;
+                }
+                valid = valid && jsonReadValue(pJson);
+                member.end = pJson->cbor.size;
+                valid = valid && (bytesAdd(&members, &member, sizeof(member)) || jsonFail(pJson, "out of memory"));
+            } else {
+                valid = jsonReadValue(pJson);
+            }
+            count++;
+            jsonSpace(pJson);
+        } while (valid && (*pJson->pNext == ',') && pJson->pNext++);
+        valid = valid && ((*pJson->pNext == close) ||
+                          jsonFail(pJson, (close == '}') ? "expected a comma or a closing brace" :
+                                                           "expected a comma or a closing bracket"));
+    }
+    pJson->pNext++;
+    if (valid && (close == '}')) {
+        valid = cborSortMembers(pJson, &members, start);
+    }
+    free(members.pData);
+    pJson->depth--;
+
+    return valid && (cborAddHead(pJson, (close == '}') ? 5 : 4, count, start) || jsonFail(pJson, "out of memory"));
+}
+
+// Read a JSON number, writing it as a CBOR integer if it is one which
+// fits, else as the shortest CBOR float which holds it exactly
+static bool jsonReadNumber(Json *pJson)
+{
+    const char *pNumber = pJson->pNext;
+    const char *pDigits;
+    bool integer = true;
+    bool negative = (*pJson->pNext == '-');
+    unsigned char head[9];
+    uint64_t magnitude;
+    double value;
+    float single;
+    uint32_t bits;
+    uint64_t bits64;
+    uint16_t half;
+
+    if (negative) {
+        pJson->pNext++;
+    }
+    pDigits = pJson->pNext;
+    if (!isdigit((unsigned char) *pJson->pNext)) {
+        return jsonFail(pJson, "expected a value");
+    }
+    if (*pJson->pNext == '0') {
+        // No leading zeros
+        pJson->pNext++;
+    } else {
+        while (isdigit((unsigned char) *pJson->pNext)) {
+            pJson->pNext++;
+        }
+    }
+    if (*pJson->pNext == '.') {
+        integer = false;
+        pJson->pNext++;
+        if (!isdigit((unsigned char) *pJson->pNext)) {
+            return jsonFail(pJson, "expected a digit");
+        }
+        while (isdigit((unsigned char) *pJson->pNext)) {
+            pJson->pNext++;
+        }
+    }
+    if ((*pJson->pNext == 'e') || (*pJson->pNext == 'E')) {
+        integer = false;
+        pJson->pNext++;
+        if ((*pJson->pNext == '+') || (*pJson->pNext == '-')) {
+            pJson->pNext++;
+        }
+        if (!isdigit((unsigned char) *pJson->pNext)) {
+            return jsonFail(pJson, "expected a digit");
+        }
+        while (isdigit((unsigned char) *pJson->pNext)) {
+            pJson->pNext++;
+        }
+    }
+    if (integer) {
+        errno = 0;
+        magnitude = strtoull(pDigits, NULL, 10);
+        if (errno == 0) {
+            if (negative && (magnitude > 0)) {
+                // A CBOR negative integer is -1 - its value
+                return cborAddHead(pJson, 1, magnitude - 1, pJson->cbor.size) || jsonFail(pJson, "out of memory");
+            }
+            return cborAddHead(pJson, 0, magnitude, pJson->cbor.size) || jsonFail(pJson, "out of memory");
+        }
+        if (negative && (pJson->pNext - pDigits == 20) && (strncmp(pDigits, "18446744073709551616", 20) == 0)) {
+            // -2^64, the most negative CBOR integer
+            return cborAddHead(pJson, 1, ~(uint64_t) 0, pJson->cbor.size) || jsonFail(pJson, "out of memory");
+        }
+    }
+    value = strtod(pNumber, NULL);
+    if (value - value != 0) {
+        // Infinite
+        pJson->pNext = pNumber;
+        return jsonFail(pJson, "number out of range");
+    }
+    single = (float) value;
+    if (cborHalf(value, &half)) {
+        head[0] = 0xf9;
+        bits64 = half;
+        bits = 2;
+    } else if ((double) single == value) {
+        head[0] = 0xfa;
+        memcpy(&bits, &single, sizeof(bits));
+        bits64 = bits;
+        bits = 4;
+    } else {
+        head[0] = 0xfb;
+        memcpy(&bits64, &value, sizeof(bits64));
+        bits = 8;
+    }
+    for (int x = (int) bits; x > 0; x--) {
+        head[x] = (unsigned char) bits64;
+        bits64 >>= 8;
+    }
+
+    return bytesAdd(&pJson->cbor, head, bits + 1) || jsonFail(pJson, "out of memory");
+}
+
+// Read a JSON value, after any white space, and write it as CBOR
+static bool jsonReadValue(Json *pJson)
+{
+    static const struct {
+        const char *pName;
+        unsigned char cbor;
+    } literals[] = {{"false", 0xf4}, {"true", 0xf5}, {"null", 0xf6}};
+
+    jsonSpace(pJson);
+    switch (*pJson->pNext) {
+        case '{':
+        case '[':
+            return jsonReadContainer(pJson);
+        case '"':
+            return jsonReadString(pJson) &&
+                   ((cborAddHead(pJson, 3, pJson->string.size, pJson->cbor.size) &&
+                     bytesAdd(&pJson->cbor, pJson->string.pData, pJson->string.size)) || jsonFail(pJson, "out of memory"));
+        case 'f':
+        case 't':
+        case 'n':
+            for (size_t x = 0; x < sizeof(literals) / sizeof(literals[0]); x++) {
+                if (strncmp(pJson->pNext, literals[x].pName, strlen(literals[x].pName)) == 0) {
+                    pJson->pNext += strlen(literals[x].pName);
+                    return bytesAdd(&pJson->cbor, &literals[x].cbor, 1) || jsonFail(pJson, "out of memory");
+                }
+            }
+            return jsonFail(pJson, "expected a value");
+        default:
+            return jsonReadNumber(pJson);
+    }
+}
+
+// Convert the JSON at pStart, which is followed by a terminator, to CBOR,
+// returning false if it is not valid JSON
+static bool jsonToCbor(Json *pJson, const char *pStart)
+{
+    pJson->pStart = pStart;
+    pJson->pNext = pStart;
+    pJson->depth = 0;
+    pJson->cbor.size = 0;
+    if (jsonReadValue(pJson)) {
+        jsonSpace(pJson);
+        if (*pJson->pNext != 0) {
+            jsonFail(pJson, "expected the end of the input");
+        }
+    }
+
+    return (pJson->pError == NULL);
+}
+
+// Code to read CBOR on the target, emitted with the CBOR formats
+static const char cborReader[] =
+    "\n#ifndef ARRAYIFY_CBOR\n"
+    "#define ARRAYIFY_CBOR\n"
+    "#include <stddef.h>\n"
+    "#include <stdint.h>\n"
+    "#include <string.h>\n"
+    "/* The types of CBOR data item returned by arrayifyCborNext() */\n"
+    "typedef enum {\n"
+    "    ARRAYIFY_CBOR_END,    /* there are no more data items */\n"
+    "    ARRAYIFY_CBOR_UINT,   /* value is the integer */\n"
+    "    ARRAYIFY_CBOR_NEGINT, /* the integer is -1 - value */\n"
+    "    ARRAYIFY_CBOR_BYTES,  /* value bytes at pData */\n"
+    "    ARRAYIFY_CBOR_TEXT,   /* value bytes of UTF-8 at pData, not terminated */\n"
+    "    ARRAYIFY_CBOR_ARRAY,  /* followed by value data items */\n"
+    "    ARRAYIFY_CBOR_MAP,    /* followed by value pairs of data items, key then value */\n"
+    "    ARRAYIFY_CBOR_FALSE,\n"
+    "    ARRAYIFY_CBOR_TRUE,\n"
+    "    ARRAYIFY_CBOR_NULL,\n"
+    "    ARRAYIFY_CBOR_FLOAT,  /* number is the value */\n"
+    "    ARRAYIFY_CBOR_ERROR   /* the CBOR is not valid or not supported */\n"
+    "} ArrayifyCborType;\n"
+    "\n"
+    "/* A data item read by arrayifyCborNext() */\n"
+    "typedef struct {\n"
+    "    ArrayifyCborType type;\n"
+    "    uint64_t value;\n"
+    "    const unsigned char *pData;\n"
+    "    double number;\n"
+    "} ArrayifyCborItem;\n"
+    "\n"
+    "/* Where reading some CBOR has got to */\n"
+    "typedef struct {\n"
+    "    const unsigned char *pNext;\n"
+    "    const unsigned char *pEnd;\n"
+    "} ArrayifyCbor;\n"
+    "\n"
+    "/* Start reading size bytes of CBOR at pData */\n"
+    "static ARRAYIFY_UNUSED void arrayifyCborStart(ArrayifyCbor *pCbor, const void *pData, size_t size)\n"
+    "{\n"
+    "    pCbor->pNext = (const unsigned char *) pData;\n"
+    "    pCbor->pEnd = pCbor->pNext + size;\n"
+    "}\n"
+    "\n"
+    "/* Read the next data item in place, nothing being copied, returning its type;\n"
+    "   the contents of arrays and maps are the data items which follow them */\n"
+    "static ARRAYIFY_UNUSED ArrayifyCborType arrayifyCborNext(ArrayifyCbor *pCbor, ArrayifyCborItem *pItem)\n"
+    "{\n"
+    "    unsigned int initial;\n"
+    "    unsigned int info;\n"
+    "    uint32_t single;\n"
+    "    float number;\n"
+    "    int size;\n"
+    "    int x;\n"
+    "\n"
+    "    pItem->type = ARRAYIFY_CBOR_END;\n"
+    "    pItem->value = 0;\n"
+    "    pItem->pData = NULL;\n"
+    "    pItem->number = 0;\n"
+    "    if (pCbor->pNext >= pCbor->pEnd) {\n"
+    "        return pItem->type;\n"
+    "    }\n"
+    "    initial = *pCbor->pNext++;\n"
+    "    info = initial & 0x1f;\n"
+    "    size = (info < 24) ? 0 : (info < 28) ? (1 << (info - 24)) : -1;\n"
+    "    pItem->type = ARRAYIFY_CBOR_ERROR;\n"
+    "    if ((size < 0) || (pCbor->pEnd - pCbor->pNext < size)) {\n"
+    "        return pItem->type;\n"
+    "    }\n"
+    "    pItem->value = (info < 24) ? info : 0;\n"
+    "    for (x = 0; x < size; x++) {\n"
+    "        pItem->value = (pItem->value << 8) | *pCbor->pNext++;\n"
+    "    }\n"
+    "    switch (initial >> 5) {\n"
+    "        case 0:\n"
+    "        case 1:\n"
+    "        case 4:\n"
+    "        case 5:\n"
+    "            pItem->type = (ArrayifyCborType) ((initial >> 5 < 4) ? ARRAYIFY_CBOR_UINT + (initial >> 5) :\n"
+    "                                                                   ARRAYIFY_CBOR_ARRAY + (initial >> 5) - 4);\n"
+    "            break;\n"
+    "        case 2:\n"
+    "        case 3:\n"
+    "            if (pItem->value <= (uint64_t) (pCbor->pEnd - pCbor->pNext)) {\n"
+    "                pItem->type = (ArrayifyCborType) (ARRAYIFY_CBOR_BYTES + (initial >> 5) - 2);\n"
+    "                pItem->pData = pCbor->pNext;\n"
+    "                pCbor->pNext += pItem->value;\n"
+    "            }\n"
+    "            break;\n"
+    "        case 7:\n"
+    "            if ((info >= 20) && (info <= 22)) {\n"
+    "                pItem->type = (ArrayifyCborType) (ARRAYIFY_CBOR_FALSE + info - 20);\n"
+    "            } else if (size >= 2) {\n"
+    "                pItem->type = ARRAYIFY_CBOR_FLOAT;\n"
+    "                if (size == 2) {\n"
+    "                    /* Half-precision, to single */\n"
+    "                    x = (int) ((pItem->value >> 10) & 0x1f);\n"
+    "                    single = (uint32_t) (pItem->value & 0x3ff);\n"
+    "                    if (x == 0) {\n"
+    "                        number = (float) single / 16777216.0f;\n"
+    "                        pItem->number = (pItem->value & 0x8000) ? -number : number;\n"
+    "                        break;\n"
+    "                    }\n"
+    "                    single = (single << 13) | ((uint32_t) ((x == 31) ? 255 : x + 112) << 23);\n"
+    "                    pItem->value = ((pItem->value & 0x8000) << 16) | single;\n"
+    "                    size = 4;\n"
+    "                }\n"
+    "                if (size == 4) {\n"
+    "                    single = (uint32_t) pItem->value;\n"
+    "                    memcpy(&number, &single, sizeof(number));\n"
+    "                    pItem->number = number;\n"
+    "                } else {\n"
+    "                    memcpy(&pItem->number, &pItem->value, sizeof(pItem->number));\n"
+    "                }\n"
+    "            }\n"
+    "            break;\n"
+    "        default:\n"
+    "            break;\n"
+    "    }\n"
+    "\n"
+    "    return pItem->type;\n"
+    "}\n"
+    "\n"
+    "/* Skip the next data item, with all of its contents if it is an array or a map,\n"
+    "   returning 0, or -1 if the CBOR is not valid */\n"
+    "static ARRAYIFY_UNUSED int arrayifyCborSkip(ArrayifyCbor *pCbor)\n"
+    "{\n"
+    "    ArrayifyCborItem item;\n"
+    "    uint64_t count = 1;\n"
+    "\n"
+    "    for (; count > 0; count--) {\n"
+    "        switch (arrayifyCborNext(pCbor, &item)) {\n"
+    "            case ARRAYIFY_CBOR_ARRAY:\n"
+    "                count += item.value;\n"
+    "                break;\n"
+    "            case ARRAYIFY_CBOR_MAP:\n"
+    "                count += item.value * 2;\n"
+    "                break;\n"
+    "            case ARRAYIFY_CBOR_END:\n"
+    "            case ARRAYIFY_CBOR_ERROR:\n"
+    "                return -1;\n"
+    "            default:\n"
+    "                break;\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    return 0;\n"
+    "}\n"
+    "#endif\n";
+
+// Hold the whole input, for the formats which need all of it before
+// they can write anything, e.g. the CBOR and web formats
+static void holdWrite(Output *pOutput, const char *pBuffer, int size)
+{
+    char *pRecord;
+    int allocated = pOutput->recordAllocated * 2;
+
+    if (pOutput->recordFill + size + 1 > pOutput->recordAllocated) {
+        // Room for a terminator
+        if (allocated < pOutput->recordFill + size + 1) {
+            allocated = pOutput->recordFill + size + 1 + INPUT_BUFFER_SIZE;
+        }
+        pRecord = (char *) realloc(pOutput->pRecord, allocated);
+        if (pRecord == NULL) {
+            printf("Cannot allocate memory to hold the input of %s, output will be incomplete.\n", pOutput->pName);
+            return;
+        }
+        pOutput->pRecord = pRecord;
+        pOutput->recordAllocated = allocated;
+    }
+    memcpy(pOutput->pRecord + pOutput->recordFill, pBuffer, size);
+    pOutput->recordFill += size;
+}
+
+// Convert the JSON input to CBOR and write it as an array of bytes, with
+// its length and the code to read it; if intern is true the keys of
+// objects are written as their index into an array of the keys, each
+// with a macro for its index where the key is a C identifier
+static void cborConvert(Output *pOutput, bool intern)
+{
+    Json json;
+    const char *pEmpty = "";
+    int line = 1;
+    int column = 1;
+    bool valid;
+    bool identifier;
+
+    memset(&json, 0, sizeof(json));
+    json.intern = intern;
+    if (pOutput->pRecord != NULL) {
+        pOutput->pRecord[pOutput->recordFill] = 0;
+    }
+    if ((pOutput->pRecord != NULL) && (strlen(pOutput->pRecord) != (size_t) pOutput->recordFill)) {
+        // A null character, which JSON cannot contain anyway
+        json.pNext = pOutput->pRecord + strlen(pOutput->pRecord);
+        valid = jsonFail(&json, "null character");
+    } else {
+        // The keys are collected first, so that their indexes are in their sorted order
+        json.collect = intern;
+        valid = jsonToCbor(&json, (pOutput->pRecord != NULL) ? pOutput->pRecord : pEmpty);
+        if (valid && intern) {
+            json.collect = false;
+            valid = jsonToCbor(&json, pOutput->pRecord);
+        }
+    }
+
+    fprintf(pOutput->pFile, "#include <stddef.h>\n\n");
+    if (valid) {
+        fprintf(pOutput->pFile, "/* %s as deterministically encoded CBOR (RFC 8949), from %d bytes of JSON */\n",
+                pOutput->pName, pOutput->recordFill);
+        fprintf(pOutput->pFile, "const unsigned char %s[] = {\n", pOutput->pName);
+        for (long x = 0; x < json.cbor.size; x++) {
+            writeByte(pOutput, json.cbor.pData[x]);
+        }
+    } else {
+        for (const char *pTmp = json.pStart; (pTmp != NULL) && (pTmp < json.pErrorAt); pTmp++) {
+            column++;
+            if (*pTmp == '\n') {
+                line++;
+                column = 1;
+            }
+        }
+        printf("JSON %s, line %d, column %d: %s.\n", pOutput->pName, line, column, json.pError);
+        fprintf(pOutput->pFile, "# error line %d, column %d, of the JSON for this is not valid: %s\n",
+                line, column, json.pError);
+        pOutput->failed = true;
+        fprintf(pOutput->pFile, "const unsigned char %s[] = {\n", pOutput->pName);
+        // C has no empty arrays
+        writeByte(pOutput, 0);
+    }
+    elementsEnd(pOutput);
+    fprintf(pOutput->pFile, "const size_t %s_len = %ld;\n", pOutput->pName, valid ? json.cbor.size : 0);
+    if (intern) {
+        fprintf(pOutput->pFile, "\n/* The keys of the maps in %s, each written as its index in this */\n", pOutput->pName);
+        fprintf(pOutput->pFile, "const char * const %s_keys[] = {\n", pOutput->pName);
+        for (int x = 0; x < json.keyCount; x++) {
+            fprintf(pOutput->pFile, ELEMENT_INDENT "\"");
+            writeQuoted(pOutput->pFile, (const char *) json.pKeys[x].pData, json.pKeys[x].size);
+            fprintf(pOutput->pFile, "\",\n");
+        }
+        if (json.keyCount == 0) {
+            fprintf(pOutput->pFile, ELEMENT_INDENT "NULL\n");
+        }
+        fprintf(pOutput->pFile, "};\n");
+        fprintf(pOutput->pFile, "const size_t %s_key_count = %d;\n", pOutput->pName, json.keyCount);
+        for (int x = 0; x < json.keyCount; x++) {
+            identifier = (json.pKeys[x].size > 0) && !isdigit(json.pKeys[x].pData[0]);
+            for (long y = 0; (y < json.pKeys[x].size) && identifier; y++) {
+                identifier = isalnum(json.pKeys[x].pData[y]) || (json.pKeys[x].pData[y] == '_');
+            }
+            if (identifier) {
+                fprintf(pOutput->pFile, "#define %s_key_%.*s %d\n", pOutput->pName, (int) json.pKeys[x].size,
+                        (const char *) json.pKeys[x].pData, x);
+            }
+        }
+    }
+    writeHelper(pOutput->pFile, cborReader);
+
+    for (int x = 0; x < json.keyCount; x++) {
+        free(json.pKeys[x].pData);
+    }
+    free(json.pKeys);
+    free(json.cbor.pData);
+    free(json.string.pData);
+    free(pOutput->pRecord);
+    pOutput->pRecord = NULL;
+}
+
+// Finish off the cbor format
+static void cborEnd(Output *pOutput)
+{
+    cborConvert(pOutput, false);
+}
+
+// Finish off the cbor_keys format
+static void cborKeysEnd(Output *pOutput)
+{
+    cborConvert(pOutput, true);
+}
+
+// A log string of the tokens formats
+typedef struct {
+    char *pString;     // the string, unescaped, in the held input
+    long length;       // its length, as it may contain nulls
+    uint32_t token;
+    const char *pIdentifier; // the identifier given for it, NULL if one is made from it
+    char identifier[TOKEN_IDENTIFIER_LENGTH + 10]; // that identifier, or the one made
+    int order;         // where it is in the input, for those with the same identifier made
+} TokenEntry;
+
+// Undo the C escapes of a log string in place, as the C compiler
+// would, returning its length
+static long tokenUnescape(char *pString)
+{
+    char *pIn = pString;
+    char *pOut = pString;
+    const char *pEscapes = "n\nt\tr\ra\ab\bf\fv\v";
+    const char *pFound;
+    int value;
+    int digits;
+
+    while (*pIn != 0) {
+        if ((*pIn != '\\') || (pIn[1] == 0)) {
+            *pOut++ = *pIn++;
+        } else {
+            pIn++;
+            pFound = strchr(pEscapes, *pIn);
+            if ((pFound != NULL) && (((pFound - pEscapes) & 1) == 0)) {
+                *pOut++ = pFound[1];
+                pIn++;
+            } else if ((*pIn == 'x') && isxdigit((unsigned char) pIn[1])) {
+                value = 0;
+                for (pIn++; isxdigit((unsigned char) *pIn); pIn++) {
+                    value = (value << 4) | (isdigit((unsigned char) *pIn) ? *pIn - '0' : (tolower((unsigned char) *pIn) - 'a' + 10));
+                }
+                *pOut++ = (char) value;
+            } else if ((*pIn >= '0') && (*pIn <= '7')) {
+                value = 0;
+                for (digits = 0; (digits < 3) && (*pIn >= '0') && (*pIn <= '7'); digits++, pIn++) {
+                    value = (value << 3) | (*pIn - '0');
+                }
+                *pOut++ = (char) value;
+            } else {
+                // \\, \', \" and \?
+                *pOut++ = *pIn++;
+            }
+        }
+    }
+    *pOut = 0;
+
+    return pOut - pString;
+}
+
+// Order log strings by token then by string, those with an identifier given
+// first, so that duplicates and collisions are next to each other
+static int tokenCompareEntries(const void *pFirst, const void *pSecond)
+{
+    const TokenEntry *pA = (const TokenEntry *) pFirst;
+    const TokenEntry *pB = (const TokenEntry *) pSecond;
+    int result;
+
+    if (pA->token != pB->token) {
+        return (pA->token < pB->token) ? -1 : 1;
+    }
+    result = memcmp(pA->pString, pB->pString, (pA->length < pB->length) ? pA->length : pB->length);
+    if (result == 0) {
+        result = (pA->length < pB->length) ? -1 : (pA->length > pB->length) ? 1 : 0;
+    }
+    if (result == 0) {
+        result = (pA->pIdentifier == NULL) - (pB->pIdentifier == NULL);
+    }
+
+    return result;
+}
+
+// Order log strings by identifier, for qsort() of pointers to them
+static int tokenCompareIdentifiers(const void *pFirst, const void *pSecond)
+{
+    const TokenEntry *pA = *(const TokenEntry * const *) pFirst;
+    const TokenEntry *pB = *(const TokenEntry * const *) pSecond;
+    int compare = strcmp(pA->identifier, pB->identifier);
+
+    // Of those which are the same, one given comes first, then the rest
+    // in the order of the input
+    if (compare == 0) {
+        compare = (pA->pIdentifier == NULL) - (pB->pIdentifier == NULL);
+    }
+    if (compare == 0) {
+        compare = pA->order - pB->order;
+    }
+
+    return compare;
+}
+
+// Read the log strings of the held input, one on each line, optionally in
+// double quotes and after an identifier and a tab, giving each the CRC-32
+// of its unescaped string as its token, which stays the same for as long
+// as the string does; strings which are the same are only kept once and
+// each is given an identifier, made from the string if none is given.
+// Returns the number kept, with them in *ppEntries sorted by token, to be
+// freed, or -1, having said why, and put why in pReason, of at least
+// TOKEN_REASON_LENGTH characters, for the # error, if an identifier is not
+// valid, two strings would have the same token or the same identifier, or
+// there is not the memory.
+static int tokenParse(Output *pOutput, TokenEntry **ppEntries, char *pReason)
+{
+    TokenEntry *pEntries = NULL;
+    TokenEntry **ppSorted = NULL;
+    int entryCount = 0;
+    int kept = 0;
+    char *pLine;
+    char *pNext;
+    char *pTmp;
+    char *pOut;
+    bool valid = true;
+
+    if (pOutput->pRecord != NULL) {
+        pOutput->pRecord[pOutput->recordFill] = 0;
+        entryCount = 1;
+        for (pTmp = pOutput->pRecord; *pTmp != 0; pTmp++) {
+            entryCount += (*pTmp == '\n');
+        }
+        pEntries = (TokenEntry *) calloc(entryCount, sizeof(TokenEntry));
+        if (pEntries == NULL) {
+            printf("Cannot allocate memory for the log strings of %s.\n", pOutput->pName);
+            strcpy(pReason, "there was not the memory for the log strings for this");
+            valid = false;
+        }
+        entryCount = 0;
+    }
+    for (pLine = pOutput->pRecord; valid && (pLine != NULL) && (*pLine != 0); pLine = pNext) {
+        pNext = pLine + strcspn(pLine, "\n");
+        if (*pNext != 0) {
+            *pNext++ = 0;
+        }
+        pLine[strcspn(pLine, "\r")] = 0;
+        if (*pLine == 0) {
+            continue;
+        }
+        pTmp = strchr(pLine, '\t');
+        if (pTmp != NULL) {
+            *pTmp = 0;
+            pEntries[entryCount].pIdentifier = pLine;
+            pLine = pTmp + 1;
+            valid = !isdigit((unsigned char) *pEntries[entryCount].pIdentifier) &&
+                    (strlen(pEntries[entryCount].pIdentifier) <= TOKEN_IDENTIFIER_LENGTH);
+            for (const char *pCheck = pEntries[entryCount].pIdentifier; valid && (*pCheck != 0); pCheck++) {
+                valid = isalnum((unsigned char) *pCheck) || (*pCheck == '_');
+            }
+            if (!valid || (*pEntries[entryCount].pIdentifier == 0)) {
+                printf("Log string identifier \"%s\" of %s is not a C identifier of up to %d characters.\n",
+                       pEntries[entryCount].pIdentifier, pOutput->pName, TOKEN_IDENTIFIER_LENGTH);
+                sprintf(pReason, "the identifier of log string %d for this is not a C identifier of up to %d characters",
+                        entryCount + 1, TOKEN_IDENTIFIER_LENGTH);
+                valid = false;
+                break;
+            }
+            strcpy(pEntries[entryCount].identifier, pEntries[entryCount].pIdentifier);
+        }
+        if ((pLine[0] == '"') && (strlen(pLine) > 1) && (pLine[strlen(pLine) - 1] == '"')) {
+            pLine[strlen(pLine) - 1] = 0;
+            pLine++;
+        }
+        pEntries[entryCount].pString = pLine;
+        pEntries[entryCount].order = entryCount;
+        pEntries[entryCount].length = tokenUnescape(pLine);
+        pEntries[entryCount].token = crcUpdate(CRC_TYPE_CRC32, 0, pLine, (int) pEntries[entryCount].length);
+        if (pEntries[entryCount].pIdentifier == NULL) {
+            // The letters and digits of the string, in capitals, with anything between them as _
+            pOut = pEntries[entryCount].identifier;
+            for (long x = 0; (x < pEntries[entryCount].length) && (pOut - pEntries[entryCount].identifier < TOKEN_IDENTIFIER_LENGTH); x++) {
+                if (isalnum((unsigned char) pLine[x])) {
+                    if ((pOut == pEntries[entryCount].identifier) && isdigit((unsigned char) pLine[x])) {
+                        *pOut++ = '_';
+                    }
+                    *pOut++ = (char) toupper((unsigned char) pLine[x]);
+                } else if ((pOut > pEntries[entryCount].identifier) && (pOut[-1] != '_')) {
+                    *pOut++ = '_';
+                }
+            }
+            while ((pOut > pEntries[entryCount].identifier) && (pOut[-1] == '_')) {
+                pOut--;
+            }
+            *pOut = 0;
+            if (pOut == pEntries[entryCount].identifier) {
+                sprintf(pEntries[entryCount].identifier, "TOKEN_%08lx", (unsigned long) pEntries[entryCount].token);
+            }
+        }
+        entryCount++;
+    }
+
+    // Keep each string once, and check that no two have the same token
+    if (valid) {
+        qsort(pEntries, entryCount, sizeof(TokenEntry), tokenCompareEntries);
+        for (int x = 0; x < entryCount; x++) {
+            if ((kept > 0) && (pEntries[kept - 1].token == pEntries[x].token)) {
+                if ((pEntries[kept - 1].length == pEntries[x].length) &&
+                    (memcmp(pEntries[kept - 1].pString, pEntries[x].pString, pEntries[x].length) == 0)) {
+                    continue;
+                }
+                printf("Log strings %s and %s of %s have the same token, 0x%08lx: one must be changed.\n",
+                       pEntries[kept - 1].identifier, pEntries[x].identifier, pOutput->pName,
+                       (unsigned long) pEntries[x].token);
+                sprintf(pReason, "log strings %s and %s for this have the same token, 0x%08lx",
+                        pEntries[kept - 1].identifier, pEntries[x].identifier, (unsigned long) pEntries[x].token);
+                valid = false;
+            }
+            pEntries[kept++] = pEntries[x];
+        }
+    }
+
+    // Check that no two have the same identifier: of those which are the
+    // same, all but the first, as sorted, have their token added if it was
+    // made from their string, so that a string added after them doesn't
+    // change the identifiers of those before it
+    if (valid) {
+        ppSorted = (TokenEntry **) malloc((kept + 1) * sizeof(TokenEntry *));
+        valid = (ppSorted != NULL);
+        if (!valid) {
+            printf("Cannot allocate memory for the log strings of %s.\n", pOutput->pName);
+            strcpy(pReason, "there was not the memory for the log strings for this");
+        }
+    }
+    for (int pass = 0; valid && (pass < 2); pass++) {
+        for (int x = 0; x < kept; x++) {
+            ppSorted[x] = &pEntries[x];
+        }
+        qsort(ppSorted, kept, sizeof(TokenEntry *), tokenCompareIdentifiers);
+        for (int x = 1, first = 0; x < kept; x++) {
+            if (strcmp(ppSorted[first]->identifier, ppSorted[x]->identifier) != 0) {
+                first = x;
+            } else if ((pass == 0) && (ppSorted[x]->pIdentifier == NULL)) {
+                sprintf(ppSorted[x]->identifier + strlen(ppSorted[x]->identifier), "_%08lx",
+                        (unsigned long) ppSorted[x]->token);
+            } else {
+                printf("Log strings of %s with the tokens 0x%08lx and 0x%08lx have the same identifier, %s.\n",
+                       pOutput->pName, (unsigned long) ppSorted[first]->token, (unsigned long) ppSorted[x]->token,
+                       ppSorted[x]->identifier);
+                sprintf(pReason, "log strings for this with the tokens 0x%08lx and 0x%08lx have the same identifier, %s",
+                        (unsigned long) ppSorted[first]->token, (unsigned long) ppSorted[x]->token,
+                        ppSorted[x]->identifier);
+                valid = false;
+            }
+        }
+    }
+    free(ppSorted);
+
+    if (!valid) {
+        free(pEntries);
+        pEntries = NULL;
+        kept = -1;
+    }
+    *ppEntries = pEntries;
+
+    return kept;
+}
+
+// Finish off the tokens format: a macro for the token of each log
+// string, for firmware to log in place of the string
+static void tokensEnd(Output *pOutput)
+{
+    TokenEntry *pEntries;
+    char reason[TOKEN_REASON_LENGTH];
+    int count = tokenParse(pOutput, &pEntries, reason);
+
+    if (count < 0) {
+        fprintf(pOutput->pFile, "# error %s\n", reason);
+        pOutput->failed = true;
+    } else {
+        fprintf(pOutput->pFile, "/* The tokens of the %d log strings of %s, the CRC-32 of each string: log the token\n"
+                                "   in place of the string, the string being found from the token by %s_find() */\n",
+                count, pOutput->pName, pOutput->pName);
+        for (int x = 0; x < count; x++) {
+            fprintf(pOutput->pFile, "#define %s_%s 0x%08lxUL", pOutput->pName, pEntries[x].identifier,
+                    (unsigned long) pEntries[x].token);
+            if (strstr(pEntries[x].pString, "*/") == NULL) {
+                fprintf(pOutput->pFile, " /* \"");
+                writeQuoted(pOutput->pFile, pEntries[x].pString, pEntries[x].length);
+                fprintf(pOutput->pFile, "\" */");
+            }
+            fputc('\n', pOutput->pFile);
+        }
+    }
+    free(pEntries);
+    free(pOutput->pRecord);
+    pOutput->pRecord = NULL;
+}
+
+// Code to look up a token in the database of the tokens_db format
+static const char tokensFind[] =
+    "\n#ifndef ARRAYIFY_TOKENS\n"
+    "#define ARRAYIFY_TOKENS\n"
+    "#include <stddef.h>\n"
+    "#include <stdint.h>\n"
+    "/* A log string of a database: its token and where it starts in the strings */\n"
+    "typedef struct {\n"
+    "    uint32_t token;\n"
+    "    uint32_t offset;\n"
+    "} ArrayifyToken;\n"
+    "\n"
+    "/* Find the string of a token in count tokens sorted by token, returning NULL\n"
+    "   if there is none, e.g. if the database is older than the firmware */\n"
+    "static ARRAYIFY_UNUSED const char *arrayifyTokenFind(const ArrayifyToken *pTokens, size_t count,\n"
+    "                                                     const char *pStrings, uint32_t token)\n"
+    "{\n"
+    "    size_t first = 0;\n"
+    "    size_t middle;\n"
+    "\n"
+    "    while (first < count) {\n"
+    "        middle = first + (count - first) / 2;\n"
+    "        if (pTokens[middle].token == token) {\n"
+    "            return pStrings + pTokens[middle].offset;\n"
+    "        } else if (pTokens[middle].token < token) {\n"
+    "            first = middle + 1;\n"
+    "        } else {\n"
+    "            count = middle;\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    return NULL;\n"
+    "}\n"
+    "#endif\n";
+
+// Finish off the tokens_db format: the tokens of the log strings, sorted,
+// each with where its string starts in one array of all of the strings,
+// each ended by a null, for a host-side decoder to turn tokens back into
+// strings
+static void tokensDbEnd(Output *pOutput)
+{
+    TokenEntry *pEntries;
+    char reason[TOKEN_REASON_LENGTH];
+    int count = tokenParse(pOutput, &pEntries, reason);
+    long offset = 0;
+
+    fprintf(pOutput->pFile, "%s%s\n", unusedMarker, tokensFind);
+    if (count < 0) {
+        fprintf(pOutput->pFile, "# error %s\n", reason);
+        pOutput->failed = true;
+        count = 0;
+    }
+    fprintf(pOutput->pFile, "/* The tokens of the %d log strings of %s, sorted, for %s_find() */\n",
+            count, pOutput->pName, pOutput->pName);
+    fprintf(pOutput->pFile, "const ArrayifyToken %s[] = {\n", pOutput->pName);
+    for (int x = 0; x < count; x++) {
+        fprintf(pOutput->pFile, ELEMENT_INDENT "{0x%08lx, %ld},\n", (unsigned long) pEntries[x].token, offset);
+        offset += pEntries[x].length + 1;
+    }
+    if (count == 0) {
+        // C has no empty arrays
+        fprintf(pOutput->pFile, ELEMENT_INDENT "{0, 0}\n");
+    }
+    fprintf(pOutput->pFile, "};\nconst size_t %s_count = %d;\n\n", pOutput->pName, count);
+    fprintf(pOutput->pFile, "/* The log strings of %s, each ended by a null */\n", pOutput->pName);
+    fprintf(pOutput->pFile, "const char %s_strings[] =", pOutput->pName);
+    for (int x = 0; x < count; x++) {
+        fprintf(pOutput->pFile, "\n" ELEMENT_INDENT "\"");
+        writeQuoted(pOutput->pFile, pEntries[x].pString, pEntries[x].length);
+        fprintf(pOutput->pFile, "\\000\"");
+    }
+    if (count == 0) {
+        fprintf(pOutput->pFile, " \"\"");
+    }
+    fprintf(pOutput->pFile, ";\n");
+    fprintf(pOutput->pFile, "#define %s_find(token) arrayifyTokenFind(%s, %s_count, %s_strings, (token))\n",
+            pOutput->pName, pOutput->pName, pOutput->pName, pOutput->pName);
+    free(pEntries);
+    free(pOutput->pRecord);
+    pOutput->pRecord = NULL;
+}
+
+// The lengths of deflate matches which each length code starts from, and
+// the number of extra bits after the code for where in its range it is
+static const uint16_t deflateLengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                               35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char deflateLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                     3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+// The same for the distances of deflate matches
+static const uint16_t deflateDistanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                                 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char deflateDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7,
+                                                       8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// The order in which the lengths of the code length codes are written
+static const unsigned char deflateCodeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Add count bits to compressed data, the first in the least significant bit
+static void deflateBits(Deflate *pDeflate, uint32_t value, int count)
+{
+    unsigned char byte;
+
+    pDeflate->bits |= (uint64_t) value << pDeflate->bitCount;
+    pDeflate->bitCount += count;
+    while (pDeflate->bitCount >= 8) {
+        byte = (unsigned char) pDeflate->bits;
+        if (!bytesAdd(&pDeflate->out, &byte, 1)) {
+            pDeflate->failed = true;
+        }
+        pDeflate->bits >>= 8;
+        pDeflate->bitCount -= 8;
+    }
+}
+
+// Pad compressed data with zero bits to a whole byte
+static void deflateAlign(Deflate *pDeflate)
+{
+    deflateBits(pDeflate, 0, (8 - pDeflate->bitCount) & 7);
+}
+
+// Work out the lengths of the Huffman codes for count symbols with the given
+// frequencies, none being longer than limit bits: should any be, the frequencies
+// are flattened and the lengths worked out again, which rarely costs much
+static void huffmanLengths(const uint32_t *pFrequencies, int count, int limit, unsigned char *pLengths)
+{
+    uint32_t frequencies[288];
+    uint32_t weights[288 * 2];
+    int symbols[288];
+    int parents[288 * 2];
+    unsigned char depths[288 * 2];
+    int used;
+    int leaf;
+    int node;
+    int nodeCount;
+    int pick[2];
+    int longest;
+    int y;
+
+    memcpy(frequencies, pFrequencies, count * sizeof(frequencies[0]));
+    do {
+        memset(pLengths, 0, count);
+        // The symbols which are used, in order of frequency
+        used = 0;
+        for (int x = 0; x < count; x++) {
+            if (frequencies[x] > 0) {
+                for (y = used; (y > 0) && (weights[y - 1] > frequencies[x]); y--) {
+                    weights[y] = weights[y - 1];
+                    symbols[y] = symbols[y - 1];
+                }
+                weights[y] = frequencies[x];
+                symbols[y] = x;
+                used++;
+            }
+        }
+        if (used < 2) {
+            // A code needs two symbols to be complete, used or not
+            pLengths[(used > 0) ? symbols[0] : 0] = 1;
+            pLengths[((used > 0) && (symbols[0] == 0)) ? 1 : 0] = 1;
+            return;
+        }
+        // Two queues, one of the leaves and one of the nodes made from them,
+        // each in order of weight, the two lightest of either being joined
+        leaf = 0;
+        node = used;
+        nodeCount = used;
+        while (nodeCount < used * 2 - 1) {
+            for (int x = 0; x < 2; x++) {
+                if ((leaf < used) && ((node >= nodeCount) || (weights[leaf] <= weights[node]))) {
+                    pick[x] = leaf++;
+                } else {
+                    pick[x] = node++;
+                }
+            }
+            weights[nodeCount] = weights[pick[0]] + weights[pick[1]];
+            parents[pick[0]] = nodeCount;
+            parents[pick[1]] = nodeCount;
+            nodeCount++;
+        }
+        // A parent always comes after its children
+        depths[nodeCount - 1] = 0;
+        longest = 0;
+        for (int x = nodeCount - 2; x >= 0; x--) {
+            depths[x] = (unsigned char) (depths[parents[x]] + 1);
+            if ((x < used) && (depths[x] > longest)) {
+                longest = depths[x];
+            }
+        }
+        for (int x = 0; x < used; x++) {
+            pLengths[symbols[x]] = depths[x];
+            frequencies[symbols[x]] = (frequencies[symbols[x]] >> 1) | 1;
+        }
+    } while (longest > limit);
+}
+
+// Work out the canonical Huffman codes from their lengths, bit-reversed
+// since deflate writes codes from their most significant bit first
+static void huffmanCodes(const unsigned char *pLengths, int count, uint16_t *pCodes)
+{
+    int lengthCount[16] = {0};
+    uint16_t next[16];
+    uint16_t code = 0;
+    uint16_t reversed;
+
+    for (int x = 0; x < count; x++) {
+        lengthCount[pLengths[x]]++;
+    }
+    lengthCount[0] = 0;
+    for (int bits = 1; bits < 16; bits++) {
+        code = (uint16_t) ((code + lengthCount[bits - 1]) << 1);
+        next[bits] = code;
+    }
+    for (int x = 0; x < count; x++) {
+        reversed = 0;
+        if (pLengths[x] > 0) {
+            code = next[pLengths[x]]++;
+            for (int y = 0; y < pLengths[x]; y++) {
+                reversed = (uint16_t) ((reversed << 1) | ((code >> y) & 1));
+            }
+        }
+        pCodes[x] = reversed;
+    }
+}
+
+// Find the length code of a deflate match and its extra bits
+static int deflateLengthCode(int length)
+{
+    int code = 28;
+
+    while (deflateLengthBase[code] > length) {
+        code--;
+    }
+
+    return code;
+}
+
+// Find the distance code of a deflate match
+static int deflateDistanceCode(int distance)
+{
+    int code = 29;
+
+    while (deflateDistanceBase[code] > distance) {
+        code--;
+    }
+
+    return code;
+}
+
+// Write the code lengths of a dynamic Huffman block, or with pDeflate NULL
+// just count them, returning the number of bits
+static long deflateHeader(Deflate *pDeflate, const unsigned char *pLengths, int literalCount, int distanceCount)
+{
+    unsigned char symbols[286 + 30];
+    unsigned char extras[286 + 30];
+    uint32_t frequencies[19] = {0};
+    unsigned char lengths[19];
+    uint16_t codes[19];
+    int total = literalCount + distanceCount;
+    int symbolCount = 0;
+    int orderCount = 19;
+    int run;
+    long bits;
+
+    // The lengths, run-length encoded with codes 16 (repeat the last
+    // length), 17 (a short run of zeroes) and 18 (a long run of zeroes)
+    for (int x = 0; x < total; x += run) {
+        for (run = 1; (x + run < total) && (pLengths[x + run] == pLengths[x]); run++) {}
+        if ((pLengths[x] == 0) && (run >= 3)) {
+            run = (run > 138) ? 138 : run;
+            symbols[symbolCount] = (run >= 11) ? 18 : 17;
+            extras[symbolCount] = (unsigned char) ((run >= 11) ? run - 11 : run - 3);
+        } else if (run >= 4) {
+            symbols[symbolCount] = pLengths[x];
+            extras[symbolCount] = 0;
+            symbolCount++;
+            frequencies[pLengths[x]]++;
+            run = (run - 1 > 6) ? 7 : run;
+            symbols[symbolCount] = 16;
+            extras[symbolCount] = (unsigned char) (run - 4);
+        } else {
+            run = 1;
+            symbols[symbolCount] = pLengths[x];
+            extras[symbolCount] = 0;
+        }
+        frequencies[symbols[symbolCount]]++;
+        symbolCount++;
+    }
+    huffmanLengths(frequencies, 19, 7, lengths);
+    huffmanCodes(lengths, 19, codes);
+    while ((orderCount > 4) && (lengths[deflateCodeLengthOrder[orderCount - 1]] == 0)) {
+        orderCount--;
+    }
+
+    bits = 5 + 5 + 4 + orderCount * 3;
+    if (pDeflate != NULL) {
+        deflateBits(pDeflate, literalCount - 257, 5);
+        deflateBits(pDeflate, distanceCount - 1, 5);
+        deflateBits(pDeflate, orderCount - 4, 4);
+        for (int x = 0; x < orderCount; x++) {
+            deflateBits(pDeflate, lengths[deflateCodeLengthOrder[x]], 3);
+        }
+    }
+    for (int x = 0; x < symbolCount; x++) {
+        run = (symbols[x] == 16) ? 2 : (symbols[x] == 17) ? 3 : (symbols[x] == 18) ? 7 : 0;
+        bits += lengths[symbols[x]] + run;
+        if (pDeflate != NULL) {
+            deflateBits(pDeflate, codes[symbols[x]], lengths[symbols[x]]);
+            deflateBits(pDeflate, extras[x], run);
+        }
+    }
+
+    return bits;
+}
+
+// Write a block of deflate compressed data: its literals, or the lengths
+// of its matches, and the distances of its matches, zero for a literal,
+// from size bytes of data at pData; the block is written with the codes
+// of its own, the fixed codes or stored, whichever is the smallest
+static void deflateBlock(Deflate *pDeflate, const uint16_t *pValues, const uint16_t *pDistances, int symbolCount,
+                         const unsigned char *pData, long size, bool last)
+{
+    uint32_t literalFrequencies[286] = {0};
+    uint32_t distanceFrequencies[30] = {0};
+    unsigned char lengths[286 + 30];
+    unsigned char fixedLengths[286 + 30];
+    unsigned char *pLengths = lengths;
+    uint16_t literalCodes[286];
+    uint16_t distanceCodes[30];
+    int literalCount = 286;
+    int distanceCount = 30;
+    long extraBits = 0;
+    long dynamicBits;
+    long fixedBits = 3;
+    long storedBits;
+    long chunk;
+    int code;
+
+    for (int x = 0; x < symbolCount; x++) {
+        if (pDistances[x] == 0) {
+            literalFrequencies[pValues[x]]++;
+        } else {
+            code = deflateLengthCode(pValues[x]);
+            literalFrequencies[257 + code]++;
+            extraBits += deflateLengthExtra[code];
+            code = deflateDistanceCode(pDistances[x]);
+            distanceFrequencies[code]++;
+            extraBits += deflateDistanceExtra[code];
+        }
+    }
+    // The end of the block
+    literalFrequencies[256] = 1;
+
+    huffmanLengths(literalFrequencies, 286, 15, lengths);
+    huffmanLengths(distanceFrequencies, 30, 15, lengths + 286);
+    while (lengths[literalCount - 1] == 0) {
+        literalCount--;
+    }
+    while ((distanceCount > 1) && (lengths[286 + distanceCount - 1] == 0)) {
+        distanceCount--;
+    }
+    // The distance lengths follow straight on from the literal lengths
+    memmove(lengths + literalCount, lengths + 286, distanceCount);
+    dynamicBits = 3 + deflateHeader(NULL, lengths, literalCount, distanceCount) + extraBits;
+    for (int x = 0; x < 286 + 30; x++) {
+        fixedLengths[x] = (x < 144) ? 8 : (x < 256) ? 9 : (x < 280) ? 7 : (x < 286) ? 8 : 5;
+    }
+    for (int x = 0; x < 286; x++) {
+        dynamicBits += (long) literalFrequencies[x] * ((x < literalCount) ? lengths[x] : 0);
+        fixedBits += (long) literalFrequencies[x] * fixedLengths[x];
+    }
+    for (int x = 0; x < 30; x++) {
+        dynamicBits += (long) distanceFrequencies[x] * ((x < distanceCount) ? lengths[literalCount + x] : 0);
+        fixedBits += (long) distanceFrequencies[x] * 5;
+    }
+    fixedBits += extraBits;
+    storedBits = 3 + 7 + (size / 65535 + 1) * 32 + size * 8;
+
+    if ((storedBits < fixedBits) && (storedBits < dynamicBits)) {
+        // Stored, in chunks of no more than 65535 bytes
+        do {
+            chunk = (size > 65535) ? 65535 : size;
+            deflateBits(pDeflate, (last && (chunk == size)) ? 1 : 0, 3);
+            deflateAlign(pDeflate);
+            deflateBits(pDeflate, (uint32_t) chunk, 16);
+            deflateBits(pDeflate, (uint32_t) chunk ^ 0xffff, 16);
+            if (!bytesAdd(&pDeflate->out, pData, chunk)) {
+                pDeflate->failed = true;
+            }
+            pData += chunk;
+            size -= chunk;
+        } while (size > 0);
+        return;
+    }
+
+    if (fixedBits <= dynamicBits) {
+        deflateBits(pDeflate, last ? 3 : 2, 3);
+        pLengths = fixedLengths;
+        literalCount = 286;
+        distanceCount = 30;
+    } else {
+        deflateBits(pDeflate, last ? 5 : 4, 3);
+        deflateHeader(pDeflate, lengths, literalCount, distanceCount);
+    }
+    huffmanCodes(pLengths, literalCount, literalCodes);
+    huffmanCodes(pLengths + literalCount, distanceCount, distanceCodes);
+    for (int x = 0; x < symbolCount; x++) {
+        if (pDistances[x] == 0) {
+            deflateBits(pDeflate, literalCodes[pValues[x]], pLengths[pValues[x]]);
+        } else {
+            code = deflateLengthCode(pValues[x]);
+            deflateBits(pDeflate, literalCodes[257 + code], pLengths[257 + code]);
+            deflateBits(pDeflate, pValues[x] - deflateLengthBase[code], deflateLengthExtra[code]);
+            code = deflateDistanceCode(pDistances[x]);
+            deflateBits(pDeflate, distanceCodes[code], pLengths[literalCount + code]);
+            deflateBits(pDeflate, pDistances[x] - deflateDistanceBase[code], deflateDistanceExtra[code]);
+        }
+    }
+    deflateBits(pDeflate, literalCodes[256], pLengths[256]);
+}
+
+// Find the longest match for the data at position in what comes before it,
+// first adding the positions before it to the hash chains, returning its
+// length, which is less than three if there is none worth having
+static int deflateMatch(const unsigned char *pData, long size, long position, int32_t *pHeads, int32_t *pChain,
+                        long *pAdded, int *pDistance)
+{
+    long candidate;
+    int longest = 0;
+    int most = (size - position > DEFLATE_MAX_MATCH) ? DEFLATE_MAX_MATCH : (int) (size - position);
+    int length;
+    unsigned int hash;
+
+    for (; (*pAdded < position) && (*pAdded + 3 <= size); (*pAdded)++) {
+        hash = ((pData[*pAdded] << 10) ^ (pData[*pAdded + 1] << 5) ^ pData[*pAdded + 2]) & ((1 << DEFLATE_HASH_BITS) - 1);
+        pChain[*pAdded & (DEFLATE_WINDOW - 1)] = pHeads[hash];
+        pHeads[hash] = (int32_t) *pAdded;
+    }
+    if (most < 3) {
+        return 0;
+    }
+    hash = ((pData[position] << 10) ^ (pData[position + 1] << 5) ^ pData[position + 2]) & ((1 << DEFLATE_HASH_BITS) - 1);
+    candidate = pHeads[hash];
+    for (int x = 0; (x < DEFLATE_MAX_CHAIN) && (candidate >= 0) && (position - candidate <= DEFLATE_WINDOW); x++) {
+        if (pData[candidate + longest] == pData[position + longest]) {
+            for (length = 0; (length < most) && (pData[candidate + length] == pData[position + length]); length++) {}
+            if (length > longest) {
+                longest = length;
+                *pDistance = (int) (position - candidate);
+                if (longest == most) {
+                    break;
+                }
+            }
+        }
+        candidate = pChain[candidate & (DEFLATE_WINDOW - 1)];
+    }
+
+    return longest;
+}
+
+// Compress size bytes of data with deflate (RFC 1951), finding matches through
+// hash chains and taking a match only if the next byte has no longer one
+static bool deflateCompress(Deflate *pDeflate, const unsigned char *pData, long size)
+{
+    int32_t *pHeads = (int32_t *) malloc((1 << DEFLATE_HASH_BITS) * sizeof(int32_t));
+    int32_t *pChain = (int32_t *) malloc(DEFLATE_WINDOW * sizeof(int32_t));
+    uint16_t *pValues = (uint16_t *) malloc(DEFLATE_BLOCK_SYMBOLS * sizeof(uint16_t));
+    uint16_t *pDistances = (uint16_t *) malloc(DEFLATE_BLOCK_SYMBOLS * sizeof(uint16_t));
+    long position = 0;
+    long added = 0;
+    long blockStart = 0;
+    int symbolCount = 0;
+    int length;
+    int distance = 0;
+    int nextDistance;
+
+    if ((pHeads != NULL) && (pChain != NULL) && (pValues != NULL) && (pDistances != NULL)) {
+        // No position in a chain is -1
+        memset(pHeads, 0xff, (1 << DEFLATE_HASH_BITS) * sizeof(int32_t));
+        while (position < size) {
+            length = deflateMatch(pData, size, position, pHeads, pChain, &added, &distance);
+            if ((length >= 3) && (deflateMatch(pData, size, position + 1, pHeads, pChain, &added, &nextDistance) > length)) {
+                length = 0;
+            }
+            if (length >= 3) {
+                pValues[symbolCount] = (uint16_t) length;
+                pDistances[symbolCount] = (uint16_t) distance;
+                position += length;
+            } else {
+                pValues[symbolCount] = pData[position];
+                pDistances[symbolCount] = 0;
+                position++;
+            }
+            symbolCount++;
+            if ((symbolCount == DEFLATE_BLOCK_SYMBOLS) && (position < size)) {
+                deflateBlock(pDeflate, pValues, pDistances, symbolCount, pData + blockStart, position - blockStart, false);
+                blockStart = position;
+                symbolCount = 0;
+            }
+        }
+        deflateBlock(pDeflate, pValues, pDistances, symbolCount, pData + blockStart, position - blockStart, true);
+        deflateAlign(pDeflate);
+    } else {
+        pDeflate->failed = true;
+    }
+    free(pHeads);
+    free(pChain);
+    free(pValues);
+    free(pDistances);
+
+    return !pDeflate->failed;
+}
+
+// Compress data as gzip (RFC 1952) or, if zlib is true, in the zlib
+// format (RFC 1950), which is what HTTP calls deflate
+static bool webCompress(Deflate *pDeflate, const unsigned char *pData, long size, bool zlib)
+{
+    // No time or file name, so that the output is the same from build to build
+    static const unsigned char gzipHeader[] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+    static const unsigned char zlibHeader[] = {0x78, 0xda};
+    uint32_t check;
+    uint32_t sum1 = 1;
+    uint32_t sum2 = 0;
+    long chunk;
+
+    if (zlib) {
+        pDeflate->failed = !bytesAdd(&pDeflate->out, zlibHeader, sizeof(zlibHeader));
+        // Adler-32, as many bytes at a time as can be summed without overflow
+        for (long x = 0; x < size; x += chunk) {
+            chunk = (size - x > 5552) ? 5552 : size - x;
+            for (long y = x; y < x + chunk; y++) {
+                sum1 += pData[y];
+                sum2 += sum1;
+            }
+            sum1 %= 65521;
+            sum2 %= 65521;
+        }
+        check = (sum2 << 16) | sum1;
+    } else {
+        pDeflate->failed = !bytesAdd(&pDeflate->out, gzipHeader, sizeof(gzipHeader));
+        check = 0;
+        for (long x = 0; x < size; x += chunk) {
+            chunk = (size - x > INT_MAX) ? INT_MAX : size - x;
+            check = crcUpdate(CRC_TYPE_CRC32, check, (const char *) pData + x, (int) chunk);
+        }
+    }
+    deflateCompress(pDeflate, pData, size);
+    if (zlib) {
+        deflateBits(pDeflate, check >> 24, 8);
+        deflateBits(pDeflate, (check >> 16) & 0xff, 8);
+        deflateBits(pDeflate, (check >> 8) & 0xff, 8);
+        deflateBits(pDeflate, check & 0xff, 8);
+    } else {
+        deflateBits(pDeflate, check & 0xffff, 16);
+        deflateBits(pDeflate, check >> 16, 16);
+        // The length, modulo 2^32
+        deflateBits(pDeflate, (uint32_t) size & 0xffff, 16);
+        deflateBits(pDeflate, ((uint32_t) size >> 16) & 0xffff, 16);
+    }
+
+    return !pDeflate->failed;
+}
+
+// The Content-Type of web assets, by the extension of their file name
+static const struct {
+    const char *pExtension;
+    const char *pMime;
+} webMimes[] = {
+    {"html", "text/html; charset=utf-8"},
+    {"htm", "text/html; charset=utf-8"},
+    {"css", "text/css; charset=utf-8"},
+    {"js", "text/javascript; charset=utf-8"},
+    {"mjs", "text/javascript; charset=utf-8"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"webmanifest", "application/manifest+json"},
+    {"txt", "text/plain; charset=utf-8"},
+    {"xml", "application/xml"},
+    {"csv", "text/csv; charset=utf-8"},
+    {"svg", "image/svg+xml"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"avif", "image/avif"},
+    {"ico", "image/x-icon"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"otf", "font/otf"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"}
+};
+
+// Find the Content-Type of a web asset from its file name
+static const char *webMime(const char *pFileName)
+{
+    const char *pExtension = strrchr(pFileName, *EXT_SEPARATOR);
+    int y;
+
+    if ((pExtension != NULL) && (strpbrk(pExtension, DIR_SEPARATORS) == NULL)) {
+        pExtension++;
+        for (size_t x = 0; x < sizeof(webMimes) / sizeof(webMimes[0]); x++) {
+            for (y = 0; (pExtension[y] != 0) && (tolower((unsigned char) pExtension[y]) == webMimes[x].pExtension[y]); y++) {}
+            if ((pExtension[y] == 0) && (webMimes[x].pExtension[y] == 0)) {
+                return webMimes[x].pMime;
+            }
+        }
+    }
+
+    return "application/octet-stream";
+}
+
+// Work out the path by which a web asset is asked for from its file name,
+// as given, which is relative to the root of the web site: without any
+// leading "./", with '/' as the separator and starting with '/'
+static char *webPath(const char *pFileName)
+{
+    char *pPath;
+
+    while ((pFileName[0] == '.') && (strchr(DIR_SEPARATORS, pFileName[1]) != NULL) && (pFileName[1] != 0)) {
+        pFileName += 2;
+    }
+    pPath = (char *) malloc(strlen(pFileName) + 2);
+    if (pPath != NULL) {
+        pPath[0] = '/';
+        strcpy(pPath + 1, pFileName);
+        for (char *pTmp = pPath; *pTmp != 0; pTmp++) {
+            if (strchr(DIR_SEPARATORS, *pTmp) != NULL) {
+                *pTmp = '/';
+            }
+        }
+    }
+
+    return pPath;
+}
+
+// Work out the default name of a web asset from its path, which, unlike
+// the file name alone, is unique in the web site: the path without the
+// leading '/', each character which cannot be in a C identifier made '_',
+// e.g. css/index.css gives css_index_css, and with a '_' before one which
+// would start with a digit; returns it, to be freed, or NULL
+static char *webName(const char *pFileName)
+{
+    char *pName = webPath(pFileName);
+
+    if (pName != NULL) {
+        if (!isdigit((unsigned char) pName[1])) {
+            memmove(pName, pName + 1, strlen(pName));
+        }
+        for (char *pTmp = pName; *pTmp != 0; pTmp++) {
+            if (!isalnum((unsigned char) *pTmp)) {
+                *pTmp = '_';
+            }
+        }
+    }
+
+    return pName;
+}
+
+// Compare two names, for qsort()
+static int webCompareNames(const void *pFirst, const void *pSecond)
+{
+    return strcmp(*(char * const *) pFirst, *(char * const *) pSecond);
+}
+
+// The type of a web asset, emitted with the web formats
+static const char webAsset[] =
+    "#ifndef ARRAYIFY_WEB_ASSET\n"
+    "#define ARRAYIFY_WEB_ASSET\n"
+    "/* A web asset, to be sent as it is with its Content-Type, ETag and,\n"
+    "   where encoding is not NULL, Content-Encoding headers */\n"
+    "typedef struct {\n"
+    "    const char *path;\n"
+    "    const char *mime;\n"
+    "    const char *etag;\n"
+    "    const unsigned char *data;\n"
+    "    size_t len;\n"
+    "    const char *encoding;\n"
+    "} ArrayifyWebAsset;\n"
+    "#endif\n";
+
+// Code to find a web asset by its path, emitted with the web_index format
+static const char webFind[] =
+    "\n#ifndef ARRAYIFY_WEB_FIND\n"
+    "#define ARRAYIFY_WEB_FIND\n"
+    "#include <string.h>\n"
+    "/* Find the asset with the given path, length characters long and not\n"
+    "   necessarily terminated, in count assets sorted by path, returning NULL\n"
+    "   if there is none */\n"
+    "static ARRAYIFY_UNUSED const ArrayifyWebAsset *arrayifyWebFind(const ArrayifyWebAsset * const *ppAssets,\n"
+    "                                                               size_t count, const char *pPath, size_t length)\n"
+    "{\n"
+    "    size_t first = 0;\n"
+    "    size_t middle;\n"
+    "    size_t assetLength;\n"
+    "    int compare;\n"
+    "\n"
+    "    while (first < count) {\n"
+    "        middle = first + (count - first) / 2;\n"
+    "        assetLength = strlen(ppAssets[middle]->path);\n"
+    "        compare = memcmp(ppAssets[middle]->path, pPath, (assetLength < length) ? assetLength : length);\n"
+    "        if (compare == 0) {\n"
+    "            compare = (assetLength > length) - (assetLength < length);\n"
+    "        }\n"
+    "        if (compare == 0) {\n"
+    "            return ppAssets[middle];\n"
+    "        } else if (compare < 0) {\n"
+    "            first = middle + 1;\n"
+    "        } else {\n"
+    "            count = middle;\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    return NULL;\n"
+    "}\n"
+    "#endif\n";
+
+// Compress the input and write it as a web asset: the array of bytes to
+// send and the asset which describes them; if zlib is true it is compressed
+// in the zlib format, else as gzip, and if compressing it makes it no smaller
+// it is sent as it is
+static void webConvert(Output *pOutput, bool zlib)
+{
+    Deflate deflate;
+    Sha256 sha256;
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    const unsigned char *pData = (const unsigned char *) pOutput->pRecord;
+    long size = pOutput->recordFill;
+    const char *pEncoding = zlib ? "deflate" : "gzip";
+    char *pPath = webPath(pOutput->pInputFileName);
+
+    memset(&deflate, 0, sizeof(deflate));
+    if (!webCompress(&deflate, pData, size, zlib)) {
+        printf("Cannot allocate memory to compress %s, it is not compressed.\n", pOutput->pName);
+    }
+    if (deflate.failed || (deflate.out.size >= size)) {
+        pEncoding = NULL;
+    } else {
+        pData = deflate.out.pData;
+        size = deflate.out.size;
+    }
+    // A strong ETag, of the bytes as they are sent
+    sha256Start(&sha256);
+    sha256Update(&sha256, (const char *) pData, size);
+    sha256Finish(&sha256, digest);
+
+    fprintf(pOutput->pFile, "#include <stddef.h>\n\n%s\n", webAsset);
+    fprintf(pOutput->pFile, "/* %s, %ld bytes %s%s from %d */\n", (pPath != NULL) ? pPath : pOutput->pInputFileName,
+            size, (pEncoding != NULL) ? "compressed as " : "not compressed, as it would be no smaller,",
+            (pEncoding != NULL) ? pEncoding : "", pOutput->recordFill);
+    fprintf(pOutput->pFile, "const unsigned char %s[] = {\n", pOutput->pName);
+    for (long x = 0; x < size; x++) {
+        writeByte(pOutput, pData[x]);
+    }
+    if (size == 0) {
+        // C has no empty arrays
+        writeByte(pOutput, 0);
+    }
+    elementsEnd(pOutput);
+    fprintf(pOutput->pFile, "const ArrayifyWebAsset %s_asset = {\"", pOutput->pName);
+    if (pPath != NULL) {
+        writeQuoted(pOutput->pFile, pPath, strlen(pPath));
+    } else {
+        printf("Cannot allocate memory for the path of %s.\n", pOutput->pName);
+    }
+    fprintf(pOutput->pFile, "\", \"%s\", \"\\\"", webMime(pOutput->pInputFileName));
+    for (int x = 0; x < WEB_ETAG_BYTES; x++) {
+        fprintf(pOutput->pFile, "%02x", digest[x]);
+    }
+    fprintf(pOutput->pFile, "\\\"\", %s, %ld, ", pOutput->pName, size);
+    if (pEncoding != NULL) {
+        fprintf(pOutput->pFile, "\"%s\"};\n", pEncoding);
+    } else {
+        fprintf(pOutput->pFile, "NULL};\n");
+    }
+
+    free(pPath);
+    free(deflate.out.pData);
+    free(pOutput->pRecord);
+    pOutput->pRecord = NULL;
+}
+
+// Finish off the web format
+static void webEnd(Output *pOutput)
+{
+    webConvert(pOutput, false);
+}
+
+// Finish off the web_deflate format
+static void webDeflateEnd(Output *pOutput)
+{
+    webConvert(pOutput, true);
+}
+
+// An entry in the list of web assets for the web_index format
+typedef struct {
+    char *pPath;
+    char *pName;
+} WebEntry;
+
+// Compare the paths of two web assets, for qsort()
+static int webCompareEntries(const void *pFirst, const void *pSecond)
+{
+    return strcmp(((const WebEntry *) pFirst)->pPath, ((const WebEntry *) pSecond)->pPath);
+}
+
+// Finish off the web_index format: the input is a list of the file names
+// of the web assets, as they were given to arrayify, one on each line,
+// each optionally followed by a tab and the name it was given with -n,
+// and the index is of their assets sorted by path
+static void webIndexEnd(Output *pOutput)
+{
+    WebEntry *pEntries = NULL;
+    int entryCount = 0;
+    char *pLine = pOutput->pRecord;
+    char *pNext;
+    char *pName;
+    char **ppNames;
+    bool valid = true;
+
+    // A line for each asset, at most
+    if (pLine != NULL) {
+        pLine[pOutput->recordFill] = 0;
+        entryCount = 1;
+        for (char *pTmp = pLine; *pTmp != 0; pTmp++) {
+            entryCount += (*pTmp == '\n');
+        }
+        pEntries = (WebEntry *) calloc(entryCount, sizeof(WebEntry));
+        valid = (pEntries != NULL);
+        entryCount = 0;
+    }
+    for (; valid && (pLine != NULL) && (*pLine != 0); pLine = pNext) {
+        pNext = pLine + strcspn(pLine, "\n");
+        if (*pNext != 0) {
+            *pNext++ = 0;
+        }
+        pLine[strcspn(pLine, "\r")] = 0;
+        if (*pLine != 0) {
+            pName = strchr(pLine, '\t');
+            if (pName != NULL) {
+                *pName++ = 0;
+            }
+            pEntries[entryCount].pPath = webPath(pLine);
+            if (pName == NULL) {
+                pEntries[entryCount].pName = webName(pLine);
+            } else {
+                pEntries[entryCount].pName = (char *) malloc(strlen(pName) + 1);
+                if (pEntries[entryCount].pName != NULL) {
+                    strcpy(pEntries[entryCount].pName, pName);
+                }
+            }
+            valid = (pEntries[entryCount].pPath != NULL) && (pEntries[entryCount].pName != NULL);
+            entryCount++;
+        }
+    }
+    if (!valid) {
+        printf("Cannot allocate memory for the index %s.\n", pOutput->pName);
+        fprintf(pOutput->pFile, "# error out of memory\n");
+        pOutput->failed = true;
+    }
+
+    fprintf(pOutput->pFile, "#include <stddef.h>\n\n%s\n", webAsset);
+    if (valid) {
+        qsort(pEntries, entryCount, sizeof(WebEntry), webCompareEntries);
+        for (int x = 0; x < entryCount; x++) {
+            if ((x > 0) && (strcmp(pEntries[x - 1].pPath, pEntries[x].pPath) == 0)) {
+                printf("Web asset path %s is in %s more than once.\n", pEntries[x].pPath, pOutput->pName);
+                fprintf(pOutput->pFile, "# error web asset path %s is in the index more than once\n", pEntries[x].pPath);
+                pOutput->failed = true;
+            }
+            fprintf(pOutput->pFile, "extern const ArrayifyWebAsset %s_asset;\n", pEntries[x].pName);
+        }
+        // Different paths may still give the same name, e.g. a_b.css and a/b.css
+        ppNames = (char **) malloc((entryCount + 1) * sizeof(char *));
+        for (int x = 0; (ppNames != NULL) && (x < entryCount); x++) {
+            ppNames[x] = pEntries[x].pName;
+        }
+        if (ppNames != NULL) {
+            qsort(ppNames, entryCount, sizeof(char *), webCompareNames);
+        }
+        for (int x = 1; (ppNames != NULL) && (x < entryCount); x++) {
+            if (strcmp(ppNames[x - 1], ppNames[x]) == 0) {
+                printf("Web asset name %s is in %s more than once: give the assets names of their own with -n,"
+                       " and in the list after a tab.\n", ppNames[x], pOutput->pName);
+                fprintf(pOutput->pFile, "# error web asset name %s is in the index more than once\n", ppNames[x]);
+                pOutput->failed = true;
+            }
+        }
+        free(ppNames);
+    }
+    fprintf(pOutput->pFile, "\n/* The %d assets of %s, sorted by path for %s_find() */\n", entryCount,
+            pOutput->pName, pOutput->pName);
+    fprintf(pOutput->pFile, "const ArrayifyWebAsset * const %s[] = {\n", pOutput->pName);
+    for (int x = 0; valid && (x < entryCount); x++) {
+        fprintf(pOutput->pFile, ELEMENT_INDENT "&%s_asset, /* %s */\n", pEntries[x].pName, pEntries[x].pPath);
+    }
+    if (!valid || (entryCount == 0)) {
+        // C has no empty arrays
+        fprintf(pOutput->pFile, ELEMENT_INDENT "NULL\n");
+    }
+    fprintf(pOutput->pFile, "};\n");
+    fprintf(pOutput->pFile, "const size_t %s_count = %d;\n", pOutput->pName, valid ? entryCount : 0);
+    writeHelper(pOutput->pFile, webFind);
+    fprintf(pOutput->pFile, "#define %s_find(pPath, length) arrayifyWebFind(%s, %s_count, (pPath), (length))\n",
+            pOutput->pName, pOutput->pName, pOutput->pName);
+
+    for (int x = 0; (pEntries != NULL) && (x < entryCount); x++) {
+        free(pEntries[x].pPath);
+        free(pEntries[x].pName);
+    }
+    free(pEntries);
+    free(pOutput->pRecord);
+    pOutput->pRecord = NULL;
+}
+
+// Copy a buffer of input to a raw binary output, e.g. for a partition image
+static void binWrite(Output *pOutput, const char *pBuffer, int size)
+{
+    fwrite(pBuffer, size, 1, pOutput->pFile);
+    pOutput->position += size;
+}
+
+// Write a string to a JSON output, quoted and escaped
+static void jsonString(FILE *pFile, const char *pString)
+{
+    fputc('"', pFile);
+    for (; *pString != 0; pString++) {
+        if ((*pString == '"') || (*pString == '\\')) {
+            fprintf(pFile, "\\%c", *pString);
+        } else if ((unsigned char) *pString < 0x20) {
+            fprintf(pFile, "\\u%04x", *pString);
+        } else {
+            fputc(*pString, pFile);
+        }
+    }
+    fputc('"', pFile);
+}
+
+// Nothing is written to a statistics output until the input has been read
+static void statsWrite(Output *pOutput, const char *pBuffer, int size)
+{
+    (void) pOutput;
+    (void) pBuffer;
+    (void) size;
+}
+
+// Write the statistics of the input, as JSON
+static void statsEnd(Output *pOutput)
+{
+    const Input *pInput = pOutput->pInput;
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_DIGEST_SIZE * 2 + 1];
+
+    fprintf(pOutput->pFile, "{\n    \"name\": ");
+    jsonString(pOutput->pFile, pOutput->pName);
+    fprintf(pOutput->pFile, ",\n    \"input\": ");
+    jsonString(pOutput->pFile, pOutput->pInputFileName);
+    fprintf(pOutput->pFile, ",\n    \"length\": %lld", pInput->length);
+    if (pInput->crcType != CRC_TYPE_NONE) {
+        fprintf(pOutput->pFile, ",\n    \"%s\": \"0x%08lx\"", crcTypes[pInput->crcType].pName,
+                (unsigned long) pInput->crc);
+    }
+    if (pInput->digest) {
+        inputDigest(pInput, digest, hex);
+        fprintf(pOutput->pFile, ",\n    \"sha256\": \"%s\"", hex);
+    }
+    fprintf(pOutput->pFile, "\n}\n");
+}
+
+// The accessors for -r, the same whatever the format of the array: a
+// resource is opened and read from start to end, as a file would be
+static const char resourceAccessors[] =
+    "\n#ifndef ARRAYIFY_RESOURCE\n"
+    "#define ARRAYIFY_RESOURCE\n"
+    "#include <stddef.h>\n"
+    "#include <string.h>\n"
+    "typedef struct ArrayifyHandle ArrayifyHandle;\n"
+    "/* An array as a resource: the bytes which it gives, however it holds them */\n"
+    "typedef struct {\n"
+    "    const unsigned char *direct; /* the bytes, if the array holds them as they are, else NULL */\n"
+    "    size_t size;                 /* the number of bytes */\n"
+    "    const void *data;            /* else what the array holds them as, for read */\n"
+    "    size_t count;                /* for a sparse array, the number of extents in data */\n"
+    "    size_t (*read)(ArrayifyHandle *pHandle, unsigned char *pBuffer, size_t size); /* else NULL */\n"
+    "} ArrayifyResource;\n"
+    "/* A resource being read */\n"
+    "struct ArrayifyHandle {\n"
+    "    const ArrayifyResource *resource;\n"
+    "    size_t offset;   /* of the next byte to be read */\n"
+    "    size_t position; /* where read has got to in data */\n"
+    "    size_t run;      /* for rle, what is left of the run or literal which is being read */\n"
+    "    int repeat;      /* for rle, the byte of that run, or -1 if it is a literal */\n"
+    "};\n"
+    "\n"
+    "/* Start reading a resource from its first byte */\n"
+    "static ARRAYIFY_UNUSED void arrayify_open(ArrayifyHandle *pHandle, const ArrayifyResource *pResource)\n"
+    "{\n"
+    "    memset(pHandle, 0, sizeof(*pHandle));\n"
+    "    pHandle->resource = pResource;\n"
+    "}\n"
+    "\n"
+    "/* Read up to size bytes of a resource into pBuffer, returning the number\n"
+    "   read, which is only less than size at the end of the resource */\n"
+    "static ARRAYIFY_UNUSED size_t arrayify_read(ArrayifyHandle *pHandle, void *pBuffer, size_t size)\n"
+    "{\n"
+    "    const ArrayifyResource *pResource = pHandle->resource;\n"
+    "\n"
+    "    if (size > pResource->size - pHandle->offset) {\n"
+    "        size = pResource->size - pHandle->offset;\n"
+    "    }\n"
+    "    if (size > 0) {\n"
+    "        if (pResource->direct != NULL) {\n"
+    "            memcpy(pBuffer, pResource->direct + pHandle->offset, size);\n"
+    "        } else {\n"
+    "            size = pResource->read(pHandle, (unsigned char *) pBuffer, size);\n"
+    "        }\n"
+    "        pHandle->offset += size;\n"
+    "    }\n"
+    "\n"
+    "    return size;\n"
+    "}\n"
+    "\n"
+    "/* Return the number of bytes in a resource */\n"
+    "static ARRAYIFY_UNUSED size_t arrayify_size(const ArrayifyResource *pResource)\n"
+    "{\n"
+    "    return pResource->size;\n"
+    "}\n"
+    "\n"
+    "/* Return the bytes of a resource, to be used where they are, if the array\n"
+    "   holds them as they are, else NULL, in which case arrayify_read() them */\n"
+    "static ARRAYIFY_UNUSED const void *arrayify_ptr_if_direct(const ArrayifyResource *pResource)\n"
+    "{\n"
+    "    return pResource->direct;\n"
+    "}\n"
+    "#endif\n";
+
+// Reader of a Base64 resource, which decodes the groups of four
+// characters which hold the bytes asked for
+static const char base64Reader[] =
+    "\n#ifndef ARRAYIFY_RESOURCE_BASE64\n"
+    "#define ARRAYIFY_RESOURCE_BASE64\n"
+    "static ARRAYIFY_UNUSED unsigned long arrayifyBase64Value(char c)\n"
+    "{\n"
+    "    if ((c >= 'A') && (c <= 'Z')) {\n"
+    "        return c - 'A';\n"
+    "    } else if ((c >= 'a') && (c <= 'z')) {\n"
+    "        return c - 'a' + 26;\n"
+    "    } else if ((c >= '0') && (c <= '9')) {\n"
+    "        return c - '0' + 52;\n"
+    "    }\n"
+    "\n"
+    "    return (c == '+') ? 62 : (c == '/') ? 63 : 0;\n"
+    "}\n"
+    "\n"
+    "static ARRAYIFY_UNUSED size_t arrayifyReadBase64(ArrayifyHandle *pHandle, unsigned char *pBuffer, size_t size)\n"
+    "{\n"
+    "    size_t offset = pHandle->offset;\n"
+    "    const char *pText;\n"
+    "    unsigned long group;\n"
+    "    size_t x = 0;\n"
+    "\n"
+    "    while (x < size) {\n"
+    "        pText = (const char *) pHandle->resource->data + (offset / 3) * 4;\n"
+    "        group = (arrayifyBase64Value(pText[0]) << 18) | (arrayifyBase64Value(pText[1]) << 12) |\n"
+    "                (arrayifyBase64Value(pText[2]) << 6) | arrayifyBase64Value(pText[3]);\n"
+    "        do {\n"
+    "            pBuffer[x++] = (unsigned char) (group >> (16 - (offset % 3) * 8));\n"
+    "            offset++;\n"
+    "        } while ((x < size) && (offset % 3 != 0));\n"
+    "    }\n"
+    "\n"
+    "    return size;\n"
+    "}\n"
+    "#endif\n";
+
+// Reader of a Z85 resource, which decodes the groups of five
+// characters which hold the bytes asked for
+static const char z85Reader[] =
+    "\n#ifndef ARRAYIFY_RESOURCE_Z85\n"
+    "#define ARRAYIFY_RESOURCE_Z85\n"
+    "static ARRAYIFY_UNUSED unsigned long arrayifyZ85Value(char c)\n"
+    "{\n"
+    "    static const char alphabet[] = \"" Z85_ALPHABET "\";\n"
+    "\n"
+    "    if ((c >= '0') && (c <= '9')) {\n"
+    "        return c - '0';\n"
+    "    } else if ((c >= 'a') && (c <= 'z')) {\n"
+    "        return c - 'a' + 10;\n"
+    "    } else if ((c >= 'A') && (c <= 'Z')) {\n"
+    "        return c - 'A' + 36;\n"
+    "    }\n"
+    "\n"
+    "    return strchr(alphabet + 62, c) - alphabet;\n"
+    "}\n"
+    "\n"
+    "static ARRAYIFY_UNUSED size_t arrayifyReadZ85(ArrayifyHandle *pHandle, unsigned char *pBuffer, size_t size)\n"
+    "{\n"
+    "    size_t offset = pHandle->offset;\n"
+    "    const char *pText;\n"
+    "    unsigned long group;\n"
+    "    size_t x = 0;\n"
+    "    int y;\n"
+    "\n"
+    "    while (x < size) {\n"
+    "        pText = (const char *) pHandle->resource->data + (offset / 4) * 5;\n"
+    "        group = 0;\n"
+    "        for (y = 0; y < 5; y++) {\n"
+    "            group = group * 85 + arrayifyZ85Value(pText[y]);\n"
+    "        }\n"
+    "        do {\n"
+    "            pBuffer[x++] = (unsigned char) (group >> (24 - (offset % 4) * 8));\n"
+    "            offset++;\n"
+    "        } while ((x < size) && (offset % 4 != 0));\n"
+    "    }\n"
+    "\n"
+    "    return size;\n"
+    "}\n"
+    "#endif\n";
+
+// Reader of a run-length encoded resource, which carries on from the
+// run or literal that the last read got to, as arrayifyRleExpand() does
+static const char rleReader[] =
+    "\n#ifndef ARRAYIFY_RESOURCE_RLE\n"
+    "#define ARRAYIFY_RESOURCE_RLE\n"
+    "static ARRAYIFY_UNUSED size_t arrayifyReadRle(ArrayifyHandle *pHandle, unsigned char *pBuffer, size_t size)\n"
+    "{\n"
+    "    const unsigned char *pRle = (const unsigned char *) pHandle->resource->data;\n"
+    "    size_t x = 0;\n"
+    "    size_t count;\n"
+    "\n"
+    "    while (x < size) {\n"
+    "        if (pHandle->run == 0) {\n"
+    "            pRle += pHandle->position;\n"
+    "            if (*pRle < 0x80) {\n"
+    "                pHandle->run = *pRle + 1;\n"
+    "                pHandle->repeat = -1;\n"
+    "                pHandle->position++;\n"
+    "            } else if (*pRle < 0xff) {\n"
+    "                pHandle->run = *pRle - 0x7d;\n"
+    "                pHandle->repeat = pRle[1];\n"
+    "                pHandle->position += 2;\n"
+    "            } else {\n"
+    "                pHandle->run = pRle[2] | ((size_t) pRle[3] << 8) | ((size_t) pRle[4] << 16) | ((size_t) pRle[5] << 24);\n"
+    "                pHandle->repeat = pRle[1];\n"
+    "                pHandle->position += 6;\n"
+    "            }\n"
+    "            pRle = (const unsigned char *) pHandle->resource->data;\n"
+    "        }\n"
+    "        count = (pHandle->run < size - x) ? pHandle->run : size - x;\n"
+    "        if (pHandle->repeat < 0) {\n"
+    "            memcpy(pBuffer + x, pRle + pHandle->position, count);\n"
+    "            pHandle->position += count;\n"
+    "        } else {\n"
+    "            memset(pBuffer + x, pHandle->repeat, count);\n"
+    "        }\n"
+    "        pHandle->run -= count;\n"
+    "        x += count;\n"
+    "    }\n"
+    "\n"
+    "    return size;\n"
+    "}\n"
+    "#endif\n";
+
+// Reader of a sparse resource, which reads the extents rather than the
+// array, so that name_init() need not have been called
+static const char sparseReader[] =
+    "\n#ifndef ARRAYIFY_RESOURCE_SPARSE\n"
+    "#define ARRAYIFY_RESOURCE_SPARSE\n"
+    "static ARRAYIFY_UNUSED size_t arrayifyReadSparse(ArrayifyHandle *pHandle, unsigned char *pBuffer, size_t size)\n"
+    "{\n"
+    "    const ArrayifyExtent *pExtents = (const ArrayifyExtent *) pHandle->resource->data;\n"
+    "    size_t count = pHandle->resource->count;\n"
+    "    size_t start = pHandle->offset;\n"
+    "    size_t end = start + size;\n"
+    "    size_t from;\n"
+    "    size_t to;\n"
+    "    size_t x;\n"
+    "\n"
+    "    memset(pBuffer, 0, size);\n"
+    "    /* The extents are in order and reads go forwards, so skip those which have been passed */\n"
+    "    while ((pHandle->position < count) &&\n"
+    "           (pExtents[pHandle->position].offset + pExtents[pHandle->position].length <= start)) {\n"
+    "        pHandle->position++;\n"
+    "    }\n"
+    "    for (x = pHandle->position; (x < count) && (pExtents[x].offset < end); x++) {\n"
+    "        from = (pExtents[x].offset > start) ? pExtents[x].offset : start;\n"
+    "        to = (pExtents[x].offset + pExtents[x].length < end) ? pExtents[x].offset + pExtents[x].length : end;\n"
+    "        memcpy(pBuffer + from - start, pExtents[x].pData + from - pExtents[x].offset, to - from);\n"
+    "    }\n"
+    "\n"
+    "    return size;\n"
+    "}\n"
+    "#endif\n";
+
+// Start the resource of an array, for -r: the accessors and the reader
+// of the format, if it needs one, then the start of its definition
+static void resourceStart(Output *pOutput, const char *pReader)
+{
+    writeHelper(pOutput->pFile, resourceAccessors);
+    if (pReader != NULL) {
+        fprintf(pOutput->pFile, "%s", pReader);
+    }
+    fprintf(pOutput->pFile, "\n/* %s as a resource, for arrayify_open() and the rest */\n", pOutput->pName);
+    fprintf(pOutput->pFile, "const ArrayifyResource %s_resource = ", pOutput->pName);
+}
+
+// Write the resource of a string literal, which holds the input as it is
+static void literalResource(Output *pOutput)
+{
+    resourceStart(pOutput, NULL);
+    fprintf(pOutput->pFile, "{(const unsigned char *) %s, sizeof(%s) - 1, NULL, 0, NULL};\n",
+            pOutput->pName, pOutput->pName);
+}
+
+// Write the resource of a std::string_view, over its char array
+static void stringViewResource(Output *pOutput)
+{
+    resourceStart(pOutput, NULL);
+    fprintf(pOutput->pFile, "{(const unsigned char *) %s_data, sizeof(%s_data) - 1, NULL, 0, NULL};\n",
+            pOutput->pName, pOutput->pName);
+}
+
+// Write the resource of a std::array of std::byte
+static void byteArrayResource(Output *pOutput)
+{
+    resourceStart(pOutput, NULL);
+    fprintf(pOutput->pFile, "{reinterpret_cast<const unsigned char *>(%s.data()), %lld, NULL, 0, NULL};\n",
+            pOutput->pName, pOutput->inputSize);
+}
+
+// Write the resource of a word format, whose words hold the bytes as they
+// are on a target of the endianness given with -e
+static void wordsResource(Output *pOutput)
+{
+    resourceStart(pOutput, NULL);
+    fprintf(pOutput->pFile, "{(const unsigned char *) %s_words, %lld, NULL, 0, NULL};\n",
+            pOutput->pName, pOutput->inputSize);
+}
+
+// Write the resource of the adaptive format, over its segments
+static void adaptiveResource(Output *pOutput)
+{
+    resourceStart(pOutput, NULL);
+    fprintf(pOutput->pFile, "{(const unsigned char *) &%s_segments, %lld, NULL, 0, NULL};\n",
+            pOutput->pName, pOutput->inputSize);
+}
+
+// Write the resource of a CBOR format, whose bytes are the CBOR
+static void cborResource(Output *pOutput)
+{
+    resourceStart(pOutput, NULL);
+    fprintf(pOutput->pFile, "{%s, sizeof(%s), NULL, 0, NULL};\n", pOutput->pName, pOutput->pName);
+}
+
+// Write the resource of a Base64 string literal, which is decoded as it is read
+static void base64Resource(Output *pOutput)
+{
+    resourceStart(pOutput, base64Reader);
+    fprintf(pOutput->pFile, "{NULL, %lld, %s, 0, arrayifyReadBase64};\n", pOutput->inputSize, pOutput->pName);
+}
+
+// Write the resource of a Z85 string literal, which is decoded as it is read
+static void z85Resource(Output *pOutput)
+{
+    resourceStart(pOutput, z85Reader);
+    fprintf(pOutput->pFile, "{NULL, %lld, %s, 0, arrayifyReadZ85};\n", pOutput->inputSize, pOutput->pName);
+}
+
+// Write the resource of a run-length encoded array, which is expanded as it is read
+static void rleResource(Output *pOutput)
+{
+    resourceStart(pOutput, rleReader);
+    fprintf(pOutput->pFile, "{NULL, %lld, %s_rle, 0, arrayifyReadRle};\n", pOutput->inputSize, pOutput->pName);
+}
+
+// Write the resource of a sparse array, which is read from its extents
+static void sparseResource(Output *pOutput)
+{
+    resourceStart(pOutput, sparseReader);
+    fprintf(pOutput->pFile, "{NULL, %lld, %s_extents, %d, arrayifyReadSparse};\n", pOutput->inputSize,
+            pOutput->pName, pOutput->extentCount);
+}
+
+// The output formats; the first is the default
+static const Format formats[] = {
+    {"c", "a C const char array holding a string literal", PREFIX, false,
+     NULL, literalWrite, cEnd, NULL, false, true, false, "const char", "%s", literalResource},
+    {"string_view", "a C++17 inline constexpr std::string_view, name, over the char array name_data",
+     "inline constexpr char %s_data[] = ", false, stringViewStart, literalWrite, stringViewEnd, NULL, false, true,
+     false, NULL, NULL, stringViewResource},
+    {"byte_array", "a C++17 inline constexpr std::array<std::byte, N>, plus a C++20 std::span<const std::byte, N>, name_span",
+     NULL, true, byteArrayStart, byteArrayWrite, byteArrayEnd, NULL, false, false, false, NULL, NULL, byteArrayResource},
+    {"u32", "a C const uint32_t array, name_words, for word-wise copying, with its length in bytes, name_len, and a byte pointer, name",
+     NULL, true, u32Start, wordsWrite, wordsEnd, NULL, false, false, true, "const uint32_t", "%s_words", wordsResource},
+    {"u64", "as u32 but using a const uint64_t array", NULL, true, u64Start, wordsWrite, wordsEnd, NULL, false, false, true,
+     "const uint64_t", "%s_words", wordsResource},
+    {"base64", "a C const char array holding the input Base64 encoded, with its decoded length, name_decoded_len",
+     PREFIX, true, textSafeStart, base64Write, base64End, NULL, false, false, false, NULL, NULL, base64Resource},
+    {"z85", "as base64 but Z85 encoded, padded with zeroes to a multiple of four bytes",
+     PREFIX, true, textSafeStart, z85Write, z85End, NULL, false, false, false, NULL, NULL, z85Resource},
+    {"rle", "a C const unsigned char array, name_rle, holding the input run-length encoded, its length, name_rle_len, the "
+     "decoded length, name_len, and a C function to expand it", NULL, true, rleStart, rleWrite, rleEnd, rleZeros,
+     false, false, false, NULL, NULL, rleResource},
+    {"sparse", "a C unsigned char array, name, left zero in .bss, with a table of the extents of the input which are not "
+     "zero, name_extents, and a C function, name_init(), to copy them in", NULL, true, sparseStart, sparseWrite, sparseEnd,
+     sparseZeros, false, false, false, NULL, NULL, sparseResource},
+    {"adaptive", "for C, a struct of string literals and byte arrays, whichever is the shorter for each part of the "
+     "input, pointed to as bytes by name, with its length, name_len", NULL, true, adaptiveStart, adaptiveWrite, adaptiveEnd,
+     NULL, false, false, true, NULL, NULL, adaptiveResource},
+    {"raw", "a C++11 const char array of raw string literals, R\"d(...)d\", which need no escaping, with ordinary string "
+     "literals only for the bytes which they cannot hold", NULL, false, rawStart, rawWrite, rawEnd, NULL, false, false,
+     false, "const char", "%s", literalResource},
+    {"table", "a C const array of structs, name, one for each row of CSV or TSV input, whose header row (or -k) gives the "
+     "columns, with the row count, name_count, and an accessor, name_column(row), for each column", NULL, false,
+     NULL, tableWrite, tableEnd},
+    {"cbor", "a C const unsigned char array, name, holding the JSON input checked and converted to deterministic CBOR, "
+     "with its length, name_len, and C functions to read it", NULL, true, NULL, holdWrite, cborEnd, NULL, false, false,
+     false, NULL, NULL, cborResource},
+    {"cbor_keys", "as cbor but with the keys of objects written as their index into an array of them, name_keys, with a "
+     "macro, name_key_key, for the index of each", NULL, true, NULL, holdWrite, cborKeysEnd, NULL, false, false, false,
+     NULL, NULL, cborResource},
+    {"tokens", "C macros, name_identifier, of a token, the CRC-32, for each of the log strings of the input, one on each "
+     "line, optionally after an identifier and a tab, for firmware to log in place of the strings", NULL, false,
+     NULL, holdWrite, tokensEnd},
+    {"tokens_db", "for the host, the log strings of the input, as for tokens, as a C array, name, of their tokens, "
+     "sorted, and the strings, name_strings, with their number, name_count, and name_find(token) to look one up",
+     NULL, false, NULL, holdWrite, tokensDbEnd},
+    {"web", "a C const unsigned char array, name, holding the input gzip compressed for HTTP, described by a "
+     "const ArrayifyWebAsset, name_asset, of its path, Content-Type, ETag, data, length and Content-Encoding",
+     NULL, true, NULL, holdWrite, webEnd},
+    {"web_deflate", "as web but compressed as HTTP deflate, i.e. zlib", NULL, true, NULL, holdWrite, webDeflateEnd},
+    {"web_index", "a C array, name, of pointers to the assets of the web formats listed in the input, one file name on "
+     "each line, sorted by path, with their number, name_count, and name_find(pPath, length) to look one up",
+     NULL, false, NULL, holdWrite, webIndexEnd},
+    {"bin", "the input copied as it is, e.g. for a partition image", NULL, true, NULL, binWrite, NULL, NULL, true, true},
+    {"stats", "a JSON report of the name, length and, where calculated, CRC and SHA-256 of the input", NULL, true,
+     NULL, statsWrite, statsEnd, NULL, true, true}
+};
+
+// Find a format by name, returning NULL if there is no such format
+static const Format *findFormat(const char *pName)
+{
+    const Format *pFormat = NULL;
+
+    for (size_t x = 0; (x < sizeof(formats) / sizeof(formats[0])) && (pFormat == NULL); x++) {
+        if (strcmp(formats[x].pName, pName) == 0) {
+            pFormat = &(formats[x]);
+        }
+    }
+
+    return pFormat;
+}
+
+// Return the length of the start of the first line of a string
+// literal format, not including the opening quote
+static int prefixLength(const Format *pFormat, const char *pName)
+{
+    return strlen(pFormat->pPrefix) - 2 + strlen(pName);
+}
+
+// The fields which may appear in a template, anything else in
+// braces being copied as it is
+static const struct {
+    const char *pField;
+    StepType type;
+} templateFields[] = {
+    {"{name}", STEP_NAME},
+    {"{input}", STEP_INPUT},
+    {"{exe}", STEP_EXE},
+    {"{len}", STEP_LEN},
+    {"{crc}", STEP_CRC},
+    {"{sha256}", STEP_SHA256},
+    {"{offset}", STEP_OFFSET}
+};
+
+// Compile the template text from pStart to pEnd into steps,
+// returning the number of steps written to pSteps
+static int compileTemplate(const char *pStart, const char *pEnd, Step *pSteps)
+{
+    Step *pStep = pSteps;
+    const char *pText = pStart;
+    const char *pIn = pStart;
+    int field;
+    int length = 0;
+
+    while (pIn < pEnd) {
+        field = -1;
+        if (*pIn == '{') {
+            for (int x = 0; (x < (int) (sizeof(templateFields) / sizeof(templateFields[0]))) && (field < 0); x++) {
+                length = strlen(templateFields[x].pField);
+                if ((pEnd - pIn >= length) && (memcmp(pIn, templateFields[x].pField, length) == 0)) {
+                    field = x;
+                }
+            }
+        }
+        if (field >= 0) {
+            // Finish any text before the field and add the field
+            if (pIn > pText) {
+                pStep->type = STEP_TEXT;
+                pStep->pText = pText;
+                pStep->length = pIn - pText;
+                pStep++;
+            }
+            pStep->type = templateFields[field].type;
+            pStep++;
+            pIn += length;
+            pText = pIn;
+        } else {
+            pIn++;
+        }
+    }
+    if (pIn > pText) {
+        pStep->type = STEP_TEXT;
+        pStep->pText = pText;
+        pStep->length = pIn - pText;
+        pStep++;
+    }
+
+    return pStep - pSteps;
+}
+
+// Read a template file and compile it into a plan, returning
+// false if that cannot be done
+static bool readTemplate(const char *pFileName, Template *pTemplate)
+{
+    bool success = false;
+    FILE *pFile;
+    long long size = -1;
+    int braces = 0;
+    char *pData;
+    char *pLineStart;
+    char *pLineEnd;
+    char *pTail;
+    char *pEnd;
+
+    memset(pTemplate, 0, sizeof(*pTemplate));
+    pFile = fopen(pFileName, "r");
+    if (pFile != NULL) {
+        if (fseeko(pFile, 0, SEEK_END) == 0) {
+            size = ftello(pFile);
+            rewind(pFile);
+        }
+        if (size >= 0) {
+            pTemplate->pBuffer = (char *) malloc (size + 1); // +1 for terminator
+        }
+        if (pTemplate->pBuffer != NULL) {
+            // In text mode fewer characters than the file size may be read
+            pEnd = pTemplate->pBuffer + fread(pTemplate->pBuffer, 1, size, pFile);
+            *pEnd = 0;
+            pData = strstr(pTemplate->pBuffer, "{data}");
+            if (pData != NULL) {
+                // Find the line which holds {data}
+                pLineStart = pData;
+                while ((pLineStart > pTemplate->pBuffer) && (*(pLineStart - 1) != '\n')) {
+                    pLineStart--;
+                }
+                pLineEnd = strchr(pData, '\n');
+                if (pLineEnd != NULL) {
+                    pTail = pLineEnd + 1;
+                } else {
+                    pLineEnd = pEnd;
+                    pTail = pEnd;
+                }
+                // Each field is one step and may be preceded by one text step
+                for (char *pTmp = pTemplate->pBuffer; pTmp < pEnd; pTmp++) {
+                    if (*pTmp == '{') {
+                        braces++;
+                    }
+                }
+                pTemplate->pSteps = (Step *) malloc ((braces * 2 + NUM_TEMPLATE_SECTIONS) * sizeof(Step));
+                if (pTemplate->pSteps != NULL) {
+                    pTemplate->start[TEMPLATE_HEAD] = 0;
+                    pTemplate->start[TEMPLATE_LINE_PREFIX] = compileTemplate(pTemplate->pBuffer, pLineStart, pTemplate->pSteps);
+                    pTemplate->start[TEMPLATE_LINE_SUFFIX] = pTemplate->start[TEMPLATE_LINE_PREFIX] +
+                                                             compileTemplate(pLineStart, pData,
+                                                                             pTemplate->pSteps + pTemplate->start[TEMPLATE_LINE_PREFIX]);
+                    pTemplate->start[TEMPLATE_TAIL] = pTemplate->start[TEMPLATE_LINE_SUFFIX] +
+                                                      compileTemplate(pData + 6, pLineEnd,
+                                                                      pTemplate->pSteps + pTemplate->start[TEMPLATE_LINE_SUFFIX]);
+                    pTemplate->start[NUM_TEMPLATE_SECTIONS] = pTemplate->start[TEMPLATE_TAIL] +
+                                                              compileTemplate(pTail, pEnd,
+                                                                              pTemplate->pSteps + pTemplate->start[TEMPLATE_TAIL]);
+                    // Note what has to be worked out while the input is read
+                    for (int x = 0; x < pTemplate->start[NUM_TEMPLATE_SECTIONS]; x++) {
+                        if (pTemplate->pSteps[x].type == STEP_CRC) {
+                            pTemplate->crc = true;
+                        }
+                        if (pTemplate->pSteps[x].type == STEP_SHA256) {
+                            pTemplate->sha256 = true;
+                        }
+                        if ((x < pTemplate->start[TEMPLATE_LINE_PREFIX]) &&
+                            ((pTemplate->pSteps[x].type == STEP_LEN) || (pTemplate->pSteps[x].type == STEP_CRC) ||
+                             (pTemplate->pSteps[x].type == STEP_SHA256))) {
+                            pTemplate->late = true;
+                        }
+                    }
+                    success = true;
+                } else {
+                    printf("Cannot allocate memory for template.\n");
+                }
+            } else {
+                printf("Template file %s does not contain {data}.\n", pFileName);
+            }
+        } else {
+            printf("Cannot read template file %s.\n", pFileName);
+        }
+        fclose(pFile);
+    } else {
+        printf("Cannot open template file %s (%s).\n", pFileName, strerror(errno));
+    }
+
+    return success;
+}
+
+// Free the memory used by a template
+static void freeTemplate(Template *pTemplate)
+{
+    free(pTemplate->pSteps);
+    free(pTemplate->pBuffer);
+}
+
+// Print the usage text
+static void printUsage(char *pExeName) {
+    printf("\n%s: take a text file and create from it a C const char array which can be compiled into code. Usage:\n", pExeName);
+    printf("    %s input_file <-n name> <-l line_length> <-o output_file<:format>> <-f format> <-e endianness> <-d> <-c crc_type> <-s> <-t template_file> <-b> <-p progress_style> <-i io_policy> <-a> <-x> <-r> <-k schema> <--check> <--dry-run> <--estimate> <--restat> <--depfile file> <-g group_size>\n", pExeName);
+    printf("where:\n");
+    printf("    input_file is the input text file or, as @list_file, a file listing input files, one per line, each\n");
+    printf("       optionally followed by a tab and the name for its array, each of which is arrayified with the rest\n");
+    printf("       of the command line; with -g size (in bytes, or followed by k or M) the arrays are amalgamated into\n");
+    printf("       the output file, a new part, with _1, _2 and so on before its extension, being started once a part\n");
+    printf("       is of that size, and an index of them named by -n is added, declared with name_find(pName) in a\n");
+    printf("       header, the output file with extension .h; -g is only for the c, raw, u32 and u64 formats,\n");
+    printf("    -n optionally specifies the name for the array (if not specified input_file, without file extension, will be used),\n");
+    printf("    -l optionally specifies the length of each line in the output file (%d by default),\n", LINE_LENGTH);
+    printf("    -o optionally specifies the output file (if not specified the output file is input_file with extension %s%s);\n", EXT_SEPARATOR, OUTPUT_FILE_EXTENSION);
+    printf("       if the output file exists it will be overwritten; -o may be given up to %d times, each output file optionally\n", MAX_OUTPUTS);
+    printf("       followed by :format to override -f, e.g. -o a.array:c -o a.bin:bin, the input being read only once for all,\n");
+    printf("    -f optionally specifies the output format (%s by default), one of:\n", formats[0].pName);
+    for (size_t x = 0; x < sizeof(formats) / sizeof(formats[0]); x++) {
+        printf("       %s: %s%s\n", formats[x].pName, formats[x].pDescription, formats[x].binary ? " (input read as binary)" : "");
+    }
+    printf("    -e optionally specifies the endianness of the target for the u32 and u64 formats, big or little (little by default),\n");
+    printf("    -d for the base64 and z85 formats, also emit a C function to decode the array on the target,\n");
+    printf("    -c optionally calculates a CRC of the input, crc32 (IEEE 802.3, as used by zip) or crc32c (Castagnoli), which is\n");
+    printf("       written as name_crc, along with a C function to check it on the target, a slice at a time if required,\n");
+    printf("    -s calculates the SHA-256 of the input, which is written as the byte array name_sha256 and, in hex, as a quoted\n");
+    printf("       HTTP ETag string, name_etag,\n");
+    printf("    -t optionally specifies a template file giving the layout of the output file, in which {data} marks the line where\n");
+    printf("       the array goes, the text before and after {data} on that line being added to the start and end of every\n");
+    printf("       line of the array; {name}, {input}, {exe}, {len} (of the input), {crc} (of the input, CRC-32 unless -c is given),\n");
+    printf("       {sha256} (of the input, in hex) and, on the {data} line, {offset} (into the array) are replaced with their\n");
+    printf("       values; -b is ignored if -t is given,\n");
+    printf("    -b bare; if this command-line switch is specified no topping/tailing comment lines will be added to the output,\n");
+    printf("    -p optionally reports progress on stderr, once a second, with the rate and the time to go: bar, on one\n");
+    printf("       line which is rewritten, or log, a line of name=value pairs each time, e.g. for CI logs,\n");
+    printf("    -i optionally specifies how the input and outputs use the page cache, where the operating system allows: normal\n");
+    printf("       (the default), stream, which reads ahead and drops what has been read or written from the cache, so as not\n");
+    printf("       to evict everything else, or direct, as stream but reading the input with O_DIRECT, bypassing the cache,\n");
+    printf("    -a appends: the state of each output is kept in a sidecar file, the output file name with %s%s added,\n",
+           EXT_SEPARATOR, APPEND_STATE_EXTENSION);
+    printf("       and if the input has only been added to since the last run with -a just what has been added is encoded,\n");
+    printf("       the end of each output file being rewritten; for the c, string_view, bin and stats formats,\n");
+    printf("    -x for the u32, u64 and adaptive formats, in a host build, i.e. with %s defined, has the array\n", HOST_MACRO);
+    printf("       mapped from the input file, from its full path or from the directory given by %s,\n",
+           HOST_DIR_VARIABLE);
+    printf("       by name_host_load(), called when the program starts with GCC or Clang, rather than compiled in,\n");
+    printf("    -r also gives the array as a const ArrayifyResource, name_resource, the same for every format that has\n");
+    printf("       one, to be read with arrayify_open(), arrayify_read(), arrayify_size() and arrayify_ptr_if_direct(),\n");
+    printf("    -k optionally gives the columns of the table format, e.g. \"channel:u16,gain:f32,label:char8\", each a\n");
+    printf("       name:type, type being i8, u8, i16, u16, i32, u32, i64, u64, f32, f64 or charN (N including the\n");
+    printf("       terminator), in place of those in the header row of the input, which is then skipped,\n");
+    printf("    --check writes nothing but says whether each output file is up to date, from its first line, which\n");
+    printf("       gives the size, modification time and CRC-32C of the input and a CRC-32C of the options which it was\n");
+    printf("       written from, exiting with 1 if any is not; the input is only read if just its time has changed,\n");
+    printf("    --dry-run writes nothing but prints the exact size in bytes and lines of each output file and the order-0\n");
+    printf("       entropy of the input, an estimate of the least it could be compressed to,\n");
+    printf("    --estimate is as --dry-run but, for large inputs, samples %d blocks of %d bytes spread over the input,\n",
+           ESTIMATE_SAMPLES, INPUT_BUFFER_SIZE);
+    printf("       giving each size with a bound on its error (three standard errors),\n");
+    printf("    --restat leaves the output files as they are if, as --check would say, they are all up to date,\n");
+    printf("    --depfile writes a depfile, as Make and Ninja read, of the input and template file for the outputs,\n");
+    printf("    --ninja manifest_file <-o ninja_file> <-n name>, in place of everything else, writes a Ninja file to run\n");
+    printf("       %s on each input listed in the manifest, with the options given for the globs that it matches.\n", pExeName);
+    printf("For example:\n");
+    printf("    %s input.txt -n fred -l 120 -o output.blah -b\n", pExeName);
+    printf("    %s @assets.list -g 4M -n assets -o assets.c\n\n", pExeName);
+}
+
+// Code to check arrays against their CRCs on the target, emitted with them;
+// the CRC function is completed with the name and polynomial of each CRC type
+static const char crcFunction[] =
+    "\n#ifndef ARRAYIFY_%s\n"
+    "#define ARRAYIFY_%s\n"
+    "#include <stddef.h>\n"
+    "/* Update a %s with size bytes at pData: start with 0 and pass the data in\n"
+    "   as many pieces as is convenient; bitwise, to keep it small */\n"
+    "static ARRAYIFY_UNUSED unsigned long %s(unsigned long crc, const void *pData, size_t size)\n"
+    "{\n"
+    "    const unsigned char *pByte = (const unsigned char *) pData;\n"
+    "    int x;\n"
+    "\n"
+    "    crc = ~crc & 0xffffffffUL;\n"
+    "    for (; size > 0; size--, pByte++) {\n"
+    "        crc ^= *pByte;\n"
+    "        for (x = 0; x < 8; x++) {\n"
+    "            crc = (crc >> 1) ^ (0x%08lxUL & (0UL - (crc & 1)));\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    return ~crc & 0xffffffffUL;\n"
+    "}\n"
+    "#endif\n";
+static const char crcCheck[] =
+    "\n#ifndef ARRAYIFY_CRC_CHECK\n"
+    "#define ARRAYIFY_CRC_CHECK\n"
+    "/* The state of a check of data against its CRC, made a slice at a time */\n"
+    "typedef struct {\n"
+    "    const unsigned char *pData;\n"
+    "    size_t size;\n"
+    "    size_t offset;\n"
+    "    unsigned long crc;\n"
+    "    unsigned long expected;\n"
+    "    unsigned long (*pUpdate)(unsigned long, const void *, size_t);\n"
+    "} ArrayifyCrcCheck;\n"
+    "\n"
+    "/* Start a check of size bytes at pData against the CRC expected, as calculated by pUpdate */\n"
+    "static ARRAYIFY_UNUSED void arrayifyCrcCheckStart(ArrayifyCrcCheck *pCheck, const void *pData, size_t size,\n"
+    "                                                  unsigned long expected,\n"
+    "                                                  unsigned long (*pUpdate)(unsigned long, const void *, size_t))\n"
+    "{\n"
+    "    pCheck->pData = (const unsigned char *) pData;\n"
+    "    pCheck->size = size;\n"
+    "    pCheck->offset = 0;\n"
+    "    pCheck->crc = 0;\n"
+    "    pCheck->expected = expected;\n"
+    "    pCheck->pUpdate = pUpdate;\n"
+    "}\n"
+    "\n"
+    "/* Check up to slice more bytes, e.g. from a background task, returning 0 if\n"
+    "   there is more to do, 1 if the check is complete and passed or -1 if it failed */\n"
+    "static ARRAYIFY_UNUSED int arrayifyCrcCheckSlice(ArrayifyCrcCheck *pCheck, size_t slice)\n"
+    "{\n"
+    "    if (slice > pCheck->size - pCheck->offset) {\n"
+    "        slice = pCheck->size - pCheck->offset;\n"
+    "    }\n"
+    "    pCheck->crc = pCheck->pUpdate(pCheck->crc, pCheck->pData + pCheck->offset, slice);\n"
+    "    pCheck->offset += slice;\n"
+    "    if (pCheck->offset < pCheck->size) {\n"
+    "        return 0;\n"
+    "    }\n"
+    "\n"
+    "    return (pCheck->crc == pCheck->expected) ? 1 : -1;\n"
+    "}\n"
+    "#endif\n";
+
+// Code for a host build to map the input of a -x output rather than have
+// it compiled in, emitted with each
+static const char hostLoad[] =
+    "#ifndef ARRAYIFY_HOST_LOAD\n"
+    "#define ARRAYIFY_HOST_LOAD\n"
+    "#include <stddef.h>\n"
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#if defined(__unix__) || defined(__APPLE__)\n"
+    "# include <fcntl.h>\n"
+    "# include <unistd.h>\n"
+    "# include <sys/mman.h>\n"
+    "# include <sys/stat.h>\n"
+    "#endif\n"
+    "/* Map the file at pPath or, if the environment variable " HOST_DIR_VARIABLE " is\n"
+    "   set, the file pFile in that directory, returning where it is and setting\n"
+    "   *pSize to its length: its pages are only read when they are first touched;\n"
+    "   where there is no mmap() the file is read into a buffer which grows to fit\n"
+    "   it; an asset which cannot be read is fatal */\n"
+    "static const void *arrayifyHostLoad(const char *pPath, const char *pFile, size_t *pSize)\n"
+    "{\n"
+    "    char path[4096];\n"
+    "    const char *pDir = getenv(\"" HOST_DIR_VARIABLE "\");\n"
+    "    const void *pData = NULL;\n"
+    "#if defined(__unix__) || defined(__APPLE__)\n"
+    "    static const uint64_t empty = 0;\n"
+    "    struct stat st;\n"
+    "    int fd;\n"
+    "#else\n"
+    "    FILE *pStream;\n"
+    "    unsigned char *pBuffer = NULL;\n"
+    "    unsigned char *pNew;\n"
+    "    size_t length = 0;\n"
+    "#endif\n"
+    "\n"
+    "    if ((pDir != NULL) && (strlen(pDir) + strlen(pFile) + 2 <= sizeof(path))) {\n"
+    "        sprintf(path, \"%s/%s\", pDir, pFile);\n"
+    "        pPath = path;\n"
+    "    }\n"
+    "#if defined(__unix__) || defined(__APPLE__)\n"
+    "    fd = open(pPath, O_RDONLY);\n"
+    "    if ((fd >= 0) && (fstat(fd, &st) == 0)) {\n"
+    "        *pSize = (size_t) st.st_size;\n"
+    "        /* An empty file cannot be mapped */\n"
+    "        pData = (*pSize > 0) ? mmap(NULL, *pSize, PROT_READ, MAP_PRIVATE, fd, 0) : (const void *) &empty;\n"
+    "        if (pData == MAP_FAILED) {\n"
+    "            pData = NULL;\n"
+    "        }\n"
+    "    }\n"
+    "    if (fd >= 0) {\n"
+    "        close(fd);\n"
+    "    }\n"
+    "#else\n"
+    "    pStream = fopen(pPath, \"rb\");\n"
+    "    if (pStream != NULL) {\n"
+    "        for (size_t room = 65536; pData == NULL; room *= 2) {\n"
+    "            pNew = (unsigned char *) realloc(pBuffer, room);\n"
+    "            if (pNew == NULL) {\n"
+    "                break;\n"
+    "            }\n"
+    "            pBuffer = pNew;\n"
+    "            length += fread(pBuffer + length, 1, room - length, pStream);\n"
+    "            if (ferror(pStream)) {\n"
+    "                break;\n"
+    "            }\n"
+    "            if (length < room) {\n"
+    "                *pSize = length;\n"
+    "                pData = pBuffer;\n"
+    "            }\n"
+    "        }\n"
+    "        if (pData == NULL) {\n"
+    "            free(pBuffer);\n"
+    "        }\n"
+    "        fclose(pStream);\n"
+    "    }\n"
+    "#endif\n"
+    "    if (pData == NULL) {\n"
+    "        fprintf(stderr, \"Cannot read asset %s.\\n\", pPath);\n"
+    "        abort();\n"
+    "    }\n"
+    "\n"
+    "    return pData;\n"
+    "}\n"
+    "#endif\n";
+
+// Start a -x output: what the format writes is only for builds other
+// than the host build
+static void hostStart(Output *pOutput)
+{
+    fprintf(pOutput->pFile, "#ifndef %s\n", HOST_MACRO);
+}
+
+// Finish a -x output with, for the host build, the same name, name_len
+// and, for the words formats, name_words as the format gives, though not
+// const, set by name_host_load() to the input mapped into memory, so that
+// an edit to the input needs no rebuild; GCC and Clang call it when the
+// program starts, a program built with another compiler must call it
+static void hostEnd(Output *pOutput)
+{
+    const char *pFile = pOutput->pHostPath;
+
+    // The file name alone, for HOST_DIR_VARIABLE
+    for (const char *pTmp = pOutput->pHostPath; *pTmp != 0; pTmp++) {
+        if (strchr(DIR_SEPARATORS, *pTmp) != NULL) {
+            pFile = pTmp + 1;
+        }
+    }
+    fprintf(pOutput->pFile, "#else\n%s\n", hostLoad);
+    fprintf(pOutput->pFile, "/* %s, mapped from the input by %s_host_load(), and its length */\n",
+            pOutput->pName, pOutput->pName);
+    if (pOutput->wordSize > 0) {
+        fprintf(pOutput->pFile, "const uint%d_t *%s_words;\n", pOutput->wordSize * 8, pOutput->pName);
+        fprintf(pOutput->pFile, "const uint8_t *%s;\n", pOutput->pName);
+    } else {
+        fprintf(pOutput->pFile, "const unsigned char *%s;\n", pOutput->pName);
+    }
+    fprintf(pOutput->pFile, "size_t %s_len;\n\n", pOutput->pName);
+    fprintf(pOutput->pFile, "/* Map %s from the input, before it is used */\n", pOutput->pName);
+    fprintf(pOutput->pFile, "void %s_host_load(void)\n{\n", pOutput->pName);
+    fprintf(pOutput->pFile, "    %s = (const %s *) arrayifyHostLoad(\"", pOutput->pName,
+            (pOutput->wordSize > 0) ? "uint8_t" : "unsigned char");
+    writeQuoted(pOutput->pFile, pOutput->pHostPath, strlen(pOutput->pHostPath));
+    fprintf(pOutput->pFile, "\", \"");
+    writeQuoted(pOutput->pFile, pFile, strlen(pFile));
+    fprintf(pOutput->pFile, "\", &%s_len);\n", pOutput->pName);
+    if (pOutput->wordSize > 0) {
+        fprintf(pOutput->pFile, "    %s_words = (const uint%d_t *) (const void *) %s;\n", pOutput->pName,
+                pOutput->wordSize * 8, pOutput->pName);
+    }
+    fprintf(pOutput->pFile, "}\n\n");
+    fprintf(pOutput->pFile, "/* With another compiler the program must call %s_host_load() itself */\n", pOutput->pName);
+    fprintf(pOutput->pFile, "#if defined(__GNUC__)\n");
+    fprintf(pOutput->pFile, "static void %s_host(void) __attribute__((constructor));\n", pOutput->pName);
+    fprintf(pOutput->pFile, "static void %s_host(void)\n{\n    %s_host_load();\n}\n", pOutput->pName, pOutput->pName);
+    fprintf(pOutput->pFile, "#endif\n");
+    fprintf(pOutput->pFile, "#endif\n");
+}
+
+// Write the CRC of the input, with the code to check it on the target
+static void writeCrc(Output *pOutput)
+{
+    const Input *pInput = pOutput->pInput;
+    char guard[32];
+    int x;
+
+    // The include guard is the function name in upper case
+    for (x = 0; (crcTypes[pInput->crcType].pName[x] != 0) && (x < (int) sizeof(guard) - 1); x++) {
+        guard[x] = (char) toupper(crcTypes[pInput->crcType].pName[x]);
+    }
+    guard[x] = 0;
+    fprintf(pOutput->pFile, "%s", unusedMarker);
+    fprintf(pOutput->pFile, crcFunction, guard, guard, crcTypes[pInput->crcType].pName,
+            crcTypes[pInput->crcType].pFunction, (unsigned long) crcTypes[pInput->crcType].polynomial);
+    fprintf(pOutput->pFile, "%s", crcCheck);
+    fprintf(pOutput->pFile, "\n/* The %s of the %lld bytes of input, check with %s() */\n",
+            crcTypes[pInput->crcType].pName, pInput->length, crcTypes[pInput->crcType].pFunction);
+    fprintf(pOutput->pFile, "const unsigned long %s_crc = 0x%08lxUL;\n", pOutput->pName, (unsigned long) pInput->crc);
+}
+
+// Write the SHA-256 of the input, as bytes and as an HTTP ETag
+static void writeDigest(Output *pOutput)
+{
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_DIGEST_SIZE * 2 + 1];
+
+    inputDigest(pOutput->pInput, digest, hex);
+    fprintf(pOutput->pFile, "\n/* The SHA-256 of the %lld bytes of input */\n", pOutput->pInput->length);
+    fprintf(pOutput->pFile, "const unsigned char %s_sha256[%d] = {\n", pOutput->pName, SHA256_DIGEST_SIZE);
+    for (int x = 0; x < SHA256_DIGEST_SIZE; x++) {
+        fprintf(pOutput->pFile, "%s0x%02x,%s", (x % 8 == 0) ? ELEMENT_INDENT : "", digest[x], (x % 8 == 7) ? "\n" : " ");
+    }
+    fprintf(pOutput->pFile, "};\n");
+    fprintf(pOutput->pFile, "/* The same as a strong HTTP ETag, quotes included */\n");
+    fprintf(pOutput->pFile, "const char %s_etag[] = \"\\\"%s\\\"\";\n", pOutput->pName, hex);
+}
+
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+// Count what is written to a counter stream
+static ssize_t counterWrite(void *pCookie, const char *pBuffer, size_t size)
+{
+    (void) pBuffer;
+    *((long long *) pCookie) += size;
+
+    return size;
+}
+#endif
+
+// Open a stream which counts what is written to it rather than
+// writing it anywhere, for a dry run; where the C library cannot
+// provide one a temporary file is used instead
+static FILE *counterOpen(long long *pCount)
+{
+    *pCount = 0;
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+    cookie_io_functions_t functions = {NULL, counterWrite, NULL, NULL};
+
+    return fopencookie(pCount, "w", functions);
+#else
+    return tmpfile();
+#endif
+}
+
+// Return the number of bytes written to a counter stream so far
+static long long counterSize(FILE *pFile, long long *pCount)
+{
+    fflush(pFile);
+#if !defined(__GLIBC__) || !defined(_GNU_SOURCE)
+    *pCount = ftello(pFile);
+#endif
+
+    return *pCount;
+}
+
+// Find whether there is a hole at offset in a sparse input file,
+// returning its size, zero if there is data at offset, and setting
+// *pDataEnd to the offset of the next hole after that; where holes
+// cannot be found the whole file is treated as data
+static long long findHole(FILE *pFile, long long offset, long long *pDataEnd)
+{
+    long long holeSize = 0;
+
+    *pDataEnd = LLONG_MAX;
+#ifdef SEEK_HOLE
+    int fd = fileno(pFile);
+    off_t data = lseek(fd, offset, SEEK_DATA);
+    off_t end;
+
+    if (data >= 0) {
+        holeSize = data - offset;
+        end = lseek(fd, data, SEEK_HOLE);
+        if (end >= 0) {
+            *pDataEnd = end;
+        }
+    } else if (errno == ENXIO) {
+        // No more data: the rest of the file is a hole
+        end = lseek(fd, 0, SEEK_END);
+        if (end > offset) {
+            holeSize = end - offset;
+            *pDataEnd = end;
+        }
+    }
+#endif
+
+    return holeSize;
+}
+
+// Make the options which shape an output, for -a and --check to compare
+// with those it was written with: any change means writing it in full
+static void sinkOptions(Sink *pSink, const char *pName, const char *pInputFileName, const char *pExeName,
+                        bool bare, const Template *pTemplate, CrcType crcType, bool digest,
+                        bool bigEndian, bool decoder, bool host, const char *pSchema, bool resource)
+{
+    uint32_t templateCrc = 0;
+
+    if (pTemplate != NULL) {
+        templateCrc = crcUpdate(CRC_TYPE_CRC32, 0, pTemplate->pBuffer, strlen(pTemplate->pBuffer));
+    }
+    sprintf(pSink->options, "format=%.32s name=%.160s input=%.256s exe=%.64s line_length=%d bare=%d "
+            "template=0x%08lx crc=%s sha256=%d big_endian=%d decoder=%d host=%d schema=%.256s resource=%d",
+            pSink->pFormat->pName, pName, pInputFileName, pExeName, pSink->output.lineLength, bare,
+            (unsigned long) templateCrc, crcTypes[crcType].pName, digest, bigEndian, decoder, host,
+            (pSchema != NULL) ? pSchema : "-", resource);
+}
+
+// Write the header of an output: where it came from and, at the end of
+// the line, what --check needs to tell whether it is up to date; this is
+// of a fixed length so that it can be filled in once the input has been
+// read, until which it is left blank, which --check will never accept
+static void writeHeader(Sink *pSink, bool blank)
+{
+    Output *pOutput = &pSink->output;
+    const Input *pInput = pOutput->pInput;
+    char check[sizeof(CHECK_FORMAT) + 64];
+    int length;
+
+    // A racy time is written as 0, so that --check always compares the CRC
+    length = sprintf(check, CHECK_FORMAT, (unsigned long long) pInput->fileSize,
+                     pInput->racyTime ? 0 : (unsigned long long) pInput->fileTime,
+                     (unsigned long) pInput->checkCrc,
+                     (unsigned long) crcUpdate(CRC_TYPE_CRC32C, 0, pSink->options, strlen(pSink->options)));
+    if (blank) {
+        memset(check + 1, '-', length - 2);
+    }
+    fprintf(pOutput->pFile, "/* This file was created from input file %s by %s %s */\n\n",
+            pOutput->pInputFileName, pOutput->pExeFileName, check);
+}
+
+// Check whether an output is up to date, for --check, from its first line
+// alone: it is if the input has the same size and modification time as
+// when the output was written, from the same options; if just the time is
+// different the input is read to see if its CRC-32C is the same, e.g. if
+// it has only been touched, as it is if the time was racy, written as 0.
+// Returns NULL if the output is up to date, else the reason that it is not.
+static const char *checkOutput(Sink *pSink, FILE *pInputFile, Input *pInput)
+{
+    const char *pReason = NULL;
+    FILE *pFile = fopen(pSink->pFileName, "r");
+    char line[CHECK_LINE_LENGTH];
+    char *pCheck = NULL;
+    char *pNext;
+    unsigned long long size;
+    unsigned long long mtime;
+    unsigned long crc;
+    unsigned long options;
+    char buffer[INPUT_BUFFER_SIZE];
+    size_t bytesRead;
+
+    if ((pFile == NULL) || (fgets(line, sizeof(line), pFile) == NULL)) {
+        pReason = "it cannot be read";
+    } else {
+        // The last [ on the line starts what is needed
+        for (pNext = strchr(line, '['); pNext != NULL; pNext = strchr(pNext + 1, '[')) {
+            pCheck = pNext;
+        }
+        if ((pCheck == NULL) || (sscanf(pCheck, CHECK_SCAN_FORMAT, &size, &mtime, &crc, &options) != 4)) {
+            pReason = "it has no header saying what it was written from";
+        } else if (options != crcUpdate(CRC_TYPE_CRC32C, 0, pSink->options, strlen(pSink->options))) {
+            pReason = "it was written with different options";
+        } else if (size != (unsigned long long) pInput->fileSize) {
+            pReason = "the input file is a different size";
+        } else if (mtime != (unsigned long long) pInput->fileTime) {
+            // Read the input, once for all outputs, to compare its CRC-32C
+            while (!feof(pInputFile) && !ferror(pInputFile)) {
+                bytesRead = fread(buffer, 1, sizeof(buffer), pInputFile);
+                inputRead(pInput, buffer, (int) bytesRead);
+            }
+            if (ferror(pInputFile) || (crc != pInput->checkCrc)) {
+                pReason = "the input file has changed";
+            }
+        }
+    }
+    if (pFile != NULL) {
+        fclose(pFile);
+    }
+
+    return pReason;
+}
+
+// Write a file name to a depfile, escaped as Make, and Ninja, read it
+static void depfileWritePath(FILE *pFile, const char *pPath)
+{
+    for (; *pPath != 0; pPath++) {
+        if ((*pPath == ' ') || (*pPath == '#')) {
+            fputc('\\', pFile);
+        } else if (*pPath == '$') {
+            fputc('$', pFile);
+        }
+        fputc(*pPath, pFile);
+    }
+}
+
+// Write a depfile for --depfile, saying that the outputs depend on the
+// input and on the template, if there is one, returning true on success
+static bool writeDepfile(const char *pFileName, const Sink *pSinks, int sinkCount,
+                         const char *pInputFileName, const char *pTemplateFileName)
+{
+    FILE *pFile = fopen(pFileName, "w");
+    bool success = (pFile != NULL);
+
+    if (success) {
+        for (int x = 0; x < sinkCount; x++) {
+            if (x > 0) {
+                fputc(' ', pFile);
+            }
+            depfileWritePath(pFile, pSinks[x].pFileName);
+        }
+        fprintf(pFile, ": ");
+        depfileWritePath(pFile, pInputFileName);
+        if (pTemplateFileName != NULL) {
+            fputc(' ', pFile);
+            depfileWritePath(pFile, pTemplateFileName);
+        }
+        fputc('\n', pFile);
+        success = !ferror(pFile);
+        success = (fclose(pFile) == 0) && success;
+    }
+
+    return success;
+}
+
+// Open the sidecar file in which -a keeps the state of an output
+static FILE *appendOpen(const Sink *pSink, const char *pMode)
+{
+    char *pFileName = (char *) malloc (strlen(pSink->pFileName) + sizeof(EXT_SEPARATOR) - 1 + sizeof(APPEND_STATE_EXTENSION));
+    FILE *pFile = NULL;
+
+    if (pFileName != NULL) {
+        strcpy(pFileName, pSink->pFileName);
+        strcat(pFileName, EXT_SEPARATOR);
+        strcat(pFileName, APPEND_STATE_EXTENSION);
+        pFile = fopen(pFileName, pMode);
+        free(pFileName);
+    }
+
+    return pFile;
+}
+
+// Read the state of an output where the last run left off from its
+// sidecar file, returning true if there is one and it is complete
+static bool appendLoad(Sink *pSink)
+{
+    AppendState *pState = &pSink->state;
+    FILE *pFile = appendOpen(pSink, "r");
+    int version = 0;
+    unsigned long inputCrc = 0;
+    int lineOpen = 0;
+    int firstLine = 0;
+    unsigned int byte;
+    char *pEnd;
+    bool success = false;
+
+    if (pFile != NULL) {
+        success = (fscanf(pFile, "arrayify-append %d options ", &version) == 1) && (version == 1) &&
+                  (fgets(pState->options, sizeof(pState->options), pFile) != NULL) &&
+                  (fscanf(pFile, " input_length %lld input_crc32c %lx output_offset %lld output_size %lld"
+                          " position %lld line_offset %lld written_offset %lld line_open %d first_line %d line %d",
+                          &pState->inputLength, &inputCrc, &pState->outputOffset, &pState->outputSize,
+                          &pState->position, &pState->lineOffset, &pState->writtenOffset, &lineOpen, &firstLine,
+                          &pState->lineFill) == 10) &&
+                  (pState->lineFill >= 0) && (pState->lineFill <= pSink->output.lineLength + ELEMENT_MAX_LENGTH);
+        if (success) {
+            pEnd = strchr(pState->options, '\n');
+            if (pEnd != NULL) {
+                *pEnd = 0;
+            }
+            pState->inputCrc = (uint32_t) inputCrc;
+            pState->lineOpen = (lineOpen != 0);
+            pState->firstLine = (firstLine != 0);
+            free(pState->pLine);
+            pState->pLine = (char *) malloc (pState->lineFill + 1);
+            success = (pState->pLine != NULL);
+        }
+        // The line is in hex since it may hold any character
+        for (int x = 0; success && (x < pState->lineFill); x++) {
+            success = (fscanf(pFile, "%2x", &byte) == 1);
+            pState->pLine[x] = (char) byte;
+        }
+        fclose(pFile);
+    }
+
+    return success;
+}
+
+// Write the state of an output where this run left off to its sidecar
+// file, for the next run with -a, returning true if it was written
+static bool appendSave(Sink *pSink)
+{
+    const AppendState *pState = &pSink->state;
+    FILE *pFile = appendOpen(pSink, "w");
+    bool success = false;
+
+    if (pFile != NULL) {
+        fprintf(pFile, "arrayify-append 1\noptions %s\ninput_length %lld\ninput_crc32c 0x%08lx\noutput_offset %lld\n"
+                "output_size %lld\nposition %lld\nline_offset %lld\nwritten_offset %lld\nline_open %d\n"
+                "first_line %d\nline %d ", pSink->options, pState->inputLength, (unsigned long) pState->inputCrc,
+                pState->outputOffset, pState->outputSize, pState->position, pState->lineOffset,
+                pState->writtenOffset, pState->lineOpen, pState->firstLine, pState->lineFill);
+        for (int x = 0; x < pState->lineFill; x++) {
+            fprintf(pFile, "%02x", (unsigned char) pState->pLine[x]);
+        }
+        fputc('\n', pFile);
+        success = (fclose(pFile) == 0);
+    }
+    if (!success) {
+        printf("Cannot write the state of output file %s for -a (%s).\n", pSink->pFileName, strerror(errno));
+    }
+
+    return success;
+}
+
+// Note the state of an output once all of the input has been encoded,
+// but before the ending is written, which is where the next run with
+// -a will carry on from
+static void appendSnapshot(Sink *pSink)
+{
+    AppendState *pState = &pSink->state;
+    Output *pOutput = &pSink->output;
+
+    pState->inputLength = pOutput->pInput->length;
+    pState->inputCrc = pOutput->pInput->checkCrc;
+    pState->outputOffset = ftello(pOutput->pFile);
+    pState->position = pOutput->position;
+    pState->lineOffset = pOutput->lineOffset;
+    pState->writtenOffset = pOutput->writtenOffset;
+    pState->lineOpen = pOutput->lineOpen;
+    pState->firstLine = (pOutput->pPrefix != NULL);
+    pState->lineFill = (int) (pOutput->pOut - pOutput->pLine);
+    free(pState->pLine);
+    pState->pLine = (char *) malloc (pState->lineFill + 1);
+    if (pState->pLine != NULL) {
+        memcpy(pState->pLine, pOutput->pLine, pState->lineFill);
+    } else {
+        pState->lineFill = 0;
+        pState->outputOffset = -1; // Will not match, so the next run writes in full
+    }
+}
+
+// Carry on writing an output from where the last run left off, the
+// output file having been cut back to the end of its lines
+static void appendRestore(Sink *pSink)
+{
+    const AppendState *pState = &pSink->state;
+    Output *pOutput = &pSink->output;
+
+    pOutput->position = pState->position;
+    pOutput->lineOffset = pState->lineOffset;
+    pOutput->writtenOffset = pState->writtenOffset;
+    pOutput->lineOpen = pState->lineOpen;
+    memcpy(pOutput->pLine, pState->pLine, pState->lineFill);
+    pOutput->pOut = pOutput->pLine + pState->lineFill;
+    if (!pState->firstLine) {
+        free(pOutput->pPrefix);
+        pOutput->pPrefix = NULL;
+    }
+}
+
+// Read the part of the input which the outputs being appended to were
+// written from, accounting for it but not encoding it, and return true
+// if it is as it was, i.e. the input has only been added to since
+static bool appendVerify(FILE *pInputFile, Input *pInput, const AppendState *pState)
+{
+    char buffer[INPUT_BUFFER_SIZE];
+    long long readSize;
+    size_t bytesRead = 1;
+
+    while ((pInput->length < pState->inputLength) && (bytesRead > 0)) {
+        readSize = pState->inputLength - pInput->length;
+        if (readSize > (long long) sizeof(buffer)) {
+            readSize = sizeof(buffer);
+        }
+        bytesRead = fread(buffer, 1, readSize, pInputFile);
+        inputRead(pInput, buffer, (int) bytesRead);
+    }
+
+    return (pInput->length == pState->inputLength) && (pInput->checkCrc == pState->inputCrc);
+}
+
+// Cut an output file back to the given size, leaving the file position
+// there, returning true on success
+static bool appendCut(FILE *pFile, long long size)
+{
+    bool success = false;
+
+    if (fflush(pFile) == 0) {
+#ifdef _WIN32
+        success = (_chsize_s(_fileno(pFile), size) == 0);
+#else
+        success = (ftruncate(fileno(pFile), size) == 0);
+#endif
+    }
+
+    return success && (fseeko(pFile, size, SEEK_SET) == 0);
+}
+
+// Return the start of the name of a preprocessor directive, e.g. "include",
+// if a line is one, else NULL
+static const char *directiveName(const char *pLine)
+{
+    if (*pLine != '#') {
+        return NULL;
+    }
+    for (pLine++; (*pLine == ' ') || (*pLine == '\t'); pLine++) {
+    }
+
+    return pLine;
+}
+
+// Return true if the name of a directive, from directiveName(), is pWanted
+static bool directiveIs(const char *pName, const char *pWanted)
+{
+    size_t length = strlen(pWanted);
+
+    return (pName != NULL) && (strncmp(pName, pWanted, length) == 0) && !isalnum((unsigned char) pName[length]);
+}
+
+// Add lines hoisted out of an array held for a template to pIncludes,
+// unless they are already there, returning false if there is no memory
+static bool templateInclude(Bytes *pIncludes, const char *pText, long length)
+{
+    for (long x = 0; x + length <= pIncludes->size; x++) {
+        if (((x == 0) || (pIncludes->pData[x - 1] == '\n')) && (memcmp(pIncludes->pData + x, pText, length) == 0)) {
+            return true;
+        }
+    }
+
+    return bytesAdd(pIncludes, pText, length);
+}
+
+// Deal with a line of an array held for a template: an #include line is
+// added to pIncludes, if that is given, any other line written to pOut,
+// if that is given; returns false if there is no memory for pIncludes
+static bool templateLine(const char *pLine, long length, Bytes *pIncludes, FILE *pOut)
+{
+    if (directiveIs(directiveName(pLine), "include")) {
+        if (pIncludes != NULL) {
+            return templateInclude(pIncludes, pLine, length);
+        }
+    } else if (pOut != NULL) {
+        fwrite(pLine, length, 1, pOut);
+    }
+
+    return true;
+}
+
+// Deal with each of the lines of a conditional block held by templateHoist()
+// which turned out not to be only #include lines, as templateLine() does
+static bool templateBlock(const char *pBlock, int blockFill, Bytes *pIncludes, FILE *pOut)
+{
+    bool success = true;
+
+    for (int x = 0, y = 0; y < blockFill; y++) {
+        if (pBlock[y] == '\n') {
+            success = templateLine(pBlock + x, y + 1 - x, pIncludes, pOut) && success;
+            x = y + 1;
+        }
+    }
+
+    return success;
+}
+
+// Go through the array held in pHeld for a template, hoisting its #include
+// lines so that they go before the head of the template, which may open a
+// namespace or an extern "C" block: a conditional block with nothing but
+// #include lines in it is hoisted whole and any other #include line, which
+// is of a standard header and guarded only by the helper it is in, on its
+// own; with pIncludes the hoisted lines are collected there, each once, and
+// with pOut the rest is copied there, noting where the offset that -a carries
+// on from ends up; returns false if there is no memory for pIncludes
+static bool templateHoist(Sink *pSink, FILE *pHeld, Bytes *pIncludes, FILE *pOut)
+{
+    bool success = true;
+    char line[TEMPLATE_LINE_LENGTH];
+    char block[TEMPLATE_BLOCK_LENGTH];
+    int blockFill = 0;
+    int depth = 0;     // how deep in conditional blocks the line is
+    bool pure = false; // true if the outermost conditional block has only had directives in it so far
+    bool lineStart = true;
+    long long heldOffset = ((pOut != NULL) && pSink->append) ? pSink->state.outputOffset : -1;
+    long long position;
+    int size;
+    long length;
+    const char *pName;
+    bool opens;
+
+    rewind(pHeld);
+    for (;;) {
+        size = sizeof(line);
+        position = ftello(pHeld);
+        if (position == heldOffset) {
+            pSink->state.outputOffset = ftello(pOut);
+            heldOffset = -1;
+        } else if ((heldOffset > position) && (heldOffset - position < size)) {
+            // Stop there, as the offset may be part way along a line
+            size = (int) (heldOffset - position) + 1;
+        }
+        if (fgets(line, size, pHeld) == NULL) {
+            break;
+        }
+        length = (long) strlen(line);
+        // Only a whole line may be a directive
+        pName = (lineStart && (line[length - 1] == '\n')) ? directiveName(line) : NULL;
+        lineStart = (line[length - 1] == '\n');
+        opens = directiveIs(pName, "if") || directiveIs(pName, "ifdef") || directiveIs(pName, "ifndef");
+        if (pure) {
+            if ((opens || directiveIs(pName, "elif") || directiveIs(pName, "else") ||
+                 directiveIs(pName, "endif") || directiveIs(pName, "include")) &&
+                (blockFill + length <= (long) sizeof(block))) {
+                memcpy(block + blockFill, line, length);
+                blockFill += length;
+                depth += opens ? 1 : directiveIs(pName, "endif") ? -1 : 0;
+                if (depth == 0) {
+                    if (pIncludes != NULL) {
+                        success = templateInclude(pIncludes, block, blockFill) && success;
+                    }
+                    pure = false;
+                }
+                continue;
+            }
+            // Not a block of #include lines after all, so let through
+            // what has been held of it, less its #include lines
+            pure = false;
+            success = templateBlock(block, blockFill, pIncludes, pOut) && success;
+        }
+        if (opens && (depth == 0)) {
+            // Hold the start of the block until it is known what is in it
+            memcpy(block, line, length);
+            blockFill = length;
+            pure = true;
+        } else {
+            success = templateLine(line, length, pIncludes, pOut) && success;
+        }
+        depth += opens ? 1 : (directiveIs(pName, "endif") && (depth > 0)) ? -1 : 0;
+    }
+    if (pure) {
+        // A block which was never ended
+        success = templateBlock(block, blockFill, pIncludes, pOut) && success;
+    }
+
+    return success;
+}
+
+// Start writing to an output, which must have been populated with
+// the file, name, line length and any format-specific settings,
+// returning true if it can be written
+static bool sinkStart(Sink *pSink, bool bare)
+{
+    Output *pOutput = &pSink->output;
+    const Format *pFormat = pSink->pFormat;
+
+    pOutput->pFile = pSink->pFile;
+    pOutput->pLine = (char *) malloc (pOutput->lineLength + ELEMENT_MAX_LENGTH + LINE_SLACK); // Room for an element which overruns
+    pOutput->pOut = pOutput->pLine;
+    if (pFormat->pPrefix != NULL) {
+        pOutput->prefixLength = prefixLength(pFormat, pOutput->pName);
+        pOutput->pPrefix = (char *) malloc (pOutput->prefixLength + 1); // +1 for terminator, which sprintf() adds
+    }
+    if (pOutput->pTemplate != NULL) {
+        // Hold the array in a temporary file, so that its #include lines
+        // can go before the head of the template, which may also need
+        // things only known once the input has been read
+        pOutput->pFile = tmpfile();
+        if (pOutput->pFile == NULL) {
+            printf("Cannot create temporary file (%s).\n", strerror(errno));
+        }
+    }
+
+    if ((pOutput->pLine != NULL) && ((pFormat->pPrefix == NULL) || (pOutput->pPrefix != NULL)) &&
+        (pOutput->pFile != NULL)) {
+        pSink->started = true;
+        if ((pOutput->pTemplate == NULL) && !bare && !pFormat->raw) {
+            // Write the header on its own line directly to the output file,
+            // to be filled in at the end
+            pSink->header = true;
+            if (pSink->shared) {
+                pSink->headerOffset = ftello(pOutput->pFile);
+            }
+            if (!pSink->resume) {
+                writeHeader(pSink, true);
+            }
+        }
+        // Create the prefix
+        if (pOutput->pPrefix != NULL) {
+            sprintf(pOutput->pPrefix, pFormat->pPrefix, pOutput->pName);
+        }
+        if (pSink->resume) {
+            // The output already has its start, so carry on from its lines
+            appendRestore(pSink);
+        } else {
+            if (pOutput->pHostPath != NULL) {
+                hostStart(pOutput);
+            }
+            if (pFormat->pStart != NULL) {
+                pFormat->pStart(pOutput);
+            }
+        }
+    }
+
+    return pSink->started;
+}
+
+// Finish writing to an output once all of the input has been read
+static void sinkEnd(Sink *pSink, bool bare, CrcType crcType, bool digest)
+{
+    Output *pOutput = &pSink->output;
+    const Format *pFormat = pSink->pFormat;
+    FILE *pTemporaryFile;
+    Bytes includes = {NULL, 0, 0};
+
+    if (pSink->started) {
+        if (pSink->append) {
+            appendSnapshot(pSink);
+        }
+        if (pFormat->pEnd != NULL) {
+            pFormat->pEnd(pOutput);
+        }
+        if (pOutput->pHostPath != NULL) {
+            hostEnd(pOutput);
+        }
+        if (pOutput->resource) {
+            pFormat->pResource(pOutput);
+        }
+        if ((crcType != CRC_TYPE_NONE) && !pFormat->raw) {
+            writeCrc(pOutput);
+        }
+        if (digest && !pFormat->raw) {
+            writeDigest(pOutput);
+        }
+        if (pOutput->pTemplate != NULL) {
+            // Now write the #include lines of the array, the head and the
+            // rest of the array; when carrying on from the last run the
+            // output already starts with them
+            pTemporaryFile = pOutput->pFile;
+            pOutput->pFile = pSink->pFile;
+            if (!pSink->resume) {
+                if (!templateHoist(pSink, pTemporaryFile, &includes, NULL)) {
+                    printf("Cannot allocate memory for the #include lines of \"%s\".\n", pSink->pFileName);
+                    fprintf(pOutput->pFile, "# error arrayify ran out of memory for the #include lines of this file\n");
+                    pOutput->failed = true;
+                }
+                if (includes.size > 0) {
+                    fwrite(includes.pData, includes.size, 1, pOutput->pFile);
+                    fprintf(pOutput->pFile, "\n");
+                }
+                free(includes.pData);
+                writeTemplate(pOutput, TEMPLATE_HEAD, 0);
+            }
+            templateHoist(pSink, pTemporaryFile, NULL, pOutput->pFile);
+            fclose(pTemporaryFile);
+            writeTemplate(pOutput, TEMPLATE_TAIL, pOutput->position);
+        } else if (!bare && !pFormat->raw && !pSink->shared) {
+            fprintf(pOutput->pFile, ENDFIX);
+        }
+        if (pSink->append) {
+            pSink->state.outputSize = ftello(pOutput->pFile);
+        }
+        // Fill in the header, now that the whole of the input has been read;
+        // a counter stream for a dry run cannot be rewound but is the same size
+        if (pSink->header && (fflush(pOutput->pFile) == 0) &&
+            (fseeko(pOutput->pFile, pSink->headerOffset, SEEK_SET) == 0)) {
+            writeHeader(pSink, false);
+            if (pSink->shared) {
+                // The next array of the amalgamation goes after this one
+                fseeko(pOutput->pFile, 0, SEEK_END);
+            }
+        }
+        if (pSink->append) {
+            appendSave(pSink);
+        }
+    }
+
+    // Tidy up
+    free (pOutput->pPrefix);
+    pOutput->pPrefix = NULL;
+    free (pOutput->pLine);
+    pOutput->pLine = NULL;
+}
+
+// Return the number of bytes written to an output so far, for a dry
+// run, where pSink->pFile is a counter stream; the output may be
+// being held in a temporary file rather than written to the counter
+static long long sinkSize(Sink *pSink)
+{
+    if (pSink->output.pFile != pSink->pFile) {
+        return ftello(pSink->output.pFile);
+    }
+
+    return counterSize(pSink->pFile, &pSink->size);
+}
+
+// Give advice to the operating system about the caching of a range of a file
+static void ioAdvise(FILE *pFile, long long offset, long long length, int advice)
+{
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(fileno(pFile), offset, length, advice);
+#else
+    (void) pFile;
+    (void) offset;
+    (void) length;
+    (void) advice;
+#endif
+}
+
+// Start applying the I/O policy to the input file
+static void ioStart(Io *pIo, FILE *pInputFile, const char *pInputFileName)
+{
+    pIo->directFd = -1;
+    pIo->advised = 0;
+    if (pIo->policy != IO_POLICY_NORMAL) {
+#ifdef POSIX_FADV_SEQUENTIAL
+        ioAdvise(pInputFile, 0, 0, POSIX_FADV_SEQUENTIAL);
+        ioAdvise(pInputFile, 0, IO_WINDOW, POSIX_FADV_WILLNEED);
+#endif
+    }
+    if (pIo->policy == IO_POLICY_DIRECT) {
+#ifdef O_DIRECT
+        pIo->directFd = open(pInputFileName, O_RDONLY | O_DIRECT);
+        if ((pIo->directFd >= 0) &&
+            (posix_memalign((void **) &pIo->pBuffer, IO_ALIGNMENT, IO_DIRECT_SIZE) != 0)) {
+            close(pIo->directFd);
+            pIo->directFd = -1;
+            pIo->pBuffer = NULL;
+        }
+#endif
+        if (pIo->directFd < 0) {
+            printf("Cannot read input file %s with O_DIRECT, reading it through the page cache.\n", pInputFileName);
+        }
+    }
+}
+
+// Read up to size bytes at offset into the input, which is where the
+// stdio position of pInputFile has been put, returning the number of
+// bytes read; where O_DIRECT is used *ppBuffer is pointed into the
+// large aligned buffer which the bytes have been read into
+static int ioRead(Io *pIo, FILE *pInputFile, char **ppBuffer, long long size, long long offset)
+{
+#ifdef O_DIRECT
+    ssize_t bytesRead = 0;
+
+    if (pIo->directFd >= 0) {
+        if ((offset < pIo->bufferOffset) || (offset + size > pIo->bufferOffset + pIo->bufferFill)) {
+            // Reads must start on an aligned block, and be whole blocks,
+            // which is only not the case at the end of the file
+            pIo->bufferOffset = offset & ~((long long) IO_ALIGNMENT - 1);
+            bytesRead = pread(pIo->directFd, pIo->pBuffer, IO_DIRECT_SIZE, pIo->bufferOffset);
+            pIo->bufferFill = (bytesRead > 0) ? bytesRead : 0;
+        }
+        if (offset < pIo->bufferOffset + pIo->bufferFill) {
+            *ppBuffer = pIo->pBuffer + (offset - pIo->bufferOffset);
+            if (offset + size > pIo->bufferOffset + pIo->bufferFill) {
+                size = pIo->bufferOffset + pIo->bufferFill - offset;
+            }
+            return (int) size;
+        }
+        if (bytesRead == 0) {
+            return 0;
+        }
+        // The read failed: fall back to stdio
+        fseeko(pInputFile, offset, SEEK_SET);
+    }
+#else
+    (void) pIo;
+    (void) offset;
+#endif
+
+    return fread(*ppBuffer, 1, size, pInputFile);
+}
+
+// Apply the I/O policy once the input has been read up to offset:
+// ask for the next window of the input to be read ahead and drop
+// the input and the outputs behind from the page cache, the outputs
+// being allowed a window's grace to be written back first
+static void ioProgress(Io *pIo, FILE *pInputFile, long long offset, Sink *pSinks, int sinkCount, bool last)
+{
+    long long position;
+
+    if ((pIo->policy != IO_POLICY_NORMAL) && ((offset >= pIo->advised + IO_WINDOW) || last)) {
+#ifdef POSIX_FADV_DONTNEED
+        ioAdvise(pInputFile, offset, IO_WINDOW, POSIX_FADV_WILLNEED);
+        ioAdvise(pInputFile, 0, offset, POSIX_FADV_DONTNEED);
+        for (int x = 0; x < sinkCount; x++) {
+            if (pSinks[x].pFile != NULL) {
+                fflush(pSinks[x].pFile);
+                position = ftello(pSinks[x].pFile);
+                if (last) {
+                    // Make sure that everything can be dropped
+                    fdatasync(fileno(pSinks[x].pFile));
+                } else {
+                    position -= IO_WINDOW;
+                }
+                if (position > 0) {
+                    ioAdvise(pSinks[x].pFile, 0, position, POSIX_FADV_DONTNEED);
+                }
+            }
+        }
+#else
+        (void) pInputFile;
+        (void) pSinks;
+        (void) sinkCount;
+        (void) position;
+#endif
+        pIo->advised = offset;
+    }
+    if (last && (pIo->directFd >= 0)) {
+        close(pIo->directFd);
+        pIo->directFd = -1;
+        free(pIo->pBuffer);
+        pIo->pBuffer = NULL;
+    }
+}
+
+// Report progress, if a second has passed since the last report or
+// this is the last; the time is only known to the nearest second
+// so the rate is an average since the start
+static void progressUpdate(Progress *pProgress, long long length, bool last)
+{
+    time_t now = time(NULL);
+    double elapsed;
+    double rate = 0;
+    long eta = -1;
+    int percent = -1;
+
+    if ((pProgress->style != PROGRESS_NONE) && ((now != pProgress->last) || last)) {
+        pProgress->last = now;
+        elapsed = difftime(now, pProgress->start);
+        if (elapsed > 0) {
+            rate = length / elapsed;
+        }
+        if (pProgress->total > 0) {
+            percent = (int) ((double) length * 100 / pProgress->total);
+            if (rate > 0) {
+                eta = (long) ((pProgress->total - length) / rate);
+            }
+        }
+        if (pProgress->style == PROGRESS_BAR) {
+            fprintf(stderr, "\r%.1f Mbytes", length / 1048576.0);
+            if (percent >= 0) {
+                fprintf(stderr, " of %.1f (%d%%)", pProgress->total / 1048576.0, percent);
+            }
+            fprintf(stderr, ", %.1f Mbytes/s", rate / 1048576.0);
+            if (eta >= 0) {
+                fprintf(stderr, ", %ld s to go  ", eta);
+            }
+            if (last) {
+                fputc('\n', stderr);
+            }
+        } else {
+            fprintf(stderr, "progress: bytes=%lld total=%lld percent=%d mbytes_per_s=%.2f eta_s=%ld done=%d\n",
+                    length, pProgress->total, percent, rate / 1048576.0, eta, last);
+        }
+        fflush(stderr);
+    }
+}
+
+// Parse the input file and write to each of the outputs, reading
+// the input only once, each buffer of it being passed to all of
+// the outputs in turn while it is still in the cache; if sampleStep
+// is not zero only one block in every sampleStep is read, for an
+// estimate, the size of the output from each being noted in each
+// Sink; progress is reported to pProgress; returns the total number
+// of lines written
+static int parse(FILE *pInputFile, bool bare, CrcType crcType, bool digest, Input *pInput,
+                 Sink *pSinks, int sinkCount, long long sampleStep, Progress *pProgress)
+{
+    char inputBuffer[INPUT_BUFFER_SIZE];
+    char *pBuffer = inputBuffer;
+    int bytesRead;
+    long long readSize;
+    long long offset;
+    long long holeSize;
+    long long dataEnd = 0;
+    bool skipHoles = (sampleStep == 0);
+    int started = 0;
+    int linesWritten = 0;
+    long long block = 0;
+    double size;
+
+    PROBE3(file__start, pSinks[0].output.pInputFileName, pSinks[0].output.inputSize, sinkCount);
+    for (int x = 0; x < sinkCount; x++) {
+        if (sinkStart(&pSinks[x], bare)) {
+            started++;
+            // Holes can only be skipped if every output can skip them
+            if (pSinks[x].pFormat->pZeros == NULL) {
+                skipHoles = false;
+            }
+        }
+    }
+
+    if (started > 0) {
+        // Read from the input file until we get no more
+        do {
+            readSize = sizeof(inputBuffer);
+            if (skipHoles) {
+                if (pInput->length >= dataEnd) {
+                    // Skip over any hole in a sparse input file without reading it
+                    holeSize = findHole(pInputFile, pInput->length, &dataEnd);
+                    if (holeSize > 0) {
+                        inputHole(pInput, holeSize);
+                        for (int x = 0; x < sinkCount; x++) {
+                            if (pSinks[x].started) {
+                                pSinks[x].pFormat->pZeros(&pSinks[x].output, holeSize);
+                            }
+                        }
+                    }
+                    // Finding the hole moves the file position underneath stdio
+                    fseeko(pInputFile, pInput->length, SEEK_SET);
+                }
+                if (dataEnd - pInput->length < readSize) {
+                    readSize = dataEnd - pInput->length;
+                }
+            }
+            offset = pInput->length;
+            if (sampleStep > 0) {
+                offset = block * sampleStep * (long long) sizeof(inputBuffer);
+                fseeko(pInputFile, offset, SEEK_SET);
+                block++;
+            }
+            bytesRead = ioRead(&pInput->io, pInputFile, &pBuffer, readSize, offset);
+            if (bytesRead > 0) {
+                inputRead(pInput, pBuffer, bytesRead);
+                for (int x = 0; x < sinkCount; x++) {
+                    if (pSinks[x].started) {
+                        size = (sampleStep > 0) ? sinkSize(&pSinks[x]) : 0;
+                        pSinks[x].pFormat->pWrite(&pSinks[x].output, pBuffer, bytesRead);
+                        if (sampleStep > 0) {
+                            size = sinkSize(&pSinks[x]) - size;
+                            pSinks[x].blockSum += size;
+                            pSinks[x].blockSumSquares += size * size;
+                        }
+                    }
+                }
+                PROBE2(block__encoded, offset, bytesRead);
+                progressUpdate(pProgress, pInput->length, false);
+                ioProgress(&pInput->io, pInputFile, offset + bytesRead, pSinks, sinkCount, false);
+            }
+        } while (bytesRead > 0);
+        progressUpdate(pProgress, pInput->length, true);
+    }
+
+    for (int x = 0; x < sinkCount; x++) {
+        sinkEnd(&pSinks[x], bare, crcType, digest);
+        linesWritten += pSinks[x].output.linesWritten;
+    }
+    ioProgress(&pInput->io, pInputFile, pInput->length, pSinks, sinkCount, true);
+    PROBE3(file__end, pSinks[0].output.pInputFileName, pInput->length, linesWritten);
+
+    return linesWritten;
+}
+
+// Arrayify an input file as the command line says; with pBatch not NULL
+// this is one input of a batch run, written to the amalgamation pBatch->pFile
+// if there is one.  Returns 0 on success, 1 if --check finds an output out of
+// date, else -1.
+static int arrayify(int argc, char *argv[], char *pExeName, Batch *pBatch)
+{
+    int retValue = -1;
+    bool success = false;
+    int x = 1;
+    int lineLength = LINE_LENGTH;
+    bool bare = false;
+    char *pInputFileName = NULL;
+    FILE *pInputFile = NULL;
+    char *pOutputFileName = NULL;
+    bool outputFileNameMalloced = false;
+    char *pVariableName = NULL;
+    char *pDefaultName = NULL;
+    char *pMallocedName = NULL;
+    char *pWebName = NULL;
+    char *pTmp;
+    struct stat st = { 0 };
+    char *pFormatName = NULL;
+    const Format *pFormat = &(formats[0]);
+    long long inputSize = -1;
+    bool bigEndian = false;
+    bool optionsValid = true;
+    bool decoder = false;
+    bool binary = false;
+    Sink sinks[MAX_OUTPUTS];
+    int sinkCount = 0;
+    int lines;
+    bool dryRun = false;
+    bool estimate = false;
+    long long sampleStep = 0;
+    double blocks;
+    double samples;
+    double mean;
+    double variance;
+    Progress progress;
+    Input input;
+    Input inputStart;
+    bool append = false;
+    bool resume = false;
+    bool check = false;
+    bool restat = false;
+    bool upToDate = false;
+    char *pDepFileName = NULL;
+    bool host = false;
+    bool resource = false;
+    char *pHostPath = NULL;
+    const char *pSchema = NULL;
+    int stale = 0;
+    const char *pReason;
+    char *pTemplateFileName = NULL;
+    CrcType crcType = CRC_TYPE_NONE;
+    bool digest = false;
+    Template outputTemplate;
+
+    memset(sinks, 0, sizeof(sinks));
+    memset(&input, 0, sizeof(input));
+    memset(&progress, 0, sizeof(progress));
+    memset(&outputTemplate, 0, sizeof(outputTemplate));
+
+    // Look for all the command line parameters
+    while (x < argc) {
+        // Test for input filename
+        if (x == 1) {
+            pInputFileName = argv[x];
+        // Test for variable name option
+        } else if (strcmp(argv[x], "-n") == 0) {
+            x++;
+            if (x < argc) {
+                pVariableName = argv[x];
+            }
+        // Test for line length option
+        } else if (strcmp(argv[x], "-l") == 0) {
+            x++;
+            if (x < argc) {
+                lineLength = atoi(argv[x]);
+            }
+        // Test for bare option
+        } else if (strcmp(argv[x], "-b") == 0) {
+            bare = true;
+        // Test for decoder option
+        } else if (strcmp(argv[x], "-d") == 0) {
+            decoder = true;
+        // Test for CRC option
+        } else if (strcmp(argv[x], "-c") == 0) {
+            x++;
+            if (x < argc) {
+                for (crcType = CRC_TYPE_CRC32; (crcType < NUM_CRC_TYPES) &&
+                                               (strcmp(argv[x], crcTypes[crcType].pName) != 0);
+                     crcType = (CrcType) (crcType + 1)) {}
+                if (crcType == NUM_CRC_TYPES) {
+                    printf("Unknown CRC type %s, must be crc32 or crc32c.\n", argv[x]);
+                    crcType = CRC_TYPE_NONE;
+                    optionsValid = false;
+                }
+            }
+        // Test for dry run options
+        } else if (strcmp(argv[x], "--dry-run") == 0) {
+            dryRun = true;
+        } else if (strcmp(argv[x], "--estimate") == 0) {
+            dryRun = true;
+            estimate = true;
+        // Test for check option
+        } else if (strcmp(argv[x], "--check") == 0) {
+            check = true;
+        // Test for the options for running from a build file
+        } else if (strcmp(argv[x], "--restat") == 0) {
+            restat = true;
+        } else if (strcmp(argv[x], "--depfile") == 0) {
+            x++;
+            if (x < argc) {
+                pDepFileName = argv[x];
+            }
+        // Test for progress option
+        } else if (strcmp(argv[x], "-p") == 0) {
+            x++;
+            if (x < argc) {
+                for (progress.style = PROGRESS_BAR; (progress.style < NUM_PROGRESS_STYLES) &&
+                                                    (strcmp(argv[x], progressStyles[progress.style]) != 0);
+                     progress.style = (ProgressStyle) (progress.style + 1)) {}
+                if (progress.style == NUM_PROGRESS_STYLES) {
+                    printf("Unknown progress style %s, must be bar or log.\n", argv[x]);
+                    progress.style = PROGRESS_NONE;
+                    optionsValid = false;
+                }
+            }
+        // Test for I/O policy option
+        } else if (strcmp(argv[x], "-i") == 0) {
+            x++;
+            if (x < argc) {
+                for (input.io.policy = IO_POLICY_NORMAL; (input.io.policy < NUM_IO_POLICIES) &&
+                                                         (strcmp(argv[x], ioPolicies[input.io.policy]) != 0);
+                     input.io.policy = (IoPolicy) (input.io.policy + 1)) {}
+                if (input.io.policy == NUM_IO_POLICIES) {
+                    printf("Unknown I/O policy %s, must be normal, stream or direct.\n", argv[x]);
+                    input.io.policy = IO_POLICY_NORMAL;
+                    optionsValid = false;
+                }
+            }
+        // Test for append option
+        } else if (strcmp(argv[x], "-a") == 0) {
+            append = true;
+        // Test for host option
+        } else if (strcmp(argv[x], "-x") == 0) {
+            host = true;
+        // Test for resource option
+        } else if (strcmp(argv[x], "-r") == 0) {
+            resource = true;
+        // Test for table schema option
+        } else if (strcmp(argv[x], "-k") == 0) {
+            x++;
+            if (x < argc) {
+                pSchema = argv[x];
+            }
+        // Test for SHA-256 option
+        } else if (strcmp(argv[x], "-s") == 0) {
+            digest = true;
+        // Test for template option
+        } else if (strcmp(argv[x], "-t") == 0) {
+            x++;
+            if (x < argc) {
+                pTemplateFileName = argv[x];
+            }
+        // Test for output file option, which may be given more
+        // than once, each optionally followed by :format
+        } else if (strcmp(argv[x], "-o") == 0) {
+            x++;
+            if (x < argc) {
+                if (sinkCount < MAX_OUTPUTS) {
+                    // The format is only split off if it is one, since
+                    // a Windows path may contain a colon
+                    pTmp = strrchr(argv[x], ':');
+                    if ((pTmp != NULL) && (findFormat(pTmp + 1) != NULL)) {
+                        sinks[sinkCount].pFormat = findFormat(pTmp + 1);
+                        *pTmp = 0;
+                    }
+                    sinks[sinkCount].pFileName = argv[x];
+                    sinkCount++;
+                } else {
+                    printf("Too many output files, the most is %d.\n", MAX_OUTPUTS);
+                    optionsValid = false;
+                }
+            }
+        // Test for format option
+        } else if (strcmp(argv[x], "-f") == 0) {
+            x++;
+            if (x < argc) {
+                pFormatName = argv[x];
+            }
+        // Test for endianness option
+        } else if (strcmp(argv[x], "-e") == 0) {
+            x++;
+            if (x < argc) {
+                if (strcmp(argv[x], "big") == 0) {
+                    bigEndian = true;
+                } else if (strcmp(argv[x], "little") == 0) {
+                    bigEndian = false;
+                } else {
+                    printf("Unknown endianness %s, must be big or little.\n", argv[x]);
+                    optionsValid = false;
+                }
+            }
+        }
+        x++;
+    }
+
+    // Validate the command-line parameters and create
+    // defaults for those unspecified
+    if (pFormatName != NULL) {
+        pFormat = findFormat(pFormatName);
+        if (pFormat == NULL) {
+            printf("Unknown format %s.\n", pFormatName);
+            pFormat = &(formats[0]);
+            optionsValid = false;
+        }
+    }
+    if ((pTemplateFileName != NULL) && !readTemplate(pTemplateFileName, &outputTemplate)) {
+        optionsValid = false;
+    }
+    if (sinkCount == 0) {
+        // The output file name is worked out from the input file name below
+        sinkCount = 1;
+    }
+    for (x = 0; x < sinkCount; x++) {
+        if (sinks[x].pFormat == NULL) {
+            sinks[x].pFormat = pFormat;
+        }
+        // If any output needs the input as binary, all get it
+        if (sinks[x].pFormat->binary) {
+            binary = true;
+        }
+        if (append && !sinks[x].pFormat->appendable) {
+            printf("Format %s cannot be appended to with -a.\n", sinks[x].pFormat->pName);
+            optionsValid = false;
+        }
+        if (host && !sinks[x].pFormat->hostable) {
+            printf("Format %s has no name and name_len for -x to map the input behind.\n", sinks[x].pFormat->pName);
+            optionsValid = false;
+        }
+        if (resource && (sinks[x].pFormat->pResource == NULL)) {
+            printf("Format %s does not give bytes which -r can make a resource of.\n", sinks[x].pFormat->pName);
+            optionsValid = false;
+        }
+    }
+    if (resource && host) {
+        printf("-r cannot be used with -x, a host build mapping the input in place of the array.\n");
+        optionsValid = false;
+    }
+    if (append && dryRun) {
+        printf("-a cannot be used with --dry-run or --estimate.\n");
+        optionsValid = false;
+    }
+    if (check && (append || dryRun)) {
+        printf("--check cannot be used with -a, --dry-run or --estimate.\n");
+        optionsValid = false;
+    }
+    if ((restat || (pDepFileName != NULL)) && (append || check || dryRun)) {
+        printf("--restat and --depfile cannot be used with -a, --check, --dry-run or --estimate.\n");
+        optionsValid = false;
+    }
+    if ((pDepFileName != NULL) && (pBatch != NULL)) {
+        printf("--depfile cannot be used in a batch run.\n");
+        optionsValid = false;
+    }
+    if (append && (pTemplateFileName != NULL) && outputTemplate.late) {
+        printf("-a cannot be used with a template which needs the input to have been read before the array, e.g. for {len}.\n");
+        optionsValid = false;
+    }
+    if ((pBatch != NULL) && (pBatch->pFile != NULL)) {
+        if (append || check || dryRun || host || (sinkCount > 1)) {
+            printf("-g cannot be used with -a, -x, --check, --dry-run, --estimate or more than one output.\n");
+            optionsValid = false;
+        }
+        if (sinks[0].pFormat->pIndexType == NULL) {
+            printf("Format %s has no array of the input for the index of an amalgamation, -g.\n", sinks[0].pFormat->pName);
+            optionsValid = false;
+        }
+    }
+    if ((pInputFileName != NULL) && optionsValid) {
+        success = true;
+        // Open the input file
+        pInputFile = fopen (pInputFileName, binary ? "rb" : "r");
+        if (pInputFile == NULL) {
+            success = false;
+            printf("Cannot open input file %s (%s).\n", pInputFileName, strerror(errno));
+        } else {
+            // Note the size and time of the input, for the header and --check
+            if (stat(pInputFileName, &st) == 0) {
+                input.fileSize = (long long) st.st_size;
+                input.fileTime = (long long) st.st_mtime;
+                input.racyTime = (st.st_mtime + CHECK_RACY_SECONDS > time(NULL));
+            }
+            if (host) {
+                // A host build maps the input from wherever it is run
+#ifdef _WIN32
+                pHostPath = _fullpath(NULL, pInputFileName, 0);
+#else
+                pHostPath = realpath(pInputFileName, NULL);
+#endif
+                if (pHostPath == NULL) {
+                    success = false;
+                    printf("Cannot find the full path of input file %s (%s).\n", pInputFileName, strerror(errno));
+                }
+            }
+            if (binary || estimate || (progress.style != PROGRESS_NONE)) {
+                // Binary formats need to know the size of the input up front, as
+                // does sampling it, and progress is reported against it
+                if (fseeko(pInputFile, 0, SEEK_END) == 0) {
+                    inputSize = ftello(pInputFile);
+                    rewind(pInputFile);
+                }
+                if ((inputSize < 0) && (binary || estimate)) {
+                    success = false;
+                    printf("Cannot determine the size of input file %s (%s).\n", pInputFileName, strerror(errno));
+                }
+            }
+            // Now copy the file name, lopping off the extension and any path
+            pMallocedName = (char *) malloc (strlen(pInputFileName) + 1);
+            if (pMallocedName != NULL) {
+                strcpy(pMallocedName, pInputFileName);
+                pDefaultName = defaultName(pMallocedName);
+                for (x = 0; (x < sinkCount) && (pVariableName == NULL); x++) {
+                    if ((sinks[x].pFormat->pEnd == webEnd) || (sinks[x].pFormat->pEnd == webDeflateEnd)) {
+                        // A web asset is named from its path, unique in the site
+                        pWebName = webName(pInputFileName);
+                        pVariableName = pWebName;
+                    }
+                }
+                if (pVariableName == NULL) {
+                    // No name specified, so set it to the input
+                    // filename without paths and extension
+                    pVariableName = pDefaultName;
+                }
+                // Check the line length: for string literal formats it must
+                // be at least the amount of space required to print the
+                // prefix (which includes the variable name) and "\x"\n,
+                // where x is at least one character from the input, which
+                // [may be] escaped
+                for (x = 0; x < sinkCount; x++) {
+                    pFormat = sinks[x].pFormat;
+                    sinks[x].output.lineLength = lineLength;
+                    if ((pFormat->pPrefix != NULL) &&
+                        ((lineLength < 0) || (lineLength < prefixLength(pFormat, pVariableName) + 5))) {
+                        printf("Using line length %d as %d is less than the minimum required to print something.\n", prefixLength(pFormat, pVariableName) + 5, lineLength);
+                        sinks[x].output.lineLength = prefixLength(pFormat, pVariableName) + 5;
+                    }
+                }
+                if (sinks[0].pFileName == NULL) {
+                    // No output file specified, so set it to the input
+                    // filename without path and with the default extension
+                    pOutputFileName = (char *) malloc (strlen(pDefaultName) + sizeof(OUTPUT_FILE_EXTENSION) - 1 + sizeof(EXT_SEPARATOR) - 1 + 1);
+                    if (pOutputFileName != NULL) {
+                        outputFileNameMalloced = true;
+                        strcpy(pOutputFileName, pDefaultName);
+                        strcat(pOutputFileName, EXT_SEPARATOR);
+                        strcat(pOutputFileName, OUTPUT_FILE_EXTENSION);
+                        sinks[0].pFileName = pOutputFileName;
+                    } else {
+                        success = false;
+                        printf("Cannot allocate memory for output file name.\n");
+                    }
+                }
+            } else {
+                success = false;
+                printf("Cannot allocate memory for name.\n");
+            }
+            // For -a, carry on from where the last run left off if the state
+            // of every output was kept, with the same options, and every
+            // output is as that run left it
+            resume = append && success;
+            for (x = 0; (x < sinkCount) && success; x++) {
+                sinkOptions(&sinks[x], pVariableName, pInputFileName, pExeName, bare,
+                            ((pTemplateFileName != NULL) && !sinks[x].pFormat->raw) ? &outputTemplate : NULL,
+                            crcType, digest, bigEndian, decoder, host, pSchema, resource);
+                sinks[x].append = append;
+                resume = resume && appendLoad(&sinks[x]) && (strcmp(sinks[x].state.options, sinks[x].options) == 0) &&
+                         (stat(sinks[x].pFileName, &st) == 0) && (st.st_size == sinks[x].state.outputSize) &&
+                         (sinks[x].state.inputLength == sinks[0].state.inputLength);
+            }
+            for (x = 0; x < sinkCount; x++) {
+                sinks[x].resume = resume;
+            }
+            // For --restat, leave the outputs as they are, times and all, if
+            // every one is up to date, so that Ninja can skip what depends on them
+            if (success && restat) {
+                inputStart = input;
+                input.check = true;
+                upToDate = true;
+                for (x = 0; (x < sinkCount) && upToDate; x++) {
+                    upToDate = (checkOutput(&sinks[x], pInputFile, &input) == NULL);
+                }
+                input = inputStart;
+                rewind(pInputFile);
+            }
+            // Open the output files, or counters in their place for a dry run
+            for (x = 0; (x < sinkCount) && dryRun; x++) {
+                sinks[x].pFile = counterOpen(&sinks[x].size);
+                if (sinks[x].pFile == NULL) {
+                    success = false;
+                    printf("Cannot open a stream to count the output (%s).\n", strerror(errno));
+                }
+            }
+            for (x = 0; (x < sinkCount) && !dryRun && !check && !upToDate; x++) {
+                if ((pBatch != NULL) && (pBatch->pFile != NULL)) {
+                    // Declared extern, so that C++ gives the const array external linkage for the index
+                    sinks[x].pFile = pBatch->pFile;
+                    sinks[x].shared = true;
+                    fprintf(sinks[x].pFile, "extern %s ", sinks[x].pFormat->pIndexType);
+                    fprintf(sinks[x].pFile, sinks[x].pFormat->pIndexArray, pVariableName);
+                    fprintf(sinks[x].pFile, "[];\n");
+                } else if (sinks[x].pFileName != NULL) {
+                    if (sinks[x].resume) {
+                        // Keep what is there, to be cut back once the input has been checked
+                        sinks[x].pFile = fopen(sinks[x].pFileName, sinks[x].pFormat->raw ? "rb+" : "r+");
+                    } else {
+                        sinks[x].pFile = fopen(sinks[x].pFileName, sinks[x].pFormat->raw ? "wb" : "w");
+                    }
+                    if (sinks[x].pFile == NULL) {
+                        success = false;
+                        printf("Cannot open output file %s (%s).\n", sinks[x].pFileName, strerror(errno));
+                    }
+                }
+            }
+        }
+        if (success && check) {
+            // Only the first line of each output is read, and the input
+            // not at all unless it has been touched
+            input.check = true;
+            for (x = 0; x < sinkCount; x++) {
+                pReason = checkOutput(&sinks[x], pInputFile, &input);
+                if (pReason != NULL) {
+                    stale++;
+                    PROBE2(cache__miss, sinks[x].pFileName, pReason);
+                    printf("\"%s\" is out of date: %s.\n", sinks[x].pFileName, pReason);
+                } else {
+                    PROBE2(cache__hit, sinks[x].pFileName, input.length);
+                    printf("\"%s\" is up to date.\n", sinks[x].pFileName);
+                }
+            }
+        } else if (success && upToDate) {
+            for (x = 0; x < sinkCount; x++) {
+                PROBE2(cache__hit, sinks[x].pFileName, input.fileSize);
+                printf("\"%s\" is up to date, leaving it as it is.\n", sinks[x].pFileName);
+            }
+        } else if (success) {
+            input.crcType = crcType;
+            input.digest = digest;
+            // For -a, and for the header which --check looks at, the
+            // CRC-32C of the input is kept to check it against next time
+            input.check = append;
+            for (x = 0; x < sinkCount; x++) {
+                if (!bare && (pTemplateFileName == NULL) && !sinks[x].pFormat->raw) {
+                    input.check = true;
+                }
+                printf("Arrifying file \"%s\", naming array \"%s\", using %d character lines, format %s, and writing output to \"%s\"%s\n",
+                       pInputFileName, pVariableName, sinks[x].output.lineLength, sinks[x].pFormat->pName,
+                       sinks[x].pFileName, bare ? " bare." : ".\n");
+                sinks[x].output.pName = pVariableName;
+                sinks[x].output.inputSize = inputSize;
+                sinks[x].output.bigEndian = bigEndian;
+                sinks[x].output.decoder = decoder;
+                sinks[x].output.resource = resource;
+                sinks[x].output.pHostPath = pHostPath;
+                sinks[x].output.pSchema = pSchema;
+                sinks[x].output.pInputFileName = pInputFileName;
+                sinks[x].output.pExeFileName = pExeName;
+                sinks[x].output.pInput = &input;
+                if ((pTemplateFileName != NULL) && !sinks[x].pFormat->raw) {
+                    sinks[x].output.pTemplate = &outputTemplate;
+                }
+            }
+            if (pTemplateFileName != NULL) {
+                if (outputTemplate.crc && (crcType == CRC_TYPE_NONE)) {
+                    // Just for the template, which defaults to CRC-32
+                    input.crcType = CRC_TYPE_CRC32;
+                }
+                if (outputTemplate.sha256) {
+                    input.digest = true;
+                }
+            }
+            if (input.digest) {
+                sha256Start(&input.sha256);
+            }
+            input.histogram = dryRun;
+            // Sample ESTIMATE_SAMPLES blocks spread evenly over the input
+            blocks = (double) ((inputSize + INPUT_BUFFER_SIZE - 1) / INPUT_BUFFER_SIZE);
+            if (estimate && (blocks > ESTIMATE_SAMPLES * 2)) {
+                sampleStep = (long long) (blocks / ESTIMATE_SAMPLES);
+            }
+            progress.total = inputSize;
+            progress.start = time(NULL);
+            progress.last = progress.start;
+            if (resume) {
+                // The input up to where the last run left off is read but not
+                // encoded: if it is as it was only what has been added is encoded
+                inputStart = input;
+                resume = appendVerify(pInputFile, &input, &sinks[0].state);
+                if (resume) {
+                    PROBE2(cache__hit, sinks[0].pFileName, input.length);
+                    printf("Appending: the first %lld byte(s) of the input are as before, encoding only what has been added.\n",
+                           input.length);
+                } else {
+                    PROBE2(cache__miss, sinks[0].pFileName, "input changed");
+                    printf("Input file %s has changed, rather than just being added to, writing in full.\n", pInputFileName);
+                    input = inputStart;
+                    rewind(pInputFile);
+                }
+                for (x = 0; x < sinkCount; x++) {
+                    sinks[x].resume = resume;
+                    if (!appendCut(sinks[x].pFile, resume ? sinks[x].state.outputOffset : 0)) {
+                        success = false;
+                        printf("Cannot cut back output file %s (%s).\n", sinks[x].pFileName, strerror(errno));
+                        fclose(sinks[x].pFile);
+                        sinks[x].pFile = NULL;
+                    }
+                }
+            } else if (append) {
+                PROBE2(cache__miss, sinks[0].pFileName, "no state kept");
+                printf("No state kept from a previous run to carry on from, writing in full.\n");
+            }
+            ioStart(&input.io, pInputFile, pInputFileName);
+            lines = parse(pInputFile, bare, crcType, digest, &input, sinks, sinkCount, sampleStep, &progress);
+            if (pBatch != NULL) {
+                pBatch->length = input.length;
+            }
+            if (sampleStep > 0) {
+                // Scale the output from the sampled blocks up to the whole input and
+                // bound the error at three standard errors of the mean, corrected
+                // for the fraction of the input that was sampled
+                samples = ceil(blocks / sampleStep);
+                for (x = 0; x < sinkCount; x++) {
+                    mean = sinks[x].blockSum / samples;
+                    variance = (sinks[x].blockSumSquares - sinks[x].blockSum * mean) / (samples - 1);
+                    printf("Estimate: \"%s\" (format %s) would be about %.0f bytes, +/- %.0f, in about %.0f line(s).\n",
+                           sinks[x].pFileName, sinks[x].pFormat->pName,
+                           sinkSize(&sinks[x]) - sinks[x].blockSum + sinks[x].blockSum * inputSize / input.length,
+                           3 * sqrt(((variance > 0) ? variance : 0) / samples * (1 - samples / blocks)) * blocks,
+                           (double) sinks[x].output.linesWritten * inputSize / input.length);
+                }
+                printf("Order-0 entropy of the input: about %.0f bytes, an estimate of the least it could be compressed to.\n",
+                       inputEntropy(&input) * inputSize / input.length);
+            } else if (dryRun) {
+                for (x = 0; x < sinkCount; x++) {
+                    printf("Dry run: \"%s\" (format %s) would be %lld bytes, %d line(s).\n",
+                           sinks[x].pFileName, sinks[x].pFormat->pName, sinkSize(&sinks[x]),
+                           sinks[x].output.linesWritten);
+                }
+                printf("Order-0 entropy of the input: %.0f bytes, an estimate of the least it could be compressed to.\n",
+                       inputEntropy(&input));
+            } else if (sinkCount > 1) {
+                printf("Done: %d line(s) written to %d files.\n", lines, sinkCount);
+            } else {
+                printf("Done: %d line(s) written to file.\n", lines);
+            }
+            for (x = 0; x < sinkCount; x++) {
+                if (sinks[x].output.failed) {
+                    // Said why already; the output will fail to compile
+                    printf("\"%s\" has an #error in it.\n", sinks[x].pFileName);
+                    success = false;
+                }
+            }
+        } else {
+            printUsage(pExeName);
+        }
+    } else {
+        printUsage(pExeName);
+    }
+
+    if (success && (pDepFileName != NULL) && !writeDepfile(pDepFileName, sinks, sinkCount,
+                                                           pInputFileName, pTemplateFileName)) {
+        success = false;
+        printf("Cannot write depfile %s (%s).\n", pDepFileName, strerror(errno));
+    }
+    if (success) {
+        // For --check, 1 means that something is out of date
+        retValue = (stale > 0) ? 1 : 0;
+    }
+
+    // Clean up
+    if (pInputFile != NULL) {
+        fclose(pInputFile);
+    }
+    for (x = 0; x < sinkCount; x++) {
+        if ((sinks[x].pFile != NULL) && !sinks[x].shared) {
+            fclose(sinks[x].pFile);
+        }
+        free(sinks[x].state.pLine);
+    }
+    if (pMallocedName != NULL) {
+        free(pMallocedName);
+    }
+    free(pWebName);
+    if (outputFileNameMalloced) {
+        free(pOutputFileName);
+    }
+    free(pHostPath);
+    freeTemplate(&outputTemplate);
+
+    return retValue;
+}
+
+// The type of the index of an amalgamation, emitted in its header
+static const char batchIndex[] =
+    "#include <stddef.h>\n"
+    "\n"
+    "#ifndef ARRAYIFY_INDEX\n"
+    "#define ARRAYIFY_INDEX\n"
+    "/* An array of an amalgamation: its name and the input it holds */\n"
+    "typedef struct {\n"
+    "    const char *name;\n"
+    "    const void *data;\n"
+    "    size_t len;\n"
+    "} ArrayifyIndexEntry;\n"
+    "#endif\n";
+
+// The body of the function which looks up an array in the index of an
+// amalgamation, emitted after its signature, which sets pEntries and count
+static const char batchFind[] =
+    "    size_t first = 0;\n"
+    "    size_t middle;\n"
+    "    int compare;\n"
+    "\n"
+    "    while (first < count) {\n"
+    "        middle = first + (count - first) / 2;\n"
+    "        compare = strcmp(pEntries[middle].name, pName);\n"
+    "        if (compare == 0) {\n"
+    "            return &pEntries[middle];\n"
+    "        } else if (compare < 0) {\n"
+    "            first = middle + 1;\n"
+    "        } else {\n"
+    "            count = middle;\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    return NULL;\n"
+    "}\n";
+
+// Work out the file name of a part of an amalgamation: the first is as
+// given and the others have _1, _2 and so on added before any extension
+static char *batchPartName(const char *pFileName, int part)
+{
+    char *pPartName = (char *) malloc(strlen(pFileName) + 16);
+    const char *pExtension = strrchr(pFileName, *EXT_SEPARATOR);
+    const char *pBase = pFileName;
+
+    for (const char *pTmp = pFileName; *pTmp != 0; pTmp++) {
+        if (strchr(DIR_SEPARATORS, *pTmp) != NULL) {
+            pBase = pTmp + 1;
+        }
+    }
+    if ((pExtension == NULL) || (pExtension < pBase)) {
+        pExtension = pFileName + strlen(pFileName);
+    }
+    if (pPartName != NULL) {
+        if (part == 0) {
+            strcpy(pPartName, pFileName);
+        } else {
+            sprintf(pPartName, "%.*s_%d%s", (int) (pExtension - pFileName), pFileName, part, pExtension);
+        }
+    }
+
+    return pPartName;
+}
+
+// Open a part of an amalgamation, returning its file name, to be
+// freed, or NULL if it could not be opened
+static char *batchOpenPart(Batch *pBatch, const char *pFileName, int part)
+{
+    char *pPartName = batchPartName(pFileName, part);
+
+    pBatch->pFile = (pPartName != NULL) ? fopen(pPartName, "w+") : NULL;
+    if (pBatch->pFile != NULL) {
+        // For the types of the declarations of the arrays
+        fprintf(pBatch->pFile, "#include <stddef.h>\n#include <stdint.h>\n\n");
+    } else {
+        printf("Cannot open output file %s (%s).\n", (pPartName != NULL) ? pPartName : pFileName, strerror(errno));
+        free(pPartName);
+        pPartName = NULL;
+    }
+
+    return pPartName;
+}
+
+// Compare the names of two inputs of a batch run, for qsort()
+static int batchCompareEntries(const void *pFirst, const void *pSecond)
+{
+    return strcmp(((const BatchEntry *) pFirst)->pName, ((const BatchEntry *) pSecond)->pName);
+}
+
+// Work out the file name of the header of an amalgamation, its file
+// name with the extension .h, returning it, to be freed, or NULL
+static char *batchHeaderName(const char *pFileName)
+{
+    char *pHeaderName = (char *) malloc(strlen(pFileName) + sizeof(EXT_SEPARATOR) + sizeof(HEADER_FILE_EXTENSION));
+    const char *pExtension = strrchr(pFileName, *EXT_SEPARATOR);
+    const char *pBase = pFileName;
+
+    for (const char *pTmp = pFileName; *pTmp != 0; pTmp++) {
+        if (strchr(DIR_SEPARATORS, *pTmp) != NULL) {
+            pBase = pTmp + 1;
+        }
+    }
+    if ((pExtension == NULL) || (pExtension < pBase)) {
+        pExtension = pFileName + strlen(pFileName);
+    }
+    if (pHeaderName != NULL) {
+        sprintf(pHeaderName, "%.*s%s%s", (int) (pExtension - pFileName), pFileName, EXT_SEPARATOR, HEADER_FILE_EXTENSION);
+    }
+
+    return pHeaderName;
+}
+
+// Write the header of an amalgamation, which declares its index and the
+// function to look up an array in it, returning false if it cannot
+static bool batchWriteHeader(const char *pHeaderName, const char *pName, int entryCount)
+{
+    FILE *pFile = fopen(pHeaderName, "w");
+
+    if (pFile == NULL) {
+        printf("Cannot open header file %s (%s).\n", pHeaderName, strerror(errno));
+        return false;
+    }
+    fprintf(pFile, "%s\n#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n", batchIndex);
+    fprintf(pFile, "/* The %d arrays of %s, sorted by name */\n", entryCount, pName);
+    fprintf(pFile, "extern const ArrayifyIndexEntry %s[];\nextern const size_t %s_count;\n\n", pName, pName);
+    fprintf(pFile, "/* Find the array with the given name, returning NULL if there is none */\n");
+    fprintf(pFile, "const ArrayifyIndexEntry *%s_find(const char *pName);\n", pName);
+    fprintf(pFile, "\n#ifdef __cplusplus\n}\n#endif\n");
+    fprintf(pFile, ENDFIX);
+    if (fclose(pFile) != 0) {
+        printf("Cannot write header file %s (%s).\n", pHeaderName, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+// Write the index of an amalgamation, at the end of its last part: the
+// arrays sorted by name, each with the input it holds and its length,
+// and the function to look one up, declared in the header, which is
+// written too; returns false if the header cannot be
+static bool batchWriteIndex(FILE *pFile, const char *pOutputFileName, const char *pName, BatchEntry *pEntries,
+                            int entryCount, const Format *pFormat)
+{
+    char *pHeaderName = batchHeaderName(pOutputFileName);
+    const char *pBase = pHeaderName;
+    bool valid = (pHeaderName != NULL);
+
+    if (!valid) {
+        printf("Cannot allocate memory for header file name.\n");
+    } else if (strcmp(pHeaderName, pOutputFileName) == 0) {
+        printf("The output file %s would be the header of the amalgamation: give one with another extension.\n",
+               pOutputFileName);
+        valid = false;
+    }
+    valid = valid && batchWriteHeader(pHeaderName, pName, entryCount);
+    if (valid) {
+        // The header is next to the part, where #include "" looks first
+        for (const char *pTmp = pHeaderName; *pTmp != 0; pTmp++) {
+            if (strchr(DIR_SEPARATORS, *pTmp) != NULL) {
+                pBase = pTmp + 1;
+            }
+        }
+        qsort(pEntries, entryCount, sizeof(BatchEntry), batchCompareEntries);
+        fprintf(pFile, "\n#include <string.h>\n#include \"%s\"\n\n", pBase);
+        for (int x = 0; x < entryCount; x++) {
+            if ((x > 0) && (strcmp(pEntries[x - 1].pName, pEntries[x].pName) == 0)) {
+                printf("Name %s is given to more than one input; give each a name of its own in the list.\n",
+                       pEntries[x].pName);
+                fprintf(pFile, "# error %s is the name of more than one array\n", pEntries[x].pName);
+            }
+            fprintf(pFile, "extern %s ", pFormat->pIndexType);
+            fprintf(pFile, pFormat->pIndexArray, pEntries[x].pName);
+            fprintf(pFile, "[];\n");
+        }
+        fprintf(pFile, "\n/* The %d arrays of %s, sorted by name for %s_find() */\n", entryCount, pName, pName);
+        fprintf(pFile, "const ArrayifyIndexEntry %s[] = {\n", pName);
+        for (int x = 0; x < entryCount; x++) {
+            fprintf(pFile, ELEMENT_INDENT "{\"%s\", ", pEntries[x].pName);
+            fprintf(pFile, pFormat->pIndexArray, pEntries[x].pName);
+            fprintf(pFile, ", %lld},\n", pEntries[x].length);
+        }
+        if (entryCount == 0) {
+            // C has no empty arrays
+            fprintf(pFile, ELEMENT_INDENT "{NULL, NULL, 0}\n");
+        }
+        fprintf(pFile, "};\n");
+        fprintf(pFile, "const size_t %s_count = %d;\n\n", pName, entryCount);
+        fprintf(pFile, "/* Find the entry with the given name, returning NULL if there is none */\n");
+        fprintf(pFile, "const ArrayifyIndexEntry *%s_find(const char *pName)\n{\n", pName);
+        fprintf(pFile, ELEMENT_INDENT "const ArrayifyIndexEntry *pEntries = %s;\n", pName);
+        fprintf(pFile, ELEMENT_INDENT "size_t count = %s_count;\n%s", pName, batchFind);
+        fprintf(pFile, ENDFIX);
+    }
+    free(pHeaderName);
+
+    return valid;
+}
+
+// Read the whole of a list file, for a batch run or a manifest, returning
+// it with a terminator, to be freed, or NULL if it cannot be read
+static char *readList(const char *pFileName)
+{
+    FILE *pFile = fopen(pFileName, "r");
+    char *pList = NULL;
+    char *pTmp;
+    size_t length = 0;
+    size_t allocated = INPUT_BUFFER_SIZE;
+    size_t size;
+
+    if (pFile == NULL) {
+        printf("Cannot open list file %s (%s).\n", pFileName, strerror(errno));
+        return NULL;
+    }
+    do {
+        // Doubling, for manifests of tens of thousands of lines
+        pTmp = (char *) realloc(pList, allocated + 1);
+        if (pTmp == NULL) {
+            printf("Cannot allocate memory for list file %s.\n", pFileName);
+            free(pList);
+            pList = NULL;
+        } else {
+            pList = pTmp;
+            size = fread(pList + length, 1, allocated - length, pFile);
+            length += size;
+            pList[length] = 0;
+            if (length == allocated) {
+                allocated *= 2;
+            }
+        }
+    } while ((pList != NULL) && (size > 0));
+    if ((pList != NULL) && ferror(pFile)) {
+        printf("Cannot read list file %s (%s).\n", pFileName, strerror(errno));
+        free(pList);
+        pList = NULL;
+    }
+    fclose(pFile);
+
+    return pList;
+}
+
+// Run arrayify on each of the inputs listed in a file, given as @file,
+// with the rest of the command line: each line of the list is an input
+// file name, optionally followed by a tab and the name for its array.
+// With -g the arrays are written, one after another, to an amalgamation,
+// the output file given with -o, a new part of which is started once a
+// part has the given number of bytes in it, and -n names the index of
+// the arrays which ends the last part.
+static int batchRun(int argc, char *argv[], char *pExeName)
+{
+    int retValue = 0;
+    int result;
+    const char *pListFileName = argv[1] + 1;
+    char *pList = NULL;
+    char **ppArguments = (char **) malloc((argc + 4) * sizeof(char *));
+    int argumentCount = 2;
+    BatchEntry *pEntries = NULL;
+    int entryCount = 0;
+    char *pLine;
+    char *pNext;
+    char *pTmp;
+    char *pMallocedName = NULL;
+    const char *pName = NULL;
+    const char *pOutputFileName = NULL;
+    char *pMallocedOutputFileName = NULL;
+    char *pPartName = NULL;
+    int part = 0;
+    long long groupSize = 0;
+    const Format *pFormat = &(formats[0]);
+    Batch batch;
+    bool valid = (ppArguments != NULL);
+
+    memset(&batch, 0, sizeof(batch));
+
+    // -g, -n and -o are the batch's; the rest are passed on for each input
+    for (int x = 2; valid && (x < argc); x++) {
+        if ((strcmp(argv[x], "-g") == 0) && (x + 1 < argc)) {
+            x++;
+            groupSize = strtol(argv[x], &pTmp, 10);
+            groupSize *= (*pTmp == 'k') ? 1024 : (*pTmp == 'M') ? 1024 * 1024 : 1;
+            if (groupSize <= 0) {
+                printf("-g must be given a size in bytes, or in kbytes or Mbytes followed by k or M.\n");
+                valid = false;
+            }
+        } else if ((strcmp(argv[x], "-n") == 0) && (x + 1 < argc)) {
+            pName = argv[++x];
+        } else if ((strcmp(argv[x], "-o") == 0) && (x + 1 < argc)) {
+            pOutputFileName = argv[++x];
+        } else {
+            if ((strcmp(argv[x], "-f") == 0) && (x + 1 < argc) && (findFormat(argv[x + 1]) != NULL)) {
+                pFormat = findFormat(argv[x + 1]);
+            }
+            ppArguments[argumentCount] = argv[x];
+            argumentCount++;
+        }
+    }
+    if (valid && (groupSize == 0) && ((pName != NULL) || (pOutputFileName != NULL))) {
+        printf("-n and -o are only for -g in a batch run: each input is otherwise named from the list.\n");
+        valid = false;
+    }
+
+    // Read the list
+    pList = valid ? readList(pListFileName) : NULL;
+    valid = valid && (pList != NULL);
+    if (valid) {
+        // An entry for each line, at most
+        entryCount = 1;
+        for (pTmp = pList; *pTmp != 0; pTmp++) {
+            entryCount += (*pTmp == '\n');
+        }
+        pEntries = (BatchEntry *) calloc(entryCount, sizeof(BatchEntry));
+        valid = (pEntries != NULL);
+        entryCount = 0;
+    }
+    for (pLine = pList; valid && (pLine != NULL) && (*pLine != 0); pLine = pNext) {
+        pNext = pLine + strcspn(pLine, "\n");
+        if (*pNext != 0) {
+            *pNext++ = 0;
+        }
+        pLine[strcspn(pLine, "\r")] = 0;
+        if (*pLine != 0) {
+            pEntries[entryCount].pFileName = pLine;
+            pTmp = strchr(pLine, '\t');
+            if (pTmp != NULL) {
+                *pTmp = 0;
+                pEntries[entryCount].pName = pTmp + 1;
+            }
+            entryCount++;
+        }
+    }
+
+    if (valid && (groupSize > 0)) {
+        // The names of the arrays are needed for the index
+        for (int x = 0; x < entryCount; x++) {
+            if (pEntries[x].pName == NULL) {
+                pEntries[x].pMallocedName = (char *) malloc(strlen(pEntries[x].pFileName) + 1);
+                if (pEntries[x].pMallocedName != NULL) {
+                    strcpy(pEntries[x].pMallocedName, pEntries[x].pFileName);
+                    pEntries[x].pName = defaultName(pEntries[x].pMallocedName);
+                } else {
+                    printf("Cannot allocate memory for name.\n");
+                    valid = false;
+                }
+            }
+        }
+        // The index is named, and the amalgamation too, by default, from the list
+        pMallocedName = (char *) malloc(strlen(pListFileName) + 1);
+        if (pMallocedName != NULL) {
+            strcpy(pMallocedName, pListFileName);
+            if (pName == NULL) {
+                pName = defaultName(pMallocedName);
+            }
+            if (pOutputFileName == NULL) {
+                pMallocedOutputFileName = (char *) malloc(strlen(pName) + sizeof(EXT_SEPARATOR) + sizeof(OUTPUT_FILE_EXTENSION));
+                if (pMallocedOutputFileName != NULL) {
+                    sprintf(pMallocedOutputFileName, "%s%s%s", pName, EXT_SEPARATOR, OUTPUT_FILE_EXTENSION);
+                }
+                pOutputFileName = pMallocedOutputFileName;
+            }
+        }
+        if (valid && ((pMallocedName == NULL) || (pOutputFileName == NULL))) {
+            printf("Cannot allocate memory for name.\n");
+            valid = false;
+        }
+    }
+
+    if (valid && (groupSize > 0)) {
+        pPartName = batchOpenPart(&batch, pOutputFileName, part);
+        valid = (pPartName != NULL);
+    }
+    PROBE3(batch__start, pListFileName, entryCount, groupSize);
+    for (int x = 0; valid && (x < entryCount); x++) {
+        PROBE2(batch__input, x, pEntries[x].pFileName);
+        ppArguments[0] = argv[0];
+        ppArguments[1] = pEntries[x].pFileName;
+        result = argumentCount;
+        if (pEntries[x].pName != NULL) {
+            ppArguments[result++] = (char *) "-n";
+            ppArguments[result++] = pEntries[x].pName;
+        }
+        if (batch.pFile != NULL) {
+            // Only for what is said about the output, the file being open already
+            ppArguments[result++] = (char *) "-o";
+            ppArguments[result++] = pPartName;
+        }
+        batch.length = 0;
+        result = arrayify(result, ppArguments, pExeName, &batch);
+        pEntries[x].length = batch.length;
+        PROBE3(batch__done, x, pEntries[x].pFileName, result);
+        if (result < 0) {
+            // Stop at the first input which fails
+            printf("Batch stopped at input %d of %d, %s.\n", x + 1, entryCount, pEntries[x].pFileName);
+            valid = false;
+        } else if (result > 0) {
+            retValue = result;
+        }
+        if (valid && (batch.pFile != NULL) && (ftello(batch.pFile) >= groupSize) && (x + 1 < entryCount)) {
+            // Start the next part of the amalgamation
+            fprintf(batch.pFile, ENDFIX);
+            fclose(batch.pFile);
+            batch.pFile = NULL;
+            free(pPartName);
+            part++;
+            pPartName = batchOpenPart(&batch, pOutputFileName, part);
+            valid = (pPartName != NULL);
+        }
+    }
+    if (valid && (batch.pFile != NULL)) {
+        valid = batchWriteIndex(batch.pFile, pOutputFileName, pName, pEntries, entryCount, pFormat);
+    }
+    if (valid && (batch.pFile != NULL)) {
+        printf("Amalgamated %d array(s) into %d file(s), with the index %s.\n", entryCount, part + 1, pName);
+    }
+    PROBE3(batch__end, pListFileName, entryCount, valid ? retValue : -1);
+
+    if (batch.pFile != NULL) {
+        fclose(batch.pFile);
+    }
+    for (int x = 0; (pEntries != NULL) && (x < entryCount); x++) {
+        free(pEntries[x].pMallocedName);
+    }
+    free(pEntries);
+    free(pList);
+    free(pMallocedName);
+    free(pMallocedOutputFileName);
+    free(pPartName);
+    free(ppArguments);
+
+    return valid ? retValue : -1;
+}
+
+// Match a file name against a glob of a manifest, in which * matches any
+// characters but a directory separator, ** any characters at all, so that
+// "**/" matches any directories or none, and ? any one character but a
+// directory separator; either directory separator matches the other
+static bool globMatch(const char *pGlob, const char *pName)
+{
+    bool any;
+
+    while (*pGlob != 0) {
+        if (*pGlob == '*') {
+            any = (pGlob[1] == '*');
+            pGlob += any ? 2 : 1;
+            if (any && (*pGlob != 0) && (strchr(DIR_SEPARATORS, *pGlob) != NULL) && globMatch(pGlob + 1, pName)) {
+                return true;
+            }
+            for (;;) {
+                if (globMatch(pGlob, pName)) {
+                    return true;
+                }
+                if ((*pName == 0) || (!any && (strchr(DIR_SEPARATORS, *pName) != NULL))) {
+                    return false;
+                }
+                pName++;
+            }
+        } else if (*pName == 0) {
+            return false;
+        } else if (strchr(DIR_SEPARATORS, *pName) != NULL) {
+            if ((*pGlob == '?') || (strchr(DIR_SEPARATORS, *pGlob) == NULL)) {
+                return false;
+            }
+        } else if ((*pGlob != '?') && (*pGlob != *pName)) {
+            return false;
+        }
+        pGlob++;
+        pName++;
+    }
+
+    return (*pName == 0);
+}
+
+// Write a path, or a variable if path is false, to a Ninja file, escaping
+// what Ninja would otherwise take as its own
+static void ninjaWrite(FILE *pFile, const char *pString, bool path)
+{
+    for (; *pString != 0; pString++) {
+        if ((*pString == '$') || (path && ((*pString == ' ') || (*pString == ':')))) {
+            fputc('$', pFile);
+        }
+        fputc(*pString, pFile);
+    }
+}
+
+// Write an argument of a command in a Ninja file, escaped as Ninja reads
+// it and, unless it is made of nothing but characters which need none,
+// quoted for the shell which Ninja runs the command with, e.g. a name
+// with a space in it
+static void ninjaWriteArgument(FILE *pFile, const char *pString)
+{
+    bool quote = (*pString == 0);
+
+    for (const char *pTmp = pString; *pTmp != 0; pTmp++) {
+        if (!isalnum((unsigned char) *pTmp) && (strchr(NINJA_UNQUOTED, *pTmp) == NULL)) {
+            quote = true;
+        }
+    }
+    if (!quote) {
+        ninjaWrite(pFile, pString, false);
+        return;
+    }
+#ifdef _WIN32
+    // In double quotes, as the C runtime splits a command line, with a
+    // backslash before a double quote
+    fputc('"', pFile);
+    for (; *pString != 0; pString++) {
+        if (*pString == '"') {
+            fputc('\\', pFile);
+        } else if (*pString == '$') {
+            fputc('$', pFile);
+        }
+        fputc(*pString, pFile);
+    }
+    fputc('"', pFile);
+#else
+    // In single quotes, in which a single quote has to end them, be
+    // escaped and start them again
+    fputc('\'', pFile);
+    for (; *pString != 0; pString++) {
+        if (*pString == '\'') {
+            fprintf(pFile, "'\\''");
+        } else {
+            if (*pString == '$') {
+                fputc('$', pFile);
+            }
+            fputc(*pString, pFile);
+        }
+    }
+    fputc('\'', pFile);
+#endif
+}
+
+// Write the output file of an input of a manifest, into the directory, if there is one
+static void ninjaWriteOutput(FILE *pFile, const char *pDirectory, const char *pName)
+{
+    if (pDirectory != NULL) {
+        ninjaWrite(pFile, pDirectory, true);
+        fputc('/', pFile);
+    }
+    ninjaWrite(pFile, pName, true);
+    fprintf(pFile, "%s%s", EXT_SEPARATOR, OUTPUT_FILE_EXTENSION);
+}
+
+// Write a Ninja file, given as --ninja file, from a manifest: each line
+// is an input file, optionally followed by a tab and the name for its
+// array, as for a batch run, or "directory dir", to put the outputs in
+// dir, or "options glob options", giving the options for the inputs which
+// match glob; an input gets the options of every glob that it matches, in
+// order.  Each output is a build edge of its own, which Ninja runs with
+// --restat and --depfile, so that it is only rebuilt when it needs to be.
+static int ninjaRun(int argc, char *argv[], const char *pExePath, char *pExeName)
+{
+    const char *pManifestFileName = (argc > 2) ? argv[2] : NULL;
+    const char *pOutputFileName = NULL;
+    char *pMallocedOutputFileName = NULL;
+    const char *pName = NULL;
+    char *pMallocedName = NULL;
+    const char *pDirectory = NULL;
+    char *pList = NULL;
+    ManifestRule *pRules = NULL;
+    int ruleCount = 0;
+    BatchEntry *pEntries = NULL;
+    int entryCount = 0;
+    int lineCount = 1;
+    int lineNumber = 0;
+    char *pLine;
+    char *pNext;
+    char *pTmp;
+    FILE *pFile = NULL;
+    bool valid = (pManifestFileName != NULL);
+
+    if (valid && (pExePath == NULL)) {
+        printf("Cannot allocate memory for the path of %s.\n", pExeName);
+        valid = false;
+    }
+    for (int x = 3; valid && (x < argc); x++) {
+        if ((strcmp(argv[x], "-o") == 0) && (x + 1 < argc)) {
+            pOutputFileName = argv[++x];
+        } else if ((strcmp(argv[x], "-n") == 0) && (x + 1 < argc)) {
+            pName = argv[++x];
+        } else {
+            printf("Unknown option %s for --ninja, which takes only -o and -n.\n", argv[x]);
+            valid = false;
+        }
+    }
+
+    // Read the manifest, with room for a rule or an entry for each line
+    pList = valid ? readList(pManifestFileName) : NULL;
+    valid = valid && (pList != NULL);
+    if (valid) {
+        for (pTmp = pList; *pTmp != 0; pTmp++) {
+            lineCount += (*pTmp == '\n');
+        }
+        pRules = (ManifestRule *) calloc(lineCount, sizeof(ManifestRule));
+        pEntries = (BatchEntry *) calloc(lineCount, sizeof(BatchEntry));
+        if ((pRules == NULL) || (pEntries == NULL)) {
+            printf("Cannot allocate memory for manifest %s.\n", pManifestFileName);
+            valid = false;
+        }
+    }
+    for (pLine = pList; valid && (pLine != NULL) && (*pLine != 0); pLine = pNext) {
+        lineNumber++;
+        pNext = pLine + strcspn(pLine, "\n");
+        if (*pNext != 0) {
+            *pNext++ = 0;
+        }
+        pLine[strcspn(pLine, "\r")] = 0;
+        if ((*pLine == 0) || (*pLine == '#')) {
+            // Blank or a comment
+        } else if (strncmp(pLine, "directory ", 10) == 0) {
+            pDirectory = pLine + 10;
+        } else if (strncmp(pLine, "options ", 8) == 0) {
+            pRules[ruleCount].pGlob = pLine + 8;
+            pTmp = strchr(pLine + 8, ' ');
+            if (pTmp == NULL) {
+                printf("Line %d of manifest %s gives a glob without any options for it.\n", lineNumber, pManifestFileName);
+                valid = false;
+            } else {
+                *pTmp = 0;
+                pRules[ruleCount].pOptions = pTmp + 1;
+                ruleCount++;
+            }
+        } else {
+            pEntries[entryCount].pFileName = pLine;
+            pTmp = strchr(pLine, '\t');
+            if (pTmp != NULL) {
+                *pTmp = 0;
+                pEntries[entryCount].pName = pTmp + 1;
+            } else {
+                pEntries[entryCount].pMallocedName = (char *) malloc(strlen(pLine) + 1);
+                if (pEntries[entryCount].pMallocedName != NULL) {
+                    strcpy(pEntries[entryCount].pMallocedName, pLine);
+                    pEntries[entryCount].pName = defaultName(pEntries[entryCount].pMallocedName);
+                } else {
+                    printf("Cannot allocate memory for name.\n");
+                    valid = false;
+                }
+            }
+            entryCount++;
+        }
+    }
+
+    // The outputs are named from the arrays, which must be unique
+    if (valid) {
+        qsort(pEntries, entryCount, sizeof(BatchEntry), batchCompareEntries);
+        for (int x = 1; x < entryCount; x++) {
+            if (strcmp(pEntries[x - 1].pName, pEntries[x].pName) == 0) {
+                printf("Inputs %s and %s of manifest %s would both be array %s.\n", pEntries[x - 1].pFileName,
+                       pEntries[x].pFileName, pManifestFileName, pEntries[x].pName);
+                valid = false;
+            }
+        }
+    }
+
+    // The Ninja file, and the phony target for all of the outputs, are
+    // named by default from the manifest
+    if (valid) {
+        pMallocedName = (char *) malloc(strlen(pManifestFileName) + 1);
+        if (pMallocedName != NULL) {
+            strcpy(pMallocedName, pManifestFileName);
+            if (pName == NULL) {
+                pName = defaultName(pMallocedName);
+            }
+            if (pOutputFileName == NULL) {
+                pMallocedOutputFileName = (char *) malloc(strlen(pName) + sizeof(EXT_SEPARATOR) + sizeof(NINJA_FILE_EXTENSION));
+                if (pMallocedOutputFileName != NULL) {
+                    sprintf(pMallocedOutputFileName, "%s%s%s", pName, EXT_SEPARATOR, NINJA_FILE_EXTENSION);
+                }
+                pOutputFileName = pMallocedOutputFileName;
+            }
+        }
+        if ((pMallocedName == NULL) || (pOutputFileName == NULL)) {
+            printf("Cannot allocate memory for name.\n");
+            valid = false;
+        }
+    }
+
+    pFile = valid ? fopen(pOutputFileName, "w") : NULL;
+    if (valid && (pFile == NULL)) {
+        printf("Cannot open output file %s (%s).\n", pOutputFileName, strerror(errno));
+        valid = false;
+    }
+    if (valid) {
+        fprintf(pFile, "# This file was created from manifest %s by %s\n\n", pManifestFileName, pExeName);
+        fprintf(pFile, "arrayify = ");
+        ninjaWriteArgument(pFile, pExePath);
+        fprintf(pFile, "\n\n");
+        fprintf(pFile, "rule arrayify\n"
+                       "  command = $arrayify $in -o $out $options --restat --depfile $out.d\n"
+                       "  description = ARRAYIFY $out\n"
+                       "  depfile = $out.d\n"
+                       "  deps = gcc\n"
+                       "  restat = 1\n\n");
+        // So that the Ninja file is written again when the manifest changes
+        fprintf(pFile, "rule arrayify_manifest\n"
+                       "  command = $arrayify --ninja $in -o $out -n ");
+        ninjaWriteArgument(pFile, pName);
+        fprintf(pFile, "\n"
+                       "  description = ARRAYIFY $out\n"
+                       "  generator = 1\n\n"
+                       "build ");
+        ninjaWrite(pFile, pOutputFileName, true);
+        fprintf(pFile, ": arrayify_manifest ");
+        ninjaWrite(pFile, pManifestFileName, true);
+        fprintf(pFile, "\n\n");
+        for (int x = 0; x < entryCount; x++) {
+            fprintf(pFile, "build ");
+            ninjaWriteOutput(pFile, pDirectory, pEntries[x].pName);
+            fprintf(pFile, ": arrayify ");
+            ninjaWrite(pFile, pEntries[x].pFileName, true);
+            fprintf(pFile, "\n  options = -n ");
+            ninjaWriteArgument(pFile, pEntries[x].pName);
+            for (int y = 0; y < ruleCount; y++) {
+                if (globMatch(pRules[y].pGlob, pEntries[x].pFileName)) {
+                    fputc(' ', pFile);
+                    ninjaWrite(pFile, pRules[y].pOptions, false);
+                }
+            }
+            fputc('\n', pFile);
+        }
+        fprintf(pFile, "\nbuild ");
+        ninjaWrite(pFile, pName, true);
+        fprintf(pFile, ": phony");
+        for (int x = 0; x < entryCount; x++) {
+            fprintf(pFile, " $\n    ");
+            ninjaWriteOutput(pFile, pDirectory, pEntries[x].pName);
+        }
+        fputc('\n', pFile);
+        if (ferror(pFile)) {
+            printf("Cannot write output file %s (%s).\n", pOutputFileName, strerror(errno));
+            valid = false;
+        }
+        fclose(pFile);
+    }
+    if (valid) {
+        printf("Wrote %d build edge(s) and the target %s to Ninja file %s.\n", entryCount, pName, pOutputFileName);
+    } else if (pManifestFileName == NULL) {
+        printUsage(pExeName);
+    }
+
+    for (int x = 0; (pEntries != NULL) && (x < entryCount); x++) {
+        free(pEntries[x].pMallocedName);
+    }
+    free(pEntries);
+    free(pRules);
+    free(pList);
+    free(pMallocedName);
+    free(pMallocedOutputFileName);
+
+    return valid ? 0 : -1;
+}
+
+// Entry point
+int main(int argc, char* argv[])
+{
+    char *pExeName = NULL;
+    char *pExePath = NULL;
+    bool ninja = (argc > 1) && (strcmp(argv[1], "--ninja") == 0);
+    int retValue;
+    char *pTmp;
+
+    // A Ninja file runs the exe as it was run, so keep that before
+    // the name is cut out of it
+    if (ninja) {
+        pExePath = (char *) malloc(strlen(argv[0]) + 1);
+        if (pExePath != NULL) {
+            strcpy(pExePath, argv[0]);
+        }
+    }
+
+    // Find the exe name in the first argument
+    pTmp = strtok(argv[0], DIR_SEPARATORS);
+    while (pTmp != NULL) {
+        pExeName = pTmp;
+        pTmp = strtok(NULL, DIR_SEPARATORS);
+    }
+    if (pExeName != NULL) {
+        // Remove the extension
+        pTmp = strtok(pExeName, EXT_SEPARATOR);
+        if (pTmp != NULL) {
+            pExeName = pTmp;
+        }
+    }
+
+    // --ninja file writes a Ninja file from a manifest
+    if (ninja) {
+        retValue = ninjaRun(argc, argv, pExePath, pExeName);
+        free(pExePath);
+        return retValue;
+    }
+
+    // An input of @file is a list of inputs, each to be arrayified
+    if ((argc > 1) && (argv[1][0] == '@')) {
+        return batchRun(argc, argv, pExeName);
+    }
+
+    return arrayify(argc, argv, pExeName, NULL);
+}
@@ -0,0 +1,50 @@
+#!/bin/sh
+# Encoding of the cbor format: convert a JSON fixture, compile the output
+# and compare the bytes of the array with deterministic CBOR worked out by
+# hand, covering the ordering of keys, by length and then bytewise, floats
+# shortened to half, single and double precision, the largest uint64, -2^63,
+# nested empty containers and a UTF-8 key; then check that malformed JSON
+# fails the run.  Run from the root of the repository, with g++.
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+g++ -O2 -o "$dir/arrayify" arrayify.cpp
+printf '{"b": 1, "a": [1.5, 100000.5, 0.1, {}, [], {"x": [{}]}], "aa": 18446744073709551615,\n' > "$dir/input.json"
+printf ' "\303\251": -9223372036854775808, "z": [true, false, null, "s", -1, 65504.0, 1e300]}\n' >> "$dir/input.json"
+# {"a": [...], "b": 1, "z": [...], "aa": 2^64 - 1, "\303\251": -2^63}
+expected=a5\
+616186f93e00fa47c35040fb3fb999999999999aa080a1617881a0\
+616201\
+617a87f5f4f6617320f97bfffb7e37e43c8800759c\
+6261611bffffffffffffffff\
+62c3a93b7fffffffffffffff
+"$dir/arrayify" "$dir/input.json" -n blob -f cbor -o "$dir/blob.h" > /dev/null
+cat > "$dir/main.c" <<'END'
+#include <stdio.h>
+#include "blob.h"
+
+int main(void)
+{
+    for (size_t x = 0; x < blob_len; x++) {
+        printf("%02x", blob[x]);
+    }
+    printf("\n");
+
+    return 0;
+}
+END
+gcc -o "$dir/main" "$dir/main.c"
+actual=$("$dir/main")
+if [ "$actual" != "$expected" ]; then
+    echo "The cbor format gave $actual"
+    echo "               not $expected"
+    exit 1
+fi
+for json in '{"a": 1,}' '[1 2]' '{"a":' '{"a": 1, "a": 2}' '[01]' '"\x"' '[1e999]'; do
+    printf '%s' "$json" > "$dir/bad.json"
+    if "$dir/arrayify" "$dir/bad.json" -n blob -f cbor -o "$dir/bad.h" > /dev/null; then
+        echo "The cbor format took malformed JSON: $json"
+        exit 1
+    fi
+done
+echo "The cbor format encodes as expected"
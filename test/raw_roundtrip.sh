@@ -0,0 +1,33 @@
+#!/bin/sh
+# Round trip of the raw format: arrayify an input holding backslashes
+# followed by spaces or tabs and a newline, which g++ and C++23 take as a
+# line splice even in a raw string literal, compile it and compare it
+# with the input.  Run from the root of the repository, with g++.
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+g++ -O2 -o "$dir/arrayify" arrayify.cpp
+printf 'a\\\t\nb\\  \nc\\\n\\ x\\\t \t\r\nend\\ \\  \n' > "$dir/input.txt"
+"$dir/arrayify" "$dir/input.txt" -n blob -f raw -o "$dir/blob.h" > /dev/null
+cat > "$dir/main.cpp" <<'END'
+#include <stdio.h>
+#include <string.h>
+#include "blob.h"
+
+int main(int argc, char *argv[])
+{
+    char buffer[256];
+    FILE *pFile = fopen(argv[1], "rb");
+    size_t size = fread(buffer, 1, sizeof(buffer), pFile);
+
+    return (size == sizeof(blob) - 1) && (memcmp(buffer, blob, size) == 0) ? 0 : 1;
+}
+END
+for standard in c++11 c++23; do
+    g++ -std=$standard -o "$dir/main" "$dir/main.cpp"
+    if ! "$dir/main" "$dir/input.txt"; then
+        echo "The raw format did not round trip with -std=$standard"
+        exit 1
+    fi
+done
+echo "The raw format round trips"
@@ -0,0 +1,53 @@
+#!/bin/sh
+# Round trip of the web and web_deflate formats: arrayify empty,
+# incompressible, highly repetitive and mixed inputs, compile each output
+# to write out its data and Content-Encoding, and check that gzip -dc, for
+# web, or a zlib inflate, for web_deflate, gives the input back; an input
+# which compression would not make smaller is stored as it is, with no
+# encoding, and a compressible one must be compressed.  Run from the root
+# of the repository, with g++, gzip and python3.
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+g++ -O2 -o "$dir/arrayify" arrayify.cpp
+: > "$dir/empty.txt"
+head -c 100000 /dev/urandom > "$dir/random.bin"
+yes 'arrayify arrayify arrayify' | head -c 300000 > "$dir/repetitive.txt"
+(cat README.md; head -c 70000 /dev/urandom; cat arrayify.cpp arrayify.cpp) > "$dir/mixed.bin"
+cat > "$dir/main.c" <<'END'
+#include <stdio.h>
+#include "blob.h"
+
+int main(int argc, char *argv[])
+{
+    FILE *pFile = fopen(argv[1], "wb");
+
+    fwrite(blob_asset.data, 1, blob_asset.len, pFile);
+    fclose(pFile);
+    printf("%s\n", (blob_asset.encoding != NULL) ? blob_asset.encoding : "none");
+
+    return 0;
+}
+END
+for format in web web_deflate; do
+    for input in empty.txt random.bin repetitive.txt mixed.bin; do
+        "$dir/arrayify" "$dir/$input" -n blob -f $format -o "$dir/blob.h" > /dev/null
+        gcc -o "$dir/main" "$dir/main.c"
+        encoding=$("$dir/main" "$dir/data")
+        case $encoding in
+            gzip) gzip -dc < "$dir/data" > "$dir/output";;
+            deflate) python3 -c 'import sys, zlib; sys.stdout.buffer.write(zlib.decompress(sys.stdin.buffer.read()))' \
+                         < "$dir/data" > "$dir/output";;
+            *) cp "$dir/data" "$dir/output";;
+        esac
+        if [ "$encoding" = none ] && { [ $input = repetitive.txt ] || [ $input = mixed.bin ]; }; then
+            echo "The $format format did not compress $input"
+            exit 1
+        fi
+        if ! cmp -s "$dir/$input" "$dir/output"; then
+            echo "The $format format did not round trip $input (encoding $encoding)"
+            exit 1
+        fi
+    done
+done
+echo "The web and web_deflate formats round trip"
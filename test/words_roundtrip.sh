@@ -0,0 +1,58 @@
+#!/bin/sh
+# Round trip of the u32 and u64 formats: arrayify inputs of lengths which
+# are and are not a multiple of the word size for each endianness, compile
+# each output and compare name and name_len with the input.  A big-endian
+# output is checked on the host by taking the bytes of each word most
+# significant first, its endianness check being compiled out.  Run from the
+# root of the repository, with gcc, on a little-endian host.
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+g++ -O2 -o "$dir/arrayify" arrayify.cpp
+: > "$dir/empty.bin"
+printf 'a' > "$dir/one.bin"
+printf 'abcdefg' > "$dir/seven.bin"
+printf 'abcdefgh' > "$dir/eight.bin"
+printf 'abcdefghijklm' > "$dir/thirteen.bin"
+head -c 1001 /dev/urandom > "$dir/random.bin"
+cat > "$dir/main.c" <<'END'
+#include <stdio.h>
+#include <string.h>
+#include "blob.h"
+
+int main(int argc, char *argv[])
+{
+    unsigned char buffer[2048];
+    unsigned char bytes[2048];
+    FILE *pFile = fopen(argv[1], "rb");
+    size_t size = fread(buffer, 1, sizeof(buffer), pFile);
+    size_t wordSize = sizeof(blob_words[0]);
+
+    for (size_t x = 0; x < blob_len; x++) {
+        if (BIG) {
+            bytes[x] = (unsigned char) (blob_words[x / wordSize] >> ((wordSize - 1 - x % wordSize) * 8));
+        } else {
+            bytes[x] = blob[x];
+        }
+    }
+
+    return (size == blob_len) && (memcmp(buffer, bytes, size) == 0) ? 0 : 1;
+}
+END
+for format in u32 u64; do
+    for endianness in little big; do
+        for input in empty one seven eight thirteen random; do
+            "$dir/arrayify" "$dir/$input.bin" -n blob -f $format -e $endianness -o "$dir/blob.h" > /dev/null
+            if [ $endianness = big ]; then
+                gcc -U__BYTE_ORDER__ -DBIG=1 -o "$dir/main" "$dir/main.c"
+            else
+                gcc -DBIG=0 -o "$dir/main" "$dir/main.c"
+            fi
+            if ! "$dir/main" "$dir/$input.bin"; then
+                echo "The $format format did not round trip $input.bin with -e $endianness"
+                exit 1
+            fi
+        done
+    done
+done
+echo "The u32 and u64 formats round trip"